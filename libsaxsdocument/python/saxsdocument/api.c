@@ -1,6 +1,9 @@
 
 #include <Python.h>
 
+#include <limits.h>
+#include <string.h>
+
 #include "saxsdocument.h"
 
 #if PY_VERSION_HEX < 0x03030000
@@ -24,26 +27,465 @@ const char* PyUnicode_AsUTF8(PyObject *string) {
 
 
 /**
- * This module implements two types and two module
+ * This module implements four types and four module
  * functions:
  *  - type: saxsdocument.api.document
  *    wrapper for saxs_dcoument
  *  - type: saxsdocument.api.curve
  *    wrapper for saxs_curve
+ *  - type: saxsdocument.api.column
+ *    buffer protocol exporter of a column of a saxs_curve
+ *  - type: saxsdocument.api.array
+ *    buffer protocol exporter of an array of values owned by the object
  *
  *  - procedure: read
  *    reads a file, returns a 'filled in' document object
+ *  - procedure: read_many
+ *    reads a list of files in parallel, returns a list of documents
+ *  - procedure: read_stack
+ *    reads a list of files in parallel, returns the curves as a matrix
  *  - procedure: create
  *    returns an empty document object
  */
 
+struct PySaxsCurveObject;
+
+/*
+ * Curve wrappers are created on first access and remembered here, such
+ * that indexing is O(1) and repeated access yields the same object. The
+ * wrappers are not referenced (they reference the document instead) and
+ * remove themselves when deallocated.
+ */
+struct curve_cache_entry {
+  struct saxs_curve *curve;
+  struct PySaxsCurveObject *wrapper;
+};
+
 typedef struct {
   PyObject_HEAD
 
+  struct saxs_document *doc;
+
+  struct curve_cache_entry *curves;
+  Py_ssize_t curve_count;
+
+  /* Dictionary of properties, NULL if to be rebuilt. */
+  PyObject *properties;
+
+  /* Number of buffers exported from columns of this document. */
+  Py_ssize_t exports;
+
+  /* Number of writes in progress with the GIL released. */
+  Py_ssize_t writers;
+
+} PySaxsDocumentObject;
+
+
+typedef struct PySaxsCurveObject {
+  PyObject_HEAD
+
   struct saxs_curve *curve;
 
+  /* The owning document, kept alive as long as the curve is around. */
+  PySaxsDocumentObject *document;
+
+  /* The position in the curve cache of the document. */
+  Py_ssize_t index;
+
 } PySaxsCurveObject;
 
+static void
+PySaxsCurveObject_dealloc(PyObject *self) {
+  PySaxsCurveObject *obj = (PySaxsCurveObject*)self;
+
+  if (obj->document) {
+    obj->document->curves[obj->index].wrapper = NULL;
+    Py_DECREF(obj->document);
+  }
+
+  Py_TYPE(self)->tp_free(self);
+}
+
+
+/*
+ * A column of a curve, exported through the buffer protocol.
+ *
+ * The buffer points directly into the data of the curve, no values
+ * are copied. As data points are stored interleaved, the buffer is
+ * strided. While any buffer is exported, no data may be added to the
+ * curves of the document as this may move the data in memory.
+ */
+typedef struct {
+  PyObject_HEAD
+
+  PySaxsDocumentObject *document;
+  const double *data;
+  Py_ssize_t shape[1];
+  Py_ssize_t strides[1];
+
+} PySaxsColumnObject;
+
+static void
+PySaxsColumnObject_dealloc(PyObject *self) {
+  PySaxsColumnObject *obj = (PySaxsColumnObject*)self;
+  Py_XDECREF(obj->document);
+
+  Py_TYPE(self)->tp_free(self);
+}
+
+static int
+PySaxsColumnObject_getbuffer(PyObject *self, Py_buffer *view, int flags) {
+  PySaxsColumnObject *obj = (PySaxsColumnObject*)self;
+  static double empty = 0.0;
+
+  if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "column is read-only");
+    return -1;
+  }
+
+  if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES
+      && obj->strides[0] != sizeof(double)) {
+    PyErr_SetString(PyExc_BufferError, "column is not contiguous");
+    return -1;
+  }
+
+  view->obj        = self;
+  view->buf        = obj->data ? (void*)obj->data : (void*)&empty;
+  view->len        = obj->shape[0] * sizeof(double);
+  view->readonly   = 1;
+  view->itemsize   = sizeof(double);
+  view->format     = (flags & PyBUF_FORMAT) ? "d" : NULL;
+  view->ndim       = 1;
+  view->shape      = (flags & PyBUF_ND) ? obj->shape : NULL;
+  view->strides    = (flags & PyBUF_STRIDES) ? obj->strides : NULL;
+  view->suboffsets = NULL;
+  view->internal   = NULL;
+
+  Py_INCREF(self);
+  obj->document->exports += 1;
+
+  return 0;
+}
+
+static void
+PySaxsColumnObject_releasebuffer(PyObject *self, Py_buffer *view) {
+  PySaxsColumnObject *obj = (PySaxsColumnObject*)self;
+  (void)view;
+
+  obj->document->exports -= 1;
+}
+
+static PyBufferProcs PySaxsColumnObject_as_buffer = {
+#if PY_MAJOR_VERSION == 2
+  NULL, NULL, NULL, NULL,
+#endif
+  PySaxsColumnObject_getbuffer,
+  PySaxsColumnObject_releasebuffer
+};
+
+static PyTypeObject PySaxsColumnObject_type = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  .tp_name = "saxsdocument.api.column",
+  .tp_doc = "Column of a curve, supports the buffer protocol",
+  .tp_basicsize = sizeof(PySaxsColumnObject),
+  .tp_itemsize = 0,
+#if PY_MAJOR_VERSION == 2
+  .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER,
+#else
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+#endif
+  .tp_dealloc = PySaxsColumnObject_dealloc,
+  .tp_as_buffer = &PySaxsColumnObject_as_buffer,
+};
+
+static PyObject*
+PySaxsColumnObject_view(PySaxsCurveObject *curve, int column) {
+  PySaxsColumnObject *obj;
+  PyObject *view;
+  size_t stride;
+
+  obj = PyObject_New(PySaxsColumnObject, &PySaxsColumnObject_type);
+  if (!obj)
+    return NULL;
+
+  obj->data       = saxs_curve_column(curve->curve, column, &stride);
+  obj->shape[0]   = saxs_curve_data_count(curve->curve);
+  obj->strides[0] = stride;
+  obj->document   = curve->document;
+  Py_INCREF(obj->document);
+
+  view = PyMemoryView_FromObject((PyObject*)obj);
+  Py_DECREF(obj);
+
+  return view;
+}
+
+/*
+ * A one- or two-dimensional array of values, exported through the
+ * buffer protocol. The values are allocated by libsaxsdocument and
+ * owned by the object.
+ */
+typedef struct {
+  PyObject_HEAD
+
+  double *data;
+  int ndim;
+  Py_ssize_t shape[2];
+  Py_ssize_t strides[2];
+
+} PySaxsArrayObject;
+
+static void
+PySaxsArrayObject_dealloc(PyObject *self) {
+  PySaxsArrayObject *obj = (PySaxsArrayObject*)self;
+  free(obj->data);
+
+  Py_TYPE(self)->tp_free(self);
+}
+
+static int
+PySaxsArrayObject_getbuffer(PyObject *self, Py_buffer *view, int flags) {
+  PySaxsArrayObject *obj = (PySaxsArrayObject*)self;
+
+  if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "array is read-only");
+    return -1;
+  }
+
+  if (obj->ndim > 1 && (flags & PyBUF_ND) != PyBUF_ND) {
+    PyErr_SetString(PyExc_BufferError, "array is multi-dimensional");
+    return -1;
+  }
+
+  view->obj        = self;
+  view->buf        = obj->data;
+  view->len        = obj->shape[0] * (obj->ndim > 1 ? obj->shape[1] : 1) * sizeof(double);
+  view->readonly   = 1;
+  view->itemsize   = sizeof(double);
+  view->format     = (flags & PyBUF_FORMAT) ? "d" : NULL;
+  view->ndim       = obj->ndim;
+  view->shape      = (flags & PyBUF_ND) ? obj->shape : NULL;
+  view->strides    = (flags & PyBUF_STRIDES) ? obj->strides : NULL;
+  view->suboffsets = NULL;
+  view->internal   = NULL;
+
+  Py_INCREF(self);
+  return 0;
+}
+
+static PyBufferProcs PySaxsArrayObject_as_buffer = {
+#if PY_MAJOR_VERSION == 2
+  NULL, NULL, NULL, NULL,
+#endif
+  PySaxsArrayObject_getbuffer,
+  NULL
+};
+
+static PyTypeObject PySaxsArrayObject_type = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  .tp_name = "saxsdocument.api.array",
+  .tp_doc = "Array of values, supports the buffer protocol",
+  .tp_basicsize = sizeof(PySaxsArrayObject),
+  .tp_itemsize = 0,
+#if PY_MAJOR_VERSION == 2
+  .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER,
+#else
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+#endif
+  .tp_dealloc = PySaxsArrayObject_dealloc,
+  .tp_as_buffer = &PySaxsArrayObject_as_buffer,
+};
+
+/*
+ * Returns a read-only memoryview of @a data with @a rows rows of
+ * @a columns values each, or a one-dimensional view if @a rows is
+ * negative. Ownership of @a data is taken in either case.
+ */
+static PyObject*
+PySaxsArrayObject_view(double *data, Py_ssize_t rows, Py_ssize_t columns) {
+  PySaxsArrayObject *obj;
+  PyObject *view;
+
+  obj = PyObject_New(PySaxsArrayObject, &PySaxsArrayObject_type);
+  if (!obj) {
+    free(data);
+    return NULL;
+  }
+
+  obj->data = data;
+  if (rows < 0) {
+    obj->ndim       = 1;
+    obj->shape[0]   = columns;
+    obj->strides[0] = sizeof(double);
+
+  } else {
+    obj->ndim       = 2;
+    obj->shape[0]   = rows;
+    obj->shape[1]   = columns;
+    obj->strides[0] = columns * sizeof(double);
+    obj->strides[1] = sizeof(double);
+  }
+
+  view = PyMemoryView_FromObject((PyObject*)obj);
+  Py_DECREF(obj);
+
+  return view;
+}
+
+/*
+ * Values of one column passed in from Python, either a list of floats
+ * or any object supporting the buffer protocol with a one-dimensional
+ * float64 or float32 layout (NumPy arrays, array.array, memoryview).
+ * Contiguous float64 buffers are used in place, everything else is
+ * converted into a temporary array.
+ */
+struct column_values {
+  Py_buffer view;
+  int has_view;
+  const double *values;
+  double *owned;
+  Py_ssize_t count;
+};
+
+static int
+column_values_get(PyObject *obj, const char *name, struct column_values *col) {
+  Py_ssize_t k;
+
+  memset(col, 0, sizeof(struct column_values));
+
+  if (PyObject_CheckBuffer(obj)) {
+    const char *format;
+    Py_ssize_t stride;
+    char *p;
+
+    if (PyObject_GetBuffer(obj, &col->view, PyBUF_STRIDES | PyBUF_FORMAT) < 0)
+      return -1;
+    col->has_view = 1;
+
+    format = col->view.format ? col->view.format : "B";
+    if (*format == '@' || *format == '=')
+      format += 1;
+
+    if (col->view.ndim != 1
+        || (strcmp(format, "d") != 0 && strcmp(format, "f") != 0)) {
+      PyErr_Format(PyExc_TypeError,
+                   "a one-dimensional buffer of float64 or float32 values is required for argument '%s'",
+                   name);
+      return -1;
+    }
+
+    col->count = col->view.shape[0];
+    stride     = col->view.strides[0];
+
+    if (*format == 'd' && stride == sizeof(double)) {
+      col->values = col->view.buf;
+      return 0;
+    }
+
+    col->owned = PyMem_Malloc((col->count ? col->count : 1) * sizeof(double));
+    if (!col->owned) {
+      PyErr_NoMemory();
+      return -1;
+    }
+
+    p = col->view.buf;
+    if (*format == 'd')
+      for (k = 0; k < col->count; ++k, p += stride)
+        col->owned[k] = *(double*)p;
+    else
+      for (k = 0; k < col->count; ++k, p += stride)
+        col->owned[k] = *(float*)p;
+
+    col->values = col->owned;
+    return 0;
+
+  } else if (PyList_Check(obj)) {
+    col->count = PyList_Size(obj);
+    col->owned = PyMem_Malloc((col->count ? col->count : 1) * sizeof(double));
+    if (!col->owned) {
+      PyErr_NoMemory();
+      return -1;
+    }
+
+    for (k = 0; k < col->count; ++k) {
+      PyObject *value = PyList_GetItem(obj, k);
+      if (!PyFloat_Check(value)) {
+        PyErr_Format(PyExc_TypeError, "floating point value required");
+        return -1;
+      }
+      col->owned[k] = PyFloat_AsDouble(value);
+    }
+
+    col->values = col->owned;
+    return 0;
+
+  } else {
+    PyErr_Format(PyExc_TypeError,
+                 "a list or buffer of values is required for argument '%s'", name);
+    return -1;
+  }
+}
+
+static void
+column_values_release(struct column_values *col) {
+  PyMem_Free(col->owned);
+  if (col->has_view)
+    PyBuffer_Release(&col->view);
+}
+
+/*
+ * Parse the (x, y, yerr) arguments of add_data and add_curve.
+ * Returns the number of data points, -1 on error.
+ */
+static Py_ssize_t
+column_values_parse(PyObject *args, struct column_values cols[3]) {
+  PyObject *x, *y, *yerr;
+
+  if (!PyArg_ParseTuple(args, "OOO", &x, &y, &yerr))
+    return -1;
+
+  memset(cols, 0, 3 * sizeof(struct column_values));
+
+  if (column_values_get(x, "x", &cols[0]) < 0
+      || column_values_get(y, "y", &cols[1]) < 0
+      || column_values_get(yerr, "yerr", &cols[2]) < 0)
+    goto error;
+
+  if (cols[0].count != cols[1].count || cols[0].count != cols[2].count) {
+    PyErr_Format(PyExc_RuntimeError, "list sizes differ (x: %ld, y: %ld, yerr: %ld)",
+                 (long)cols[0].count, (long)cols[1].count, (long)cols[2].count);
+    goto error;
+  }
+
+  if (cols[0].count > INT_MAX) {
+    PyErr_Format(PyExc_OverflowError, "too many values");
+    goto error;
+  }
+
+  return cols[0].count;
+
+error:
+  column_values_release(&cols[0]);
+  column_values_release(&cols[1]);
+  column_values_release(&cols[2]);
+  return -1;
+}
+
+static PyObject*
+column_values_add(saxs_curve *curve, struct column_values cols[3], Py_ssize_t n) {
+  int res = saxs_curve_add_data_array(curve, cols[0].values, NULL,
+                                      cols[1].values, cols[2].values, (int)n);
+
+  column_values_release(&cols[0]);
+  column_values_release(&cols[1]);
+  column_values_release(&cols[2]);
+
+  if (res != 0)
+    return PyErr_NoMemory();
+
+  Py_RETURN_NONE;
+}
+
 static PyObject*
 PySaxsCurveObject_data(PyObject *self, PyObject *args) {
   PySaxsCurveObject *obj = (PySaxsCurveObject*)self;
@@ -67,50 +509,49 @@ PySaxsCurveObject_data(PyObject *self, PyObject *args) {
 }
 
 static PyObject*
-PySaxsCurveObject_add_data(PyObject *self, PyObject *args) {
-  PyObject *x, *y, *yerr;
-
-  if (!PyArg_ParseTuple(args, "OOO", &x, &y, &yerr))
-    return NULL;
+PySaxsCurveObject_columns(PyObject *self, PyObject *args) {
+  PySaxsCurveObject *obj = (PySaxsCurveObject*)self;
+  PyObject *x, *y, *yerr, *res;
+  (void)args;
 
-  if (!PyList_Check(x))
-    return PyErr_Format(PyExc_TypeError, "a list of values is required for argument 'x'"); 
+  x    = PySaxsColumnObject_view(obj, SAXS_DATA_X);
+  y    = PySaxsColumnObject_view(obj, SAXS_DATA_Y);
+  yerr = PySaxsColumnObject_view(obj, SAXS_DATA_Y_ERR);
 
-  if (!PyList_Check(y))
-    return PyErr_Format(PyExc_TypeError, "a list of values is required for argument 'y'"); 
+  res = (x && y && yerr) ? PyTuple_Pack(3, x, y, yerr) : NULL;
 
-  if (!PyList_Check(yerr))
-    return PyErr_Format(PyExc_TypeError, "a list of values is required for argument 'yerr'"); 
+  Py_XDECREF(yerr);
+  Py_XDECREF(y);
+  Py_XDECREF(x);
 
-  Py_ssize_t k, n = PyList_Size(x);
-  if (n != PyList_Size(y) || n != PyList_Size(yerr))
-    return PyErr_Format(PyExc_RuntimeError, "list sizes differ (x: %ld, y: %ld, yerr: %ld)", 
-                        n, PyList_Size(y), PyList_Size(yerr));
+  return res;
+}
 
-  for (k = 0; k < n; ++k) {
-    PyObject *value_x = PyList_GetItem(x, k);
-    if (!PyFloat_Check(value_x))
-      return PyErr_Format(PyExc_TypeError, "floating point value required");
+static PyObject*
+PySaxsCurveObject_add_data(PyObject *self, PyObject *args) {
+  PySaxsCurveObject *obj = (PySaxsCurveObject*)self;
+  struct column_values cols[3];
+  Py_ssize_t n;
 
-    PyObject *value_y = PyList_GetItem(y, k);
-    if (!PyFloat_Check(value_y))
-      return PyErr_Format(PyExc_TypeError, "floating point value required");
+  if (obj->document->exports > 0)
+    return PyErr_Format(PyExc_BufferError, "can not add data while columns are in use");
 
-    PyObject *value_yerr = PyList_GetItem(yerr, k);
-    if (!PyFloat_Check(value_yerr))
-      return PyErr_Format(PyExc_TypeError, "floating point value required");
+  if (obj->document->writers > 0)
+    return PyErr_Format(PyExc_RuntimeError, "can not add data while the document is written");
 
-    PySaxsCurveObject *obj = (PySaxsCurveObject*)self;
-    saxs_curve_add_data(obj->curve, PyFloat_AsDouble(value_x), 0.0,
-                                    PyFloat_AsDouble(value_y), PyFloat_AsDouble(value_yerr));
-  }
+  n = column_values_parse(args, cols);
+  if (n < 0)
+    return NULL;
 
-  Py_RETURN_NONE;
+  return column_values_add(obj->curve, cols, n);
 }
 
 static PyMethodDef PySaxsCurveObject_methods[] = {
     { "data", PySaxsCurveObject_data, METH_NOARGS,
       "Returns a list of data objects" },
+    { "columns", PySaxsCurveObject_columns, METH_NOARGS,
+      "Returns read-only views (x, y, yerr) of the data without copying; "
+      "use numpy.asarray() to obtain arrays" },
     { "add_data", PySaxsCurveObject_add_data, METH_VARARGS,
       "" },
 
@@ -124,23 +565,22 @@ static PyTypeObject PySaxsCurveObject_type = {
   .tp_basicsize = sizeof(PySaxsCurveObject),
   .tp_itemsize = 0,
   .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_dealloc = PySaxsCurveObject_dealloc,
   .tp_methods = PySaxsCurveObject_methods,
 };
 
 
 
-typedef struct {
-  PyObject_HEAD
-
-  struct saxs_document *doc;
-
-} PySaxsDocumentObject;
-
 static PyObject *
 PySaxsDocumentObject_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
   PySaxsDocumentObject *obj;
   obj = (PySaxsDocumentObject *)type->tp_alloc(type, 0);
   obj->doc = saxs_document_create();
+  obj->curves = NULL;
+  obj->curve_count = 0;
+  obj->properties = NULL;
+  obj->exports = 0;
+  obj->writers = 0;
 
   return (PyObject*)obj;
 }
@@ -159,110 +599,157 @@ static void
 PySaxsDocumentObject_dealloc(PyObject *self) {
   PySaxsDocumentObject *obj = (PySaxsDocumentObject*)self;
   saxs_document_free(obj->doc);
+  PyMem_Free(obj->curves);
+  Py_XDECREF(obj->properties);
 
   Py_TYPE(self)->tp_free(self);
 }
 
-static PyObject*
-PySaxsDocumentObject_curves(PyObject *self, PyObject *args) {
-  PyObject *curves = PyList_New(0);
+/*
+ * Bring the curve cache up to date with the document; curves are
+ * only ever appended.
+ */
+static int
+PySaxsDocumentObject_update_curves(PySaxsDocumentObject *obj) {
+  Py_ssize_t k, count = saxs_document_curve_count(obj->doc);
+  struct curve_cache_entry *curves;
+  saxs_curve *curve;
 
-  PySaxsDocumentObject *obj = (PySaxsDocumentObject*)self;
-  saxs_curve *curve = saxs_document_curve(obj->doc);
-  while (curve) {
-    PySaxsCurveObject *c = (PySaxsCurveObject*)PyType_GenericNew(&PySaxsCurveObject_type, Py_None, Py_None);
-    c->curve = curve;
-    PyList_Append(curves, (PyObject*)c);
-    Py_DECREF(c);
+  if (count == obj->curve_count)
+    return 0;
 
+  curves = PyMem_Realloc(obj->curves, count * sizeof(struct curve_cache_entry));
+  if (!curves) {
+    PyErr_NoMemory();
+    return -1;
+  }
+
+  curve = obj->curve_count > 0 ? saxs_curve_next(curves[obj->curve_count - 1].curve)
+                               : saxs_document_curve(obj->doc);
+  for (k = obj->curve_count; k < count; ++k) {
+    curves[k].curve   = curve;
+    curves[k].wrapper = NULL;
     curve = saxs_curve_next(curve);
   }
 
-  return curves;
+  obj->curves      = curves;
+  obj->curve_count = count;
+
+  return 0;
+}
+
+static Py_ssize_t
+PySaxsDocumentObject_length(PyObject *self) {
+  PySaxsDocumentObject *obj = (PySaxsDocumentObject*)self;
+  return saxs_document_curve_count(obj->doc);
 }
 
 static PyObject*
-PySaxsDocumentObject_curve(PyObject *self, PyObject *args) {
-  Py_ssize_t n;
+PySaxsDocumentObject_item(PyObject *self, Py_ssize_t n) {
+  PySaxsDocumentObject *obj = (PySaxsDocumentObject*)self;
+  PySaxsCurveObject *c;
 
-  if (!PyArg_ParseTuple(args, "n", &n))
+  if (PySaxsDocumentObject_update_curves(obj) < 0)
     return NULL;
 
-  PyObject *curves = PySaxsDocumentObject_curves(self, Py_None);
-  PyObject *curve  = PyList_GetItem(curves, n);
+  if (n < 0 || n >= obj->curve_count)
+    return PyErr_Format(PyExc_IndexError, "curve index out of range");
 
-  if (!curve) {
-    Py_DECREF(curves);
-    return NULL;
+  c = obj->curves[n].wrapper;
+  if (c) {
+    Py_INCREF(c);
 
   } else {
-    Py_INCREF(curve);
-    Py_DECREF(curves);
-    return curve;
+    c = (PySaxsCurveObject*)PyType_GenericNew(&PySaxsCurveObject_type, Py_None, Py_None);
+    if (!c)
+      return NULL;
+
+    c->curve = obj->curves[n].curve;
+    c->document = obj;
+    c->index = n;
+    Py_INCREF(obj);
+
+    obj->curves[n].wrapper = c;
   }
+
+  return (PyObject*)c;
 }
 
 static PyObject*
-PySaxsDocumentObject_add_curve(PyObject *self, PyObject *args) {
-  PyObject *x, *y, *yerr;
+PySaxsDocumentObject_curves(PyObject *self, PyObject *args) {
+  Py_ssize_t k, n = PySaxsDocumentObject_length(self);
+  PyObject *curves = PyList_New(n);
+  (void)args;
+
+  for (k = 0; curves && k < n; ++k) {
+    PyObject *c = PySaxsDocumentObject_item(self, k);
+    if (!c) {
+      Py_DECREF(curves);
+      return NULL;
+    }
+    PyList_SET_ITEM(curves, k, c);
+  }
 
-  if (!PyArg_ParseTuple(args, "OOO", &x, &y, &yerr))
-    return NULL;
+  return curves;
+}
 
-  if (!PyList_Check(x))
-    return PyErr_Format(PyExc_TypeError, "a list of values is required for argument 'x'");
+static PyObject*
+PySaxsDocumentObject_curve(PyObject *self, PyObject *args) {
+  Py_ssize_t n;
 
-  if (!PyList_Check(y))
-    return PyErr_Format(PyExc_TypeError, "a list of values is required for argument 'y'");
+  if (!PyArg_ParseTuple(args, "n", &n))
+    return NULL;
 
-  if (!PyList_Check(yerr))
-    return PyErr_Format(PyExc_TypeError, "a list of values is required for argument 'yerr'");
+  /* Negative indices count from the end, as with lists. */
+  if (n < 0)
+    n += PySaxsDocumentObject_length(self);
 
-  Py_ssize_t k, n = PyList_Size(x);
-  if (n != PyList_Size(y) || n != PyList_Size(yerr))
-    return PyErr_Format(PyExc_RuntimeError, "list sizes differ (x: %ld, y: %ld, yerr: %ld)",
-                        n, PyList_Size(y), PyList_Size(yerr));
+  return PySaxsDocumentObject_item(self, n);
+}
 
+static PyObject*
+PySaxsDocumentObject_add_curve(PyObject *self, PyObject *args) {
   PySaxsDocumentObject *obj = (PySaxsDocumentObject*)self;
-  saxs_curve *curve = saxs_document_add_curve(obj->doc, "", SAXS_CURVE_EXPERIMENTAL_SCATTERING_DATA);
-
-  for (k = 0; k < n; ++k) {
-    PyObject *value_x = PyList_GetItem(x, k);
-    if (!PyFloat_Check(value_x))
-      return PyErr_Format(PyExc_TypeError, "floating point value required");
+  struct column_values cols[3];
+  Py_ssize_t n;
 
-    PyObject *value_y = PyList_GetItem(y, k);
-    if (!PyFloat_Check(value_y))
-      return PyErr_Format(PyExc_TypeError, "floating point value required");
+  if (obj->writers > 0)
+    return PyErr_Format(PyExc_RuntimeError, "can not add data while the document is written");
 
-    PyObject *value_yerr = PyList_GetItem(yerr, k);
-    if (!PyFloat_Check(value_yerr))
-      return PyErr_Format(PyExc_TypeError, "floating point value required");
+  n = column_values_parse(args, cols);
+  if (n < 0)
+    return NULL;
 
-    saxs_curve_add_data(curve, PyFloat_AsDouble(value_x), 0.0,
-                               PyFloat_AsDouble(value_y), PyFloat_AsDouble(value_yerr));
-  }
+  saxs_curve *curve = saxs_document_add_curve(obj->doc, "", SAXS_CURVE_EXPERIMENTAL_SCATTERING_DATA);
 
-  Py_RETURN_NONE;
+  return column_values_add(curve, cols, n);
 }
 
 static PyObject*
 PySaxsDocumentObject_properties(PyObject *self, PyObject *args) {
-  PyObject *properties = PyDict_New();
-
   PySaxsDocumentObject *obj = (PySaxsDocumentObject*)self;
-  saxs_property *property = saxs_document_property_first(obj->doc);
-  while (property) {
-    PyObject *key = PyUnicode_FromFormat("%s", saxs_property_name(property));
-    PyObject *val = PyUnicode_FromFormat("%s", saxs_property_value(property));
-    PyDict_SetItem(properties, key, val);
-    Py_DECREF(val);
-    Py_DECREF(key);
-
-    property = saxs_property_next(property);
+
+  if (!obj->properties) {
+    PyObject *properties = PyDict_New();
+    if (!properties)
+      return NULL;
+
+    saxs_property *property = saxs_document_property_first(obj->doc);
+    while (property) {
+      PyObject *key = PyUnicode_FromFormat("%s", saxs_property_name(property));
+      PyObject *val = PyUnicode_FromFormat("%s", saxs_property_value(property));
+      PyDict_SetItem(properties, key, val);
+      Py_DECREF(val);
+      Py_DECREF(key);
+
+      property = saxs_property_next(property);
+    }
+
+    obj->properties = properties;
   }
 
-  return properties;
+  /* A copy, the caller may modify it. */
+  return PyDict_Copy(obj->properties);
 }
 
 static PyObject*
@@ -275,6 +762,12 @@ PySaxsDocumentObject_add_properties(PyObject *self, PyObject *args) {
   if (!PyDict_Check(properties))
     return PyErr_Format(PyExc_TypeError, "dictionary required");
 
+  if (((PySaxsDocumentObject*)self)->writers > 0)
+    return PyErr_Format(PyExc_RuntimeError, "can not add data while the document is written");
+
+  PySaxsDocumentObject *obj = (PySaxsDocumentObject*)self;
+  Py_CLEAR(obj->properties);
+
   PyObject *key, *val;
   Py_ssize_t pos = 0;
 
@@ -282,7 +775,6 @@ PySaxsDocumentObject_add_properties(PyObject *self, PyObject *args) {
     PyObject *key_str = PyObject_Str(key);
     PyObject *val_str = PyObject_Str(val);
 
-    PySaxsDocumentObject *obj = (PySaxsDocumentObject*)self;
     saxs_document_add_property(obj->doc, PyUnicode_AsUTF8(key_str),
                                          PyUnicode_AsUTF8(val_str));
 
@@ -300,10 +792,14 @@ PySaxsDocumentObject_add_property(PyObject *self, PyObject *args) {
   if (!PyArg_ParseTuple(args, "OO", &key, &val))
     return NULL;
 
-  PyObject *properties = PyDict_New();
-  PyDict_SetItem(properties, key, val);
+  PyObject *properties = Py_BuildValue("({O:O})", key, val);
+  if (!properties)
+    return NULL;
+
+  PyObject *res = PySaxsDocumentObject_add_properties(self, properties);
+  Py_DECREF(properties);
 
-  return PySaxsDocumentObject_add_properties(self, properties);
+  return res;
 }
 
 static PyObject*
@@ -314,8 +810,18 @@ PySaxsDocumentObject_write(PyObject *self, PyObject *args) {
     return NULL;
 
   PySaxsDocumentObject *obj = (PySaxsDocumentObject*) self;
+  int result;
+
+  /*
+   * Other threads may run while the file is written, but they must not
+   * modify the document meanwhile; concurrent writes are fine.
+   */
+  obj->writers += 1;
+  Py_BEGIN_ALLOW_THREADS
+  result = saxs_document_write(obj->doc, filename, format);
+  Py_END_ALLOW_THREADS
+  obj->writers -= 1;
 
-  int result = saxs_document_write(obj->doc, filename, format);
   if (result) {
     errno = result;
     return PyErr_SetFromErrnoWithFilename(PyExc_IOError, filename);
@@ -343,6 +849,11 @@ static PyMethodDef PySaxsDocumentObject_methods[] = {
     {NULL}  /* Sentinel */
 };
 
+static PySequenceMethods PySaxsDocumentObject_as_sequence = {
+  .sq_length = PySaxsDocumentObject_length,
+  .sq_item = PySaxsDocumentObject_item,
+};
+
 static PyTypeObject PySaxsDocumentObject_type = {
   PyVarObject_HEAD_INIT(NULL, 0)
   .tp_name = "saxsdocument.api.document",
@@ -350,6 +861,7 @@ static PyTypeObject PySaxsDocumentObject_type = {
   .tp_basicsize = sizeof(PySaxsDocumentObject),
   .tp_itemsize = 0,
   .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_as_sequence = &PySaxsDocumentObject_as_sequence,
   .tp_new = PySaxsDocumentObject_new,
   .tp_init = PySaxsDocumentObject_init,
   .tp_dealloc = PySaxsDocumentObject_dealloc,
@@ -371,9 +883,15 @@ saxsdocument_api_read(PyObject *self, PyObject *args) {
     return NULL;
 
   PySaxsDocumentObject *obj = (PySaxsDocumentObject*) PySaxsDocumentObject_new(&PySaxsDocumentObject_type, NULL, NULL);
+  int result;
+
+  /* The document is not visible to other threads yet. */
+  Py_BEGIN_ALLOW_THREADS
+  result = saxs_document_read(obj->doc, filename, format);
+  Py_END_ALLOW_THREADS
 
-  int result = saxs_document_read(obj->doc, filename, format);
   if (result) {
+    Py_DECREF(obj);
     errno = result;
     return PyErr_SetFromErrnoWithFilename(PyExc_IOError, filename);
   }
@@ -381,9 +899,192 @@ saxsdocument_api_read(PyObject *self, PyObject *args) {
   return (PyObject*)obj;
 }
 
+static PyObject*
+saxsdocument_api_read_many(PyObject *self, PyObject *args, PyObject *kwargs) {
+  static char *keywords[] = { "filenames", "threads", "format", NULL };
+  PyObject *filenames, *seq, *list = NULL;
+  const char **infiles = NULL, **formats = NULL;
+  saxs_document **docs = NULL;
+  char *format = NULL;
+  int *results = NULL;
+  int nthreads = 0, result;
+  Py_ssize_t k, n;
+  (void)self;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|iz", keywords,
+                                   &filenames, &nthreads, &format))
+    return NULL;
+
+  seq = PySequence_Fast(filenames, "a sequence of filenames is required");
+  if (!seq)
+    return NULL;
+
+  n = PySequence_Fast_GET_SIZE(seq);
+
+  infiles = PyMem_Malloc((n ? n : 1) * sizeof(const char*));
+  formats = PyMem_Malloc((n ? n : 1) * sizeof(const char*));
+  docs    = PyMem_Malloc((n ? n : 1) * sizeof(saxs_document*));
+  results = PyMem_Malloc((n ? n : 1) * sizeof(int));
+  if (!infiles || !formats || !docs || !results) {
+    PyErr_NoMemory();
+    goto out;
+  }
+
+  for (k = 0; k < n; ++k) {
+    infiles[k] = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, k));
+    if (!infiles[k])
+      goto out;
+    formats[k] = format;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  result = saxs_document_read_many(docs, results, infiles, formats,
+                                   (size_t)n, nthreads);
+  Py_END_ALLOW_THREADS
+
+  if (result) {
+    for (k = 0; k < n; ++k)
+      if (docs[k])
+        saxs_document_free(docs[k]);
+
+    for (k = 0; k < n && results[k] == 0; ++k)
+      ;
+
+    errno = result;
+    PyErr_SetFromErrnoWithFilename(PyExc_IOError, k < n ? (char*)infiles[k] : NULL);
+    goto out;
+  }
+
+  list = PyList_New(n);
+  for (k = 0; list && k < n; ++k) {
+    PySaxsDocumentObject *obj = (PySaxsDocumentObject*) PySaxsDocumentObject_new(&PySaxsDocumentObject_type, NULL, NULL);
+    saxs_document_free(obj->doc);
+    obj->doc = docs[k];
+    docs[k] = NULL;
+    PyList_SET_ITEM(list, k, (PyObject*)obj);
+  }
+
+  if (!list)
+    for (k = 0; k < n; ++k)
+      saxs_document_free(docs[k]);
+
+out:
+  PyMem_Free(results);
+  PyMem_Free(docs);
+  PyMem_Free(formats);
+  PyMem_Free(infiles);
+  Py_DECREF(seq);
+
+  return list;
+}
+
+static PyObject*
+saxsdocument_api_read_stack(PyObject *self, PyObject *args, PyObject *kwargs) {
+  static char *keywords[] = { "filenames", "threads", "format", "grid", "interpolate", NULL };
+  PyObject *filenames, *seq, *gridobj = Py_None, *res = NULL;
+  PyObject *xview = NULL, *yview = NULL, *yerrview = NULL;
+  struct column_values grid;
+  const char **infiles = NULL;
+  double *x, *y, *y_err;
+  char *format = NULL;
+  int *results = NULL;
+  int nthreads = 0, interpolate = 0, result;
+  size_t columns;
+  Py_ssize_t k, n;
+  (void)self;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|izOi", keywords,
+                                   &filenames, &nthreads, &format,
+                                   &gridobj, &interpolate))
+    return NULL;
+
+  memset(&grid, 0, sizeof(struct column_values));
+  if (gridobj != Py_None && column_values_get(gridobj, "grid", &grid) < 0) {
+    column_values_release(&grid);
+    return NULL;
+  }
+
+  seq = PySequence_Fast(filenames, "a sequence of filenames is required");
+  if (!seq) {
+    column_values_release(&grid);
+    return NULL;
+  }
+
+  n = PySequence_Fast_GET_SIZE(seq);
+
+  infiles = PyMem_Malloc((n ? n : 1) * sizeof(const char*));
+  results = PyMem_Malloc((n ? n : 1) * sizeof(int));
+  if (!infiles || !results) {
+    PyErr_NoMemory();
+    goto out;
+  }
+
+  for (k = 0; k < n; ++k) {
+    infiles[k] = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, k));
+    if (!infiles[k])
+      goto out;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  result = saxs_document_read_stack(infiles, format, (size_t)n,
+                                    gridobj != Py_None ? grid.values : NULL,
+                                    (size_t)grid.count,
+                                    interpolate ? SAXS_STACK_INTERPOLATE : 0,
+                                    nthreads, &x, &y, &y_err, &columns,
+                                    results);
+  Py_END_ALLOW_THREADS
+
+  if (result) {
+    free(x);
+    free(y);
+    free(y_err);
+
+    for (k = 0; k < n && results[k] == 0; ++k)
+      ;
+
+    if (k < n) {
+      errno = result;
+      PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char*)infiles[k]);
+    } else
+      PyErr_NoMemory();
+
+    goto out;
+  }
+
+  xview    = PySaxsArrayObject_view(x, -1, columns);
+  yview    = PySaxsArrayObject_view(y, n, columns);
+  yerrview = PySaxsArrayObject_view(y_err, n, columns);
+
+  if (xview && yview && yerrview)
+    res = PyTuple_Pack(3, xview, yview, yerrview);
+
+  Py_XDECREF(yerrview);
+  Py_XDECREF(yview);
+  Py_XDECREF(xview);
+
+out:
+  PyMem_Free(results);
+  PyMem_Free(infiles);
+  Py_DECREF(seq);
+  column_values_release(&grid);
+
+  return res;
+}
+
 static PyMethodDef saxsdocument_api_module_methods[] = {
   { "create", saxsdocument_api_create, METH_NOARGS, "" },
   { "read", saxsdocument_api_read, METH_VARARGS, "" },
+  { "read_many", (PyCFunction)(void(*)(void))saxsdocument_api_read_many, METH_VARARGS | METH_KEYWORDS,
+    "read_many(filenames, threads=0, format=None)\n\n"
+    "Reads all files in parallel, returns a list of documents in input order. "
+    "If threads is 0, one thread per processor is used." },
+  { "read_stack", (PyCFunction)(void(*)(void))saxsdocument_api_read_stack, METH_VARARGS | METH_KEYWORDS,
+    "read_stack(filenames, threads=0, format=None, grid=None, interpolate=False)\n\n"
+    "Reads the first scattering curve of all files in parallel, returns a tuple "
+    "(s, I, err) of the common grid and frames by points matrices of intensities "
+    "and errors. Without a grid, the first file defines it; curves that do not "
+    "share it are an error unless interpolate is set. "
+    "Use numpy.asarray() to obtain arrays without copying." },
   { NULL, NULL, 0, NULL }
 };
 
@@ -393,6 +1094,12 @@ PyMODINIT_FUNC initapi(void) {
   if (PyType_Ready(&PySaxsCurveObject_type) < 0)
     return;
 
+  if (PyType_Ready(&PySaxsColumnObject_type) < 0)
+    return;
+
+  if (PyType_Ready(&PySaxsArrayObject_type) < 0)
+    return;
+
   if (PyType_Ready(&PySaxsDocumentObject_type) < 0)
     return;
 
@@ -414,6 +1121,12 @@ PyMODINIT_FUNC PyInit_api(void) {
   if (PyType_Ready(&PySaxsCurveObject_type) < 0)
     return NULL;
 
+  if (PyType_Ready(&PySaxsColumnObject_type) < 0)
+    return NULL;
+
+  if (PyType_Ready(&PySaxsArrayObject_type) < 0)
+    return NULL;
+
   if (PyType_Ready(&PySaxsDocumentObject_type) < 0)
     return NULL;
 
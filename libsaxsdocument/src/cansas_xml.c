@@ -56,25 +56,30 @@ cansas_read_callback(const struct line **line, char *buffer, int len) {
  * Node names are based on r32 of
  *   http://svn.smallangles.net/trac/canSAS/browser/1dwg/trunk/cansas1d.xsd
  */
-static void cansas_xml_1_0_process_node(saxs_document *doc, xmlTextReaderPtr reader) {
-  static xmlChar *text;
-  static saxs_curve *curve = NULL;
-  static double x = 0.0, dx = 0.0, y = 0.0, dy = 0.0;
-
+struct cansas_xml_1_0_state {
+  xmlChar *text;
+  saxs_curve *curve;
+  double x, dx, y, dy;
+};
+
+static void cansas_xml_1_0_process_node(saxs_document *doc,
+                                        xmlTextReaderPtr reader,
+                                        struct cansas_xml_1_0_state *state) {
   xmlChar *name;
+  const char *text = state->text ? (const char *)state->text : "";
 
   switch (xmlTextReaderNodeType(reader)) {
     case XML_READER_TYPE_ELEMENT:
       name = xmlTextReaderLocalName(reader);
       if (xmlStrEqual(name, BAD_CAST("SASdata"))) {
         xmlChar *title = xmlTextReaderGetAttribute(reader, BAD_CAST("name"));
-        curve = saxs_document_add_curve(doc, (const char*)title,
-                                        SAXS_CURVE_EXPERIMENTAL_SCATTERING_DATA);
+        state->curve = saxs_document_add_curve(doc, (const char*)title,
+                                               SAXS_CURVE_EXPERIMENTAL_SCATTERING_DATA);
         if (title)
           xmlFree(title);
 
       } else if (xmlStrEqual(name, BAD_CAST("Idata"))) {
-        x = dx = y = dy = 0.0;
+        state->x = state->dx = state->y = state->dy = 0.0;
       }
       xmlFree(name);
       break;
@@ -82,28 +87,29 @@ static void cansas_xml_1_0_process_node(saxs_document *doc, xmlTextReaderPtr rea
     case XML_READER_TYPE_END_ELEMENT:
       name = xmlTextReaderLocalName(reader);
       if (xmlStrEqual(name, BAD_CAST("Q"))) {
-        x = strtod((const char *)text, NULL);
+        state->x = strtod(text, NULL);
 
       } else if (xmlStrEqual(name, BAD_CAST("Qdev"))) {
-        dx = strtod((const char *)text, NULL);
+        state->dx = strtod(text, NULL);
 
       } else if (xmlStrEqual(name, BAD_CAST("I"))) {
-        y = strtod((const char *)text, NULL);
+        state->y = strtod(text, NULL);
 
       } else if (xmlStrEqual(name, BAD_CAST("Idev"))) {
-        dy = strtod((const char *)text, NULL);
+        state->dy = strtod(text, NULL);
 
       } else if (xmlStrEqual(name, BAD_CAST("Idata"))) {
-        if (!curve) {return;} // No opportunity to return an error code here
-        saxs_curve_add_data(curve, x, dx, y, dy);
+        if (!state->curve) {return;} // No opportunity to return an error code here
+        saxs_curve_add_data(state->curve, state->x, state->dx,
+                            state->y, state->dy);
       }
       xmlFree(name);
       break;
 
     case XML_READER_TYPE_TEXT:
-      if (text)
-        xmlFree(text);
-      text = xmlTextReaderValue(reader);
+      if (state->text)
+        xmlFree(state->text);
+      state->text = xmlTextReaderValue(reader);
       break;
   }
 }
@@ -126,6 +132,7 @@ int cansas_xml_1_0_read(saxs_document *doc,
    * [2] http://mail.gnome.org/archives/xml/2009-September/msg00072.html
    */
   xmlTextReaderPtr reader;
+  struct cansas_xml_1_0_state state = { NULL, NULL, 0.0, 0.0, 0.0, 0.0 };
 
   xmlDocPtr xmldoc = xmlReadIO((xmlInputReadCallback)cansas_read_callback,
                                NULL, &firstline, NULL, NULL,
@@ -134,8 +141,10 @@ int cansas_xml_1_0_read(saxs_document *doc,
     return EINVAL;
 
   reader = xmlReaderWalker(xmldoc);
-  if (!reader)
+  if (!reader) {
+    xmlFreeDoc(xmldoc);
     return EINVAL;
+  }
 
   /* Check the first node that this is the right document version. */
   while (xmlTextReaderRead(reader) == 1) {
@@ -168,7 +177,10 @@ int cansas_xml_1_0_read(saxs_document *doc,
 
   /* Ok, now read all the nodes. */
   while (xmlTextReaderRead(reader) == 1)
-    cansas_xml_1_0_process_node(doc, reader);
+    cansas_xml_1_0_process_node(doc, reader, &state);
+
+  if (state.text)
+    xmlFree(state.text);
 
   xmlFreeTextReader(reader);
   xmlFreeDoc(xmldoc);
@@ -184,5 +196,11 @@ saxs_document_format_register_cansas_xml() {
      cansas_xml_1_0_read, NULL, NULL
   };
 
+  /*
+   * The parser must be initialized from a single thread
+   * before documents may be read concurrently.
+   */
+  xmlInitParser();
+
   saxs_document_format_register(&cansas_xml);
 }
@@ -34,6 +34,12 @@
 #include <locale.h>
 #include <stdio.h>
 
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+#include "saxsthreadpool.h"
+
 #ifndef DBL_EPSILON
 #define DBL_EPSILON 1e-16
 #endif
@@ -57,9 +63,14 @@ struct saxs_curve {
   char *curve_title;
   int curve_type;
 
+  /*
+   * Data points are kept in one contiguous array, the links between
+   * them are maintained for saxs_data_next() only. Thus, columns may
+   * be accessed as strided arrays (see saxs_curve_column()).
+   */
   int curve_data_count;
-  saxs_data *curve_data_head;
-  saxs_data *curve_data_tail;
+  int curve_data_capacity;
+  saxs_data *curve_data;
 
   struct saxs_curve *next;
 };
@@ -110,25 +121,20 @@ static void assert_valid_curve(const struct saxs_curve *curve) {
       || curve->curve_type == SAXS_CURVE_PROBABILITY_DATA
       || curve->curve_type == SAXS_CURVE_USER_DATA);
   
+  assert(curve->curve_data_count <= curve->curve_data_capacity);
+
   if (curve->curve_data_count > 0) {
-    assert_valid_data(curve->curve_data_head);
-    // Yes, the tail is checked twice (also during the subsequent loop)
-    // but this is only the case when everything is valid
-    assert_valid_data(curve->curve_data_tail);
-    
-    assert(curve->curve_data_tail->next == NULL);
-    
-    const struct saxs_data *data = curve->curve_data_head;
-    int count = 1;  // head counts as one
-    while(data != curve->curve_data_tail) {
-      data = data->next;
+    const struct saxs_data *data = curve->curve_data;
+    int count = 0;
+    while (data) {
       assert_valid_data(data);
+      assert(data == curve->curve_data + count);
+      data = data->next;
       ++count;
     }
     assert(count == curve->curve_data_count);
   } else {
-    assert(curve->curve_data_head == NULL);
-    assert(curve->curve_data_tail == NULL);
+    assert(curve->curve_data_capacity > 0 || curve->curve_data == NULL);
   }
 }
 
@@ -177,11 +183,7 @@ static void saxs_curve_free(struct saxs_curve *curve) {
   assert_valid_curve_or_null(curve);
   
   if (curve) {
-    while (curve->curve_data_head) {
-      saxs_data *d = curve->curve_data_head;
-      curve->curve_data_head = curve->curve_data_head->next;
-      free(d);
-    }
+    free(curve->curve_data);
 
     if (curve->curve_title)
       free(curve->curve_title);
@@ -189,6 +191,66 @@ static void saxs_curve_free(struct saxs_curve *curve) {
   }
 }
 
+/*
+ * Numbers are read and written in the "C" locale, independent of the
+ * locale of the application. The locale is switched for the calling
+ * thread only, such that documents may be read in parallel and other
+ * threads (e.g. a GUI) keep their settings.
+ */
+struct numeric_locale {
+#ifdef _WIN32
+  int config;
+  char *name;
+#else
+  locale_t c_locale, old_locale;
+#endif
+};
+
+static int numeric_locale_set_c(struct numeric_locale *loc) {
+#ifdef _WIN32
+  const char *name;
+
+  loc->config = _configthreadlocale(_ENABLE_PER_THREAD_LOCALE);
+  name = setlocale(LC_NUMERIC, NULL);
+  loc->name = name ? strdup(name) : NULL;
+
+  return setlocale(LC_NUMERIC, "C") ? 0 : -1;
+#else
+  locale_t base;
+
+  loc->old_locale = uselocale((locale_t)0);
+  loc->c_locale = (locale_t)0;
+
+  base = duplocale(loc->old_locale);
+  if (base == (locale_t)0)
+    return -1;
+
+  loc->c_locale = newlocale(LC_NUMERIC_MASK, "C", base);
+  if (loc->c_locale == (locale_t)0) {
+    freelocale(base);
+    return -1;
+  }
+
+  uselocale(loc->c_locale);
+  return 0;
+#endif
+}
+
+static void numeric_locale_restore(struct numeric_locale *loc) {
+#ifdef _WIN32
+  if (loc->name) {
+    setlocale(LC_NUMERIC, loc->name);
+    free(loc->name);
+  }
+  _configthreadlocale(loc->config);
+#else
+  if (loc->c_locale != (locale_t)0) {
+    uselocale(loc->old_locale);
+    freelocale(loc->c_locale);
+  }
+#endif
+}
+
 static int test_locale() {
   float d;
   char s[64];
@@ -249,8 +311,8 @@ int saxs_document_read(saxs_document *doc, const char *filename,
     return res;
 
   /* Set the locale to "C" and check that numbers are read correctly */
-  const char *oldlocale = setlocale(LC_NUMERIC, "C");
-  if (!oldlocale) {
+  struct numeric_locale locale;
+  if (numeric_locale_set_c(&locale)) {
     fprintf(stderr, "Warning: Could not set numeric locale to 'C', this may result in incorrect data being read\n");
   }
 
@@ -339,7 +401,9 @@ int saxs_document_read(saxs_document *doc, const char *filename,
     doc->doc_properties = tmpdoc->doc_properties;
     tmpdoc->doc_properties = swap_helper.doc_properties;
 
+    swap_helper.doc_curve_count = doc->doc_curve_count;
     doc->doc_curve_count = tmpdoc->doc_curve_count;
+    tmpdoc->doc_curve_count = swap_helper.doc_curve_count;
     swap_helper.doc_curves_head = doc->doc_curves_head;
     doc->doc_curves_head = tmpdoc->doc_curves_head;
     tmpdoc->doc_curves_head = swap_helper.doc_curves_head;
@@ -353,7 +417,7 @@ int saxs_document_read(saxs_document *doc, const char *filename,
   }
 
   lines_free(l);
-  setlocale(LC_NUMERIC, oldlocale);
+  numeric_locale_restore(&locale);
   assert_valid_document(doc);
   return res;
 }
@@ -365,8 +429,8 @@ int saxs_document_write(saxs_document *doc, const char *filename,
   int res = ENOTSUP;
 
   /* Set the locale to "C" and check that numbers are read correctly */
-  const char *oldlocale = setlocale(LC_NUMERIC, "C");
-  if (!oldlocale) {
+  struct numeric_locale locale;
+  if (numeric_locale_set_c(&locale)) {
     fprintf(stderr, "Could not set numeric locale to 'C', this may result in incorrect data being read");
   }
 
@@ -429,11 +493,427 @@ int saxs_document_write(saxs_document *doc, const char *filename,
   }
 
   lines_free(l);
-  setlocale(LC_NUMERIC, oldlocale);
+  numeric_locale_restore(&locale);
   assert_valid_document(doc);
   return res;
 }
 
+/*
+ * The calling thread takes part in the work, a private
+ * pool thus needs one thread less than requested.
+ */
+static saxs_thread_pool* read_pool_acquire(int nthreads) {
+  if (nthreads <= 0)
+    return saxs_thread_pool_default();
+  else if (nthreads > 1)
+    return saxs_thread_pool_create(nthreads - 1);
+  else
+    return NULL;
+}
+
+static void read_pool_release(saxs_thread_pool *pool, int nthreads) {
+  if (nthreads > 1)
+    saxs_thread_pool_free(pool);
+}
+
+struct read_many_args {
+  saxs_document **docs;
+  int *results;
+  const char **infiles;
+  const char **formats;
+};
+
+static void read_many_one(void *arg, size_t i) {
+  struct read_many_args *args = arg;
+  const char *format = args->formats ? args->formats[i] : NULL;
+  saxs_document *doc = saxs_document_create();
+  int res = ENOMEM;
+
+  if (doc) {
+    res = saxs_document_read(doc, args->infiles[i], format);
+    if (res != 0) {
+      saxs_document_free(doc);
+      doc = NULL;
+    }
+  }
+
+  args->docs[i] = doc;
+  args->results[i] = res;
+}
+
+int saxs_document_read_many(saxs_document **docs, int *results,
+                            const char **infiles, const char **formats,
+                            size_t count, int nthreads) {
+  struct read_many_args args;
+  saxs_thread_pool *pool;
+  int *status = results;
+  int res = 0;
+  size_t i;
+
+  if (!status) {
+    status = malloc(count * sizeof(int));
+    if (!status && count > 0)
+      return ENOMEM;
+  }
+
+  args.docs    = docs;
+  args.results = status;
+  args.infiles = infiles;
+  args.formats = formats;
+
+  pool = read_pool_acquire(nthreads);
+  saxs_thread_pool_for(pool, count, read_many_one, &args);
+  read_pool_release(pool, nthreads);
+
+  for (i = 0; i < count && res == 0; ++i)
+    res = status[i];
+
+  if (status != results)
+    free(status);
+
+  return res;
+}
+
+/*
+ * Fill one row of a stack from a curve. The curve must either share
+ * the grid, or, if interpolation is allowed, be sorted by x; grid
+ * points outside of the range of the curve are set to NaN.
+ */
+static int read_stack_row(const saxs_curve *curve,
+                          const double *grid, size_t npoints, int flags,
+                          double *y, double *y_err) {
+  const saxs_data *data;
+  size_t i, j, n;
+
+  if (!curve)
+    return EINVAL;
+
+  data = curve->curve_data;
+  n = curve->curve_data_count;
+
+  if (n == npoints) {
+    for (i = 0; i < n; ++i)
+      if (fabs(data[i].x - grid[i]) > 1e-6 * fmax(fabs(data[i].x), fabs(grid[i])))
+        break;
+
+    if (i == n) {
+      for (i = 0; i < n; ++i) {
+        y[i]     = data[i].y;
+        y_err[i] = data[i].y_err;
+      }
+      return 0;
+    }
+  }
+
+  if (!(flags & SAXS_STACK_INTERPOLATE))
+    return EINVAL;
+
+  for (j = 1; j < n; ++j)
+    if (data[j].x <= data[j - 1].x)
+      return EINVAL;
+
+  for (i = 0, j = 0; i < npoints; ++i) {
+    if (n == 0 || grid[i] < data[0].x || grid[i] > data[n - 1].x) {
+      y[i] = y_err[i] = NAN;
+      continue;
+    }
+
+    while (j + 1 < n && data[j + 1].x < grid[i])
+      ++j;
+
+    if (j + 1 == n || data[j].x == grid[i]) {
+      y[i]     = data[j].y;
+      y_err[i] = data[j].y_err;
+
+    } else {
+      double t = (grid[i] - data[j].x) / (data[j + 1].x - data[j].x);
+      y[i]     = data[j].y + t * (data[j + 1].y - data[j].y);
+      y_err[i] = data[j].y_err + t * (data[j + 1].y_err - data[j].y_err);
+    }
+  }
+
+  return 0;
+}
+
+struct read_stack_args {
+  const char **infiles;
+  const char *format;
+  const double *grid;
+  size_t npoints;
+  int flags;
+  double *y, *y_err;
+  int *results;
+
+  /*
+   * Files read already while looking for the grid; all but the last
+   * one failed, the last one defined the grid (if any did).
+   */
+  size_t known;
+  const saxs_curve *first;
+};
+
+static void read_stack_one(void *arg, size_t i) {
+  struct read_stack_args *args = arg;
+  double *y     = args->y + i * args->npoints;
+  double *y_err = args->y_err + i * args->npoints;
+  saxs_document *doc;
+  size_t k;
+  int res = ENOMEM;
+
+  if (i < args->known) {
+    res = args->results[i];
+    if (res == 0)
+      res = read_stack_row(args->first, args->grid, args->npoints,
+                           args->flags, y, y_err);
+
+  } else if ((doc = saxs_document_create())) {
+    res = saxs_document_read(doc, args->infiles[i], args->format);
+    if (res == 0)
+      res = read_stack_row(saxs_document_curve_find(doc, SAXS_CURVE_SCATTERING_DATA),
+                           args->grid, args->npoints, args->flags, y, y_err);
+    saxs_document_free(doc);
+  }
+
+  if (res != 0)
+    for (k = 0; k < args->npoints; ++k)
+      y[k] = y_err[k] = NAN;
+
+  args->results[i] = res;
+}
+
+int saxs_document_read_stack(const char **infiles, const char *format,
+                             size_t count, const double *grid, size_t npoints,
+                             int flags, int nthreads,
+                             double **x, double **y, double **y_err,
+                             size_t *columns, int *results) {
+  struct read_stack_args args;
+  saxs_thread_pool *pool;
+  saxs_document *first = NULL;
+  const saxs_curve *first_curve = NULL;
+  double *xs = NULL, *ys = NULL, *yerrs = NULL;
+  int *status = results;
+  int res = 0;
+  size_t i;
+
+  *x = *y = *y_err = NULL;
+  *columns = 0;
+
+  if (!status) {
+    status = malloc(count * sizeof(int));
+    if (!status && count > 0)
+      return ENOMEM;
+  }
+
+  /*
+   * Without a grid, the first file that can be read defines it; it is
+   * kept for its row of the stack, not read again.
+   */
+  args.known = 0;
+  if (!grid) {
+    npoints = 0;
+    for (i = 0; i < count && !grid; ++i) {
+      saxs_document *doc = saxs_document_create();
+      const saxs_curve *curve;
+      size_t k;
+
+      if (!doc) {
+        res = ENOMEM;
+        goto out;
+      }
+
+      status[i] = saxs_document_read(doc, infiles[i], format);
+      curve = saxs_document_curve_find(doc, SAXS_CURVE_SCATTERING_DATA);
+      if (status[i] == 0 && !curve)
+        status[i] = EINVAL;
+
+      if (status[i] == 0) {
+        npoints = curve->curve_data_count;
+        xs = malloc((npoints ? npoints : 1) * sizeof(double));
+        if (!xs) {
+          saxs_document_free(doc);
+          res = ENOMEM;
+          goto out;
+        }
+
+        for (k = 0; k < npoints; ++k)
+          xs[k] = curve->curve_data[k].x;
+        grid = xs;
+
+        first       = doc;
+        first_curve = curve;
+
+      } else
+        saxs_document_free(doc);
+    }
+    args.known = i;
+
+  } else {
+    xs = malloc((npoints ? npoints : 1) * sizeof(double));
+    if (!xs) {
+      res = ENOMEM;
+      goto out;
+    }
+    memcpy(xs, grid, npoints * sizeof(double));
+  }
+
+  const size_t n = count * npoints;
+  ys    = malloc((n > 0 ? n : 1) * sizeof(double));
+  yerrs = malloc((n > 0 ? n : 1) * sizeof(double));
+  if (!ys || !yerrs) {
+    res = ENOMEM;
+    goto out;
+  }
+
+  args.infiles = infiles;
+  args.format  = format;
+  args.grid    = xs;
+  args.npoints = npoints;
+  args.flags   = flags;
+  args.y       = ys;
+  args.y_err   = yerrs;
+  args.results = status;
+  args.first   = first_curve;
+
+  pool = read_pool_acquire(nthreads);
+  saxs_thread_pool_for(pool, count, read_stack_one, &args);
+  read_pool_release(pool, nthreads);
+
+  for (i = 0; i < count && res == 0; ++i)
+    res = status[i];
+
+  *x       = xs;
+  *y       = ys;
+  *y_err   = yerrs;
+  *columns = npoints;
+  xs = ys = yerrs = NULL;
+
+out:
+  if (first)
+    saxs_document_free(first);
+
+  free(yerrs);
+  free(ys);
+  free(xs);
+
+  if (status != results)
+    free(status);
+
+  return res;
+}
+
+struct saxs_document_request {
+  saxs_thread_job *job;
+
+  char *filename;
+  char *format;
+  saxs_document *doc;
+
+  saxs_document_request_callback callback;
+  void *userdata;
+};
+
+static int read_async_run(void *arg) {
+  saxs_document_request *request = arg;
+  int res = ENOMEM;
+
+  request->doc = saxs_document_create();
+  if (request->doc) {
+    res = saxs_document_read(request->doc, request->filename,
+                             request->format);
+    if (res != 0) {
+      saxs_document_free(request->doc);
+      request->doc = NULL;
+    }
+  }
+
+  return res;
+}
+
+static void read_async_complete(void *arg, int status) {
+  saxs_document_request *request = arg;
+
+  if (request->callback)
+    request->callback(request, status, request->userdata);
+}
+
+static void read_async_destroy(void *arg) {
+  saxs_document_request *request = arg;
+
+  if (request->doc)
+    saxs_document_free(request->doc);
+
+  free(request->filename);
+  free(request->format);
+  free(request);
+}
+
+saxs_document_request*
+saxs_document_read_async(const char *filename, const char *format,
+                         saxs_document_request_callback callback,
+                         void *userdata) {
+  saxs_document_request *request = malloc(sizeof(saxs_document_request));
+  if (!request)
+    return NULL;
+
+  request->filename  = strdup(filename);
+  request->format    = format ? strdup(format) : NULL;
+  request->doc       = NULL;
+  request->callback  = callback;
+  request->userdata  = userdata;
+  request->job       = NULL;
+
+  if (!request->filename || (format && !request->format)) {
+    read_async_destroy(request);
+    return NULL;
+  }
+
+  request->job = saxs_thread_job_submit(saxs_thread_pool_default(),
+                                        read_async_run,
+                                        read_async_complete,
+                                        read_async_destroy,
+                                        request);
+  if (!request->job) {
+    read_async_destroy(request);
+    return NULL;
+  }
+
+  return request;
+}
+
+int saxs_document_request_poll(saxs_document_request *request) {
+  return saxs_thread_job_poll(request->job);
+}
+
+int saxs_document_request_wait(saxs_document_request *request) {
+  return saxs_thread_job_wait(request->job);
+}
+
+int saxs_document_request_cancel(saxs_document_request *request) {
+  return saxs_thread_job_cancel(request->job);
+}
+
+saxs_document* saxs_document_request_take(saxs_document_request *request) {
+  saxs_document *doc = NULL;
+
+  /*
+   * The status is published after the read; a document read by a
+   * request cancelled meanwhile is dropped with the request.
+   */
+  if (saxs_thread_job_status(request->job) == 0) {
+    doc = request->doc;
+    request->doc = NULL;
+  }
+
+  return doc;
+}
+
+void saxs_document_request_free(saxs_document_request *request) {
+  if (request) {
+    saxs_thread_job_cancel(request->job);
+    saxs_thread_job_release(request->job);
+  }
+}
+
 void saxs_document_free(saxs_document *doc) {
   assert_valid_document(doc);
   if (doc->doc_filename)
@@ -600,7 +1080,7 @@ saxs_curve_data_count(const saxs_curve *curve) {
 saxs_data*
 saxs_curve_data(const saxs_curve *curve) {
   assert_valid_curve_or_null(curve);
-  return curve ? curve->curve_data_head : NULL;
+  return curve && curve->curve_data_count > 0 ? curve->curve_data : NULL;
 }
 
 saxs_data*
@@ -674,10 +1154,10 @@ static saxs_curve* saxs_curve_init(const char *title, int type) {
 
   curve->curve_title        = title ? strdup(title) : NULL;
   curve->curve_type         = type;
-  curve->curve_data_count   = 0;
-  curve->curve_data_head    = NULL;
-  curve->curve_data_tail    = NULL;
-  curve->next               = NULL;
+  curve->curve_data_count    = 0;
+  curve->curve_data_capacity = 0;
+  curve->curve_data          = NULL;
+  curve->next                = NULL;
 
   assert_valid_curve(curve);
   return curve;
@@ -723,6 +1203,11 @@ saxs_document_copy_curve(saxs_document *doc, const saxs_curve *in) {
     if (!out)
       return NULL;
 
+    if (saxs_curve_reserve(out, in->curve_data_count) != 0) {
+      saxs_curve_free(out);
+      return NULL;
+    }
+
     saxs_data *data = saxs_curve_data(in);
     while (data) {
       int res = saxs_curve_add_data(out, data->x, data->x_err, data->y, data->y_err);
@@ -740,34 +1225,116 @@ saxs_document_copy_curve(saxs_document *doc, const saxs_curve *in) {
   return out;
 }
 
+int saxs_curve_reserve(saxs_curve *curve, int count) {
+  saxs_data *data;
+  int k;
+
+  assert_valid_curve(curve);
+
+  if (count <= curve->curve_data_capacity)
+    return 0;
+
+  data = realloc(curve->curve_data, count * sizeof(saxs_data));
+  if (!data)
+    return ENOMEM;
+
+  /* The array may have moved, relink. */
+  for (k = 0; k < curve->curve_data_count - 1; ++k)
+    data[k].next = &data[k + 1];
+
+  curve->curve_data          = data;
+  curve->curve_data_capacity = count;
+
+  assert_valid_curve(curve);
+  return 0;
+}
+
 int saxs_curve_add_data(saxs_curve *curve,
                          double x, double x_err,
                          double y, double y_err) {
 
   assert_valid_curve(curve);
 
-  saxs_data *data = malloc(sizeof(saxs_data));
-  if (!data)
-    return ENOMEM;
+  if (curve->curve_data_count == curve->curve_data_capacity) {
+    int capacity = curve->curve_data_capacity ? 2 * curve->curve_data_capacity : 64;
+    int res = saxs_curve_reserve(curve, capacity);
+    if (res != 0)
+      return res;
+  }
 
+  saxs_data *data = curve->curve_data + curve->curve_data_count;
   data->x     = x;
   data->x_err = x_err;
   data->y     = y;
   data->y_err = y_err;
   data->next  = NULL;
 
-  if (curve->curve_data_head == NULL)
-    curve->curve_data_head = data;
-  else
-    curve->curve_data_tail->next = data;
+  if (curve->curve_data_count > 0)
+    data[-1].next = data;
 
-  curve->curve_data_tail = data;
   curve->curve_data_count += 1;
 
   assert_valid_curve(curve);
   return 0;
 }
 
+int saxs_curve_add_data_array(saxs_curve *curve,
+                              const double *x, const double *x_err,
+                              const double *y, const double *y_err,
+                              int count) {
+  saxs_data *data;
+  int k, res;
+
+  assert_valid_curve(curve);
+
+  if (count <= 0)
+    return 0;
+
+  if (curve->curve_data_count + count > curve->curve_data_capacity) {
+    res = saxs_curve_reserve(curve, curve->curve_data_count + count);
+    if (res != 0)
+      return res;
+  }
+
+  data = curve->curve_data + curve->curve_data_count;
+  for (k = 0; k < count; ++k) {
+    data[k].x     = x[k];
+    data[k].x_err = x_err ? x_err[k] : 0.0;
+    data[k].y     = y[k];
+    data[k].y_err = y_err ? y_err[k] : 0.0;
+    data[k].next  = &data[k + 1];
+  }
+  data[count - 1].next = NULL;
+
+  if (curve->curve_data_count > 0)
+    data[-1].next = data;
+
+  curve->curve_data_count += count;
+
+  assert_valid_curve(curve);
+  return 0;
+}
+
+const double*
+saxs_curve_column(const saxs_curve *curve, int column, size_t *stride) {
+  assert_valid_curve_or_null(curve);
+
+  if (stride)
+    *stride = sizeof(saxs_data);
+
+  if (!curve || !curve->curve_data)
+    return NULL;
+
+  switch (column) {
+    case SAXS_DATA_X:     return &curve->curve_data->x;
+    case SAXS_DATA_X_ERR: return &curve->curve_data->x_err;
+    case SAXS_DATA_Y:     return &curve->curve_data->y;
+    case SAXS_DATA_Y_ERR: return &curve->curve_data->y_err;
+  }
+
+  return NULL;
+}
+
 int
 saxs_curve_has_y_err(const saxs_curve *curve) {
   assert_valid_curve_or_null(curve);
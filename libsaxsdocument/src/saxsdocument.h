@@ -38,6 +38,8 @@ extern "C" {
 
 #include "saxsproperty.h"
 
+#include <stddef.h>
+
 enum {
   SAXS_CURVE_EXPERIMENTAL_SCATTERING_DATA = 0x1,
   SAXS_CURVE_THEORETICAL_SCATTERING_DATA = 0x2,
@@ -47,6 +49,14 @@ enum {
   SAXS_CURVE_USER_DATA = 0x10000
 };
 
+/* Columns of the data points of a curve, see saxs_curve_column(). */
+enum {
+  SAXS_DATA_X = 0,
+  SAXS_DATA_X_ERR,
+  SAXS_DATA_Y,
+  SAXS_DATA_Y_ERR
+};
+
 
 struct saxs_document;
 typedef struct saxs_document saxs_document;
@@ -57,6 +67,12 @@ typedef struct saxs_curve saxs_curve;
 struct saxs_data;
 typedef struct saxs_data saxs_data;
 
+struct saxs_document_request;
+typedef struct saxs_document_request saxs_document_request;
+
+typedef void (*saxs_document_request_callback)(saxs_document_request *request,
+                                               int status, void *userdata);
+
 
 /**
  * @brief Create a new document.
@@ -112,6 +128,159 @@ int
 saxs_document_write(saxs_document *doc, const char *outfile,
                     const char *format);
 
+/**
+ * @brief Read a number of files concurrently.
+ *
+ * Each file is read as if by @ref saxs_document_read into a newly created
+ * document. Files are distributed over a pool of worker threads which
+ * balance the load between them, such that a few large files do not hold
+ * up the rest of the batch.
+ *
+ * @param docs       An array of @a count document pointers; on return,
+ *                   each entry holds a newly created document that must be
+ *                   free'd with @ref saxs_document_free, or NULL if the
+ *                   corresponding file could not be read.
+ * @param results    If not NULL, an array of @a count integers that
+ *                   receive the status of @ref saxs_document_read per file.
+ * @param infiles    An array of @a count input-filenames.
+ * @param formats    If not NULL, an array of @a count format names to be
+ *                   used per file; NULL entries deduce the format from the
+ *                   filename.
+ * @param count      The number of files to read.
+ * @param nthreads   The number of threads to use, including the calling
+ *                   thread; if 0 or negative, a shared pool with one thread
+ *                   per available processor is used.
+ *
+ * @returns 0 if all files were read successfully, otherwise the status of
+ *          the first file (in input order) that failed.
+ */
+int
+saxs_document_read_many(saxs_document **docs, int *results,
+                        const char **infiles, const char **formats,
+                        size_t count, int nthreads);
+
+/**
+ * @brief Flags of @ref saxs_document_read_stack.
+ */
+enum {
+  /** Interpolate curves onto the grid if they do not share it. */
+  SAXS_STACK_INTERPOLATE = 0x1
+};
+
+/**
+ * @brief Read a series of curves into a frames by points matrix.
+ *
+ * Meant for series of files sharing the same x-axis, e.g. SEC-SAXS
+ * frames or titrations. The files are read concurrently as by
+ * @ref saxs_document_read_many, but only the first scattering curve of
+ * each file is kept, stored in row @a i of the result matrices.
+ *
+ * A curve shares the grid if it has the same number of points and all
+ * values of x match up to a relative difference of 1e-6. Otherwise the
+ * file fails with EINVAL, unless SAXS_STACK_INTERPOLATE is given; the
+ * curve is then linearly interpolated onto the grid and points outside
+ * its range are set to NaN. Rows of files that fail are set to NaN.
+ *
+ * @param infiles    An array of @a count input-filenames.
+ * @param format     The format of all files, or NULL to deduce it from
+ *                   the filename.
+ * @param count      The number of files, i.e. rows.
+ * @param grid       The x-values to put the curves on, or NULL to take
+ *                   the grid from the first file that can be read.
+ * @param npoints    The number of values in @a grid.
+ * @param flags      Zero or SAXS_STACK_INTERPOLATE.
+ * @param nthreads   As in @ref saxs_document_read_many.
+ * @param x          Receives the grid.
+ * @param y          Receives the row-major @a count by @a columns matrix
+ *                   of values of y.
+ * @param y_err      Receives the corresponding matrix of errors of y.
+ * @param columns    Receives the number of points of the grid.
+ * @param results    If not NULL, an array of @a count integers that
+ *                   receive the status per file.
+ *
+ * @returns 0 if all files were read successfully, otherwise the status of
+ *          the first file (in input order) that failed. Unless the
+ *          matrices could not be allocated, @a x, @a y and @a y_err are
+ *          set in either case and must be free'd by the caller.
+ */
+int
+saxs_document_read_stack(const char **infiles, const char *format,
+                         size_t count, const double *grid, size_t npoints,
+                         int flags, int nthreads,
+                         double **x, double **y, double **y_err,
+                         size_t *columns, int *results);
+
+/**
+ * @brief Read data from a file in the background.
+ *
+ * The file is read as if by @ref saxs_document_read on a worker thread
+ * managed by the library, while the calling thread continues. Completion
+ * is signalled by @a callback, or may be checked for by
+ * @ref saxs_document_request_poll and @ref saxs_document_request_wait.
+ *
+ * @param infile    Input-filename.
+ * @param format    A known format or NULL, see @ref saxs_document_read.
+ * @param callback  If not NULL, called once the read completed, failed or
+ *                  was cancelled. The callback is run on the worker thread
+ *                  (or within @ref saxs_document_request_cancel), i.e. GUI
+ *                  applications need to forward the notification to their
+ *                  main thread; it must not wait for the request.
+ * @param userdata  Passed through to @a callback.
+ *
+ * @returns A request handle that must be free'd with
+ *          @ref saxs_document_request_free, or NULL on memory allocation
+ *          failure.
+ */
+saxs_document_request*
+saxs_document_read_async(const char *infile, const char *format,
+                         saxs_document_request_callback callback,
+                         void *userdata);
+
+/**
+ * @brief Check whether a request completed.
+ * @returns Non-zero if the request completed, 0 if it is still pending.
+ */
+int
+saxs_document_request_poll(saxs_document_request *request);
+
+/**
+ * @brief Wait until a request completed.
+ * @returns 0 on success, a non-null error code on error; ECANCELED if
+ *          the request was cancelled.
+ */
+int
+saxs_document_request_wait(saxs_document_request *request);
+
+/**
+ * @brief Cancel a request.
+ *
+ * A request that did not start yet is dropped, a read already in progress
+ * runs to completion but its result is discarded.
+ *
+ * @returns 0 if the request was cancelled, EALREADY if it had completed
+ *          already.
+ */
+int
+saxs_document_request_cancel(saxs_document_request *request);
+
+/**
+ * @brief Take the document read by a request.
+ *
+ * @returns The document read, NULL if the request is still pending or
+ *          failed. Ownership passes to the caller, the document must be
+ *          free'd with @ref saxs_document_free.
+ */
+saxs_document*
+saxs_document_request_take(saxs_document_request *request);
+
+/**
+ * @brief Free a request.
+ *
+ * Pending requests are cancelled. A document read but not taken is free'd.
+ */
+void
+saxs_document_request_free(saxs_document_request *request);
+
 /**
  * @brief Free's allocated memory.
  * Free's memory allocated by @ref saxs_document_create.
@@ -285,6 +454,60 @@ saxs_curve_add_data(saxs_curve *curve,
                     double x, double x_err,
                     double y, double y_err);
 
+/**
+ * @brief Append a number of data points at once.
+ *
+ * Equivalent to calling @ref saxs_curve_add_data for each point, but
+ * storage is allocated once for all of them.
+ *
+ * @param curve  The curve.
+ * @param x      @a count values of x.
+ * @param x_err  @a count errors of x, or NULL for zero errors.
+ * @param y      @a count values of y.
+ * @param y_err  @a count errors of y, or NULL for zero errors.
+ * @param count  The number of data points.
+ *
+ * @returns 0 on success, ENOMEM on memory allocation failure; the curve
+ *          is unchanged in the latter case.
+ */
+int
+saxs_curve_add_data_array(saxs_curve *curve,
+                          const double *x, const double *x_err,
+                          const double *y, const double *y_err,
+                          int count);
+
+/**
+ * @brief Make room for @a count data points in total.
+ *
+ * Adding data may move the data points of a curve in memory; reserving
+ * the space beforehand avoids repeated reallocations for large curves.
+ * Pointers obtained by @ref saxs_curve_data or @ref saxs_curve_column
+ * are invalidated.
+ *
+ * @returns 0 on success, ENOMEM on memory allocation failure.
+ */
+int
+saxs_curve_reserve(saxs_curve *curve, int count);
+
+/**
+ * @brief Direct access to a column of the data points of a curve.
+ *
+ * Data points are stored contiguously, the values of a column are thus
+ * found at a fixed distance from each other. The i-th value is at
+ * <tt>*(const double*)((const char*)column + i * stride)</tt>.
+ *
+ * @param curve   The curve.
+ * @param column  One of SAXS_DATA_X, SAXS_DATA_X_ERR, SAXS_DATA_Y or
+ *                SAXS_DATA_Y_ERR.
+ * @param stride  If not NULL, receives the distance in bytes between
+ *                consecutive values.
+ *
+ * @returns A pointer to the first value, NULL if the curve holds no data.
+ *          The pointer is valid until data is added to the curve.
+ */
+const double*
+saxs_curve_column(const saxs_curve *curve, int column, size_t *stride);
+
 int
 saxs_curve_has_y_err(const saxs_curve *curve);
 
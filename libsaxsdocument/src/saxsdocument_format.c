@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
 
 void saxs_document_format_register_atsas_dat();
 void saxs_document_format_register_atsas_fir_fit();
@@ -44,6 +45,7 @@ void saxs_document_format_register_cansas_xml();
 
 
 static int saxs_document_format_initialized = 0;
+static pthread_mutex_t saxs_document_format_lock = PTHREAD_MUTEX_INITIALIZER;
 static saxs_document_format *format_head = NULL, *format_tail = NULL;
 
 
@@ -78,8 +80,12 @@ saxs_document_format_free(saxs_document_format *format) {
 
 void
 saxs_document_format_init() {
-  if (saxs_document_format_initialized)
+  /* Documents may be read from several threads at once. */
+  pthread_mutex_lock(&saxs_document_format_lock);
+  if (saxs_document_format_initialized) {
+    pthread_mutex_unlock(&saxs_document_format_lock);
     return;
+  }
 
   /*
    * Register from the more specific to the less specific;
@@ -102,6 +108,7 @@ saxs_document_format_init() {
   saxs_document_format_register_maxlab_rad();
 
   saxs_document_format_initialized = 1;
+  pthread_mutex_unlock(&saxs_document_format_lock);
 
   /* Clean out on library unloading or application exit. */
   atexit(saxs_document_format_clear);
@@ -155,8 +162,7 @@ saxs_document_format_register(const saxs_document_format *format) {
 
 saxs_document_format*
 saxs_document_format_first() {
-  if (!saxs_document_format_initialized)
-    saxs_document_format_init();
+  saxs_document_format_init();
 
   return format_head;
 }
@@ -172,8 +178,7 @@ saxs_document_format*
 saxs_document_format_find_first(const char *filename,
                                 const char *formatname) {
 
-  if (!saxs_document_format_initialized)
-    saxs_document_format_init();
+  saxs_document_format_init();
 
   return saxs_document_format_find_next(NULL, filename, formatname);
 }
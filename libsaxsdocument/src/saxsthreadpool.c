@@ -0,0 +1,637 @@
+/*
+ * A small pool of worker threads shared by libsaxsdocument and libsaxsimage.
+ *
+ * This file is part of libsaxsdocument.
+ *
+ * libsaxsdocument is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * libsaxsdocument is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with libsaxsdocument. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "saxsthreadpool.h"
+
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+/*
+ * Queued work. Tasks are either allocated by the pool or, for parallel
+ * loops and jobs, owned by the caller who may unlink them again if they
+ * were not yet picked up by a worker.
+ */
+struct saxs_thread_task {
+  void (*fn)(void*);
+  void *arg;
+  int owned;
+
+  struct saxs_thread_task *next;
+};
+
+struct saxs_thread_pool {
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;
+
+  pthread_t *threads;
+  int thread_count;
+  int shutdown;
+
+  struct saxs_thread_task *head, *tail;
+};
+
+
+static void* saxs_thread_pool_worker(void *arg) {
+  saxs_thread_pool *pool = arg;
+
+  pthread_mutex_lock(&pool->lock);
+  while (1) {
+    struct saxs_thread_task *task;
+
+    while (!pool->head && !pool->shutdown)
+      pthread_cond_wait(&pool->wakeup, &pool->lock);
+
+    if (!pool->head)
+      break;
+
+    task = pool->head;
+    pool->head = task->next;
+    if (!pool->head)
+      pool->tail = NULL;
+
+    pthread_mutex_unlock(&pool->lock);
+
+    /* Tasks not owned by the pool may be gone once run. */
+    if (task->owned) {
+      task->fn(task->arg);
+      free(task);
+    } else
+      task->fn(task->arg);
+
+    pthread_mutex_lock(&pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+static void saxs_thread_pool_enqueue(saxs_thread_pool *pool,
+                                     struct saxs_thread_task *task) {
+  task->next = NULL;
+  if (pool->tail)
+    pool->tail->next = task;
+  else
+    pool->head = task;
+  pool->tail = task;
+}
+
+/* Remove a task from the queue; returns 1 if it was still queued. */
+static int saxs_thread_pool_dequeue(saxs_thread_pool *pool,
+                                    struct saxs_thread_task *task) {
+  struct saxs_thread_task *prev = NULL, *t;
+
+  for (t = pool->head; t; prev = t, t = t->next) {
+    if (t == task) {
+      if (prev)
+        prev->next = t->next;
+      else
+        pool->head = t->next;
+
+      if (pool->tail == t)
+        pool->tail = prev;
+
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+int saxs_thread_count() {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
+
+saxs_thread_pool* saxs_thread_pool_create(int nthreads) {
+  saxs_thread_pool *pool;
+  int i;
+
+  if (nthreads <= 0)
+    nthreads = saxs_thread_count();
+
+  pool = malloc(sizeof(saxs_thread_pool));
+  if (!pool)
+    return NULL;
+
+  pool->threads = malloc(nthreads * sizeof(pthread_t));
+  if (!pool->threads) {
+    free(pool);
+    return NULL;
+  }
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wakeup, NULL);
+  pool->thread_count = 0;
+  pool->shutdown     = 0;
+  pool->head         = NULL;
+  pool->tail         = NULL;
+
+  for (i = 0; i < nthreads; ++i) {
+    if (pthread_create(&pool->threads[i], NULL,
+                       saxs_thread_pool_worker, pool) != 0)
+      break;
+    pool->thread_count += 1;
+  }
+
+  if (pool->thread_count == 0) {
+    saxs_thread_pool_free(pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+void saxs_thread_pool_free(saxs_thread_pool *pool) {
+  int i;
+
+  if (!pool)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->wakeup);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (i = 0; i < pool->thread_count; ++i)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_cond_destroy(&pool->wakeup);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->threads);
+  free(pool);
+}
+
+int saxs_thread_pool_size(const saxs_thread_pool *pool) {
+  return pool ? pool->thread_count : 0;
+}
+
+
+static saxs_thread_pool *default_pool = NULL;
+static pthread_once_t default_pool_once = PTHREAD_ONCE_INIT;
+
+static void saxs_thread_pool_default_free() {
+  saxs_thread_pool_free(default_pool);
+  default_pool = NULL;
+}
+
+static void saxs_thread_pool_default_init() {
+  default_pool = saxs_thread_pool_create(0);
+
+  /* Stop the workers on library unloading or application exit. */
+  if (default_pool)
+    atexit(saxs_thread_pool_default_free);
+}
+
+saxs_thread_pool* saxs_thread_pool_default() {
+  pthread_once(&default_pool_once, saxs_thread_pool_default_init);
+  return default_pool;
+}
+
+
+/*
+ * Parallel loops.
+ *
+ * Each participant owns a contiguous range of indices which it processes
+ * from the front. Once its own range is exhausted, it steals the upper
+ * half of the largest remaining range of another participant. Ranges are
+ * padded to avoid false sharing of their locks between processors.
+ */
+struct saxs_loop_range {
+  pthread_mutex_t lock;
+  size_t begin, end;
+  char padding[64];
+};
+
+struct saxs_loop;
+
+struct saxs_loop_helper {
+  struct saxs_thread_task task;
+  struct saxs_loop *loop;
+  int id;
+};
+
+struct saxs_loop {
+  void (*fn)(void*, size_t);
+  void *arg;
+
+  struct saxs_loop_range *ranges;
+  int nranges;
+
+  /* Helpers that ran to completion, protected by 'lock'. */
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  int finished;
+};
+
+static int saxs_loop_take(struct saxs_loop_range *range, size_t *index) {
+  int res = 0;
+
+  pthread_mutex_lock(&range->lock);
+  if (range->begin < range->end) {
+    *index = range->begin++;
+    res = 1;
+  }
+  pthread_mutex_unlock(&range->lock);
+
+  return res;
+}
+
+static int saxs_loop_steal(struct saxs_loop *loop, int id) {
+  size_t best = 0;
+  int victim = -1, k;
+
+  /* Find the participant with the most work left ... */
+  for (k = 1; k < loop->nranges; ++k) {
+    struct saxs_loop_range *range = &loop->ranges[(id + k) % loop->nranges];
+    size_t remaining;
+
+    pthread_mutex_lock(&range->lock);
+    remaining = range->end - range->begin;
+    pthread_mutex_unlock(&range->lock);
+
+    if (remaining > best) {
+      best = remaining;
+      victim = (id + k) % loop->nranges;
+    }
+  }
+
+  /* ... and take the upper half of it; it may have shrunk meanwhile. */
+  if (victim >= 0) {
+    struct saxs_loop_range *range = &loop->ranges[victim];
+    size_t begin, end;
+
+    pthread_mutex_lock(&range->lock);
+    end   = range->end;
+    begin = range->begin + (range->end - range->begin) / 2;
+    range->end = begin;
+    pthread_mutex_unlock(&range->lock);
+
+    if (begin < end) {
+      range = &loop->ranges[id];
+      pthread_mutex_lock(&range->lock);
+      range->begin = begin;
+      range->end   = end;
+      pthread_mutex_unlock(&range->lock);
+      return 1;
+    }
+
+    /* Someone else was faster, look again. */
+    return saxs_loop_steal(loop, id);
+  }
+
+  return 0;
+}
+
+static void saxs_loop_run(struct saxs_loop *loop, int id) {
+  size_t index;
+
+  do {
+    while (saxs_loop_take(&loop->ranges[id], &index))
+      loop->fn(loop->arg, index);
+  } while (saxs_loop_steal(loop, id));
+}
+
+static void saxs_loop_helper_run(void *arg) {
+  struct saxs_loop_helper *helper = arg;
+  struct saxs_loop *loop = helper->loop;
+
+  saxs_loop_run(loop, helper->id);
+
+  pthread_mutex_lock(&loop->lock);
+  loop->finished += 1;
+  pthread_cond_signal(&loop->done);
+  pthread_mutex_unlock(&loop->lock);
+}
+
+int saxs_thread_pool_for(saxs_thread_pool *pool, size_t count,
+                         void (*fn)(void*, size_t), void *arg) {
+  struct saxs_loop loop;
+  struct saxs_loop_helper *helpers;
+  int nhelpers, cancelled, i;
+  size_t k;
+
+  nhelpers = saxs_thread_pool_size(pool);
+  if ((size_t)nhelpers >= count)
+    nhelpers = count > 0 ? (int)count - 1 : 0;
+
+  if (nhelpers == 0) {
+    for (k = 0; k < count; ++k)
+      fn(arg, k);
+    return 0;
+  }
+
+  loop.ranges  = malloc((nhelpers + 1) * sizeof(struct saxs_loop_range));
+  helpers      = malloc(nhelpers * sizeof(struct saxs_loop_helper));
+  if (!loop.ranges || !helpers) {
+    free(loop.ranges);
+    free(helpers);
+
+    for (k = 0; k < count; ++k)
+      fn(arg, k);
+    return ENOMEM;
+  }
+
+  loop.fn       = fn;
+  loop.arg      = arg;
+  loop.nranges  = nhelpers + 1;
+  loop.finished = 0;
+  pthread_mutex_init(&loop.lock, NULL);
+  pthread_cond_init(&loop.done, NULL);
+
+  for (i = 0; i < loop.nranges; ++i) {
+    pthread_mutex_init(&loop.ranges[i].lock, NULL);
+    loop.ranges[i].begin = count * i / loop.nranges;
+    loop.ranges[i].end   = count * (i + 1) / loop.nranges;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  for (i = 0; i < nhelpers; ++i) {
+    helpers[i].task.fn    = saxs_loop_helper_run;
+    helpers[i].task.arg   = &helpers[i];
+    helpers[i].task.owned = 0;
+    helpers[i].loop     = &loop;
+    helpers[i].id       = i + 1;
+    saxs_thread_pool_enqueue(pool, &helpers[i].task);
+  }
+  pthread_cond_broadcast(&pool->wakeup);
+  pthread_mutex_unlock(&pool->lock);
+
+  saxs_loop_run(&loop, 0);
+
+  /*
+   * All work is done or in progress. Helpers that did not get a worker
+   * in time (e.g. if all workers are busy or this is a nested loop) are
+   * taken off the queue again, the others are waited for.
+   */
+  cancelled = 0;
+  pthread_mutex_lock(&pool->lock);
+  for (i = 0; i < nhelpers; ++i)
+    cancelled += saxs_thread_pool_dequeue(pool, &helpers[i].task);
+  pthread_mutex_unlock(&pool->lock);
+
+  pthread_mutex_lock(&loop.lock);
+  while (loop.finished < nhelpers - cancelled)
+    pthread_cond_wait(&loop.done, &loop.lock);
+  pthread_mutex_unlock(&loop.lock);
+
+  for (i = 0; i < loop.nranges; ++i)
+    pthread_mutex_destroy(&loop.ranges[i].lock);
+  pthread_cond_destroy(&loop.done);
+  pthread_mutex_destroy(&loop.lock);
+  free(loop.ranges);
+  free(helpers);
+
+  return 0;
+}
+
+
+int saxs_thread_pool_submit(saxs_thread_pool *pool,
+                            void (*fn)(void*), void *arg) {
+  struct saxs_thread_task *task;
+
+  if (!pool) {
+    fn(arg);
+    return 0;
+  }
+
+  task = malloc(sizeof(struct saxs_thread_task));
+  if (!task)
+    return ENOMEM;
+
+  task->fn    = fn;
+  task->arg   = arg;
+  task->owned = 1;
+
+  pthread_mutex_lock(&pool->lock);
+  saxs_thread_pool_enqueue(pool, task);
+  pthread_cond_signal(&pool->wakeup);
+  pthread_mutex_unlock(&pool->lock);
+
+  return 0;
+}
+
+
+/*
+ * Jobs.
+ *
+ * A job is referenced by its handle and by the pool while it is queued
+ * or running; whoever drops the last reference destroys it.
+ *
+ * The status is published before the completion callback is called,
+ * so that callbacks may hand over to code that polls for it; waiting
+ * returns only once the callback returned.
+ */
+enum {
+  SAXS_THREAD_JOB_QUEUED,
+  SAXS_THREAD_JOB_RUNNING,
+  SAXS_THREAD_JOB_FINISHED,
+  SAXS_THREAD_JOB_DONE
+};
+
+struct saxs_thread_job {
+  struct saxs_thread_task task;
+  saxs_thread_pool *pool;
+
+  int (*run)(void*);
+  void (*complete)(void*, int);
+  void (*destroy)(void*);
+  void *arg;
+
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  int state, cancelled, status, refcount;
+};
+
+static void saxs_thread_job_unref(saxs_thread_job *job) {
+  int refcount;
+
+  pthread_mutex_lock(&job->lock);
+  refcount = --job->refcount;
+  pthread_mutex_unlock(&job->lock);
+
+  if (refcount == 0) {
+    if (job->destroy)
+      job->destroy(job->arg);
+
+    pthread_cond_destroy(&job->done);
+    pthread_mutex_destroy(&job->lock);
+    free(job);
+  }
+}
+
+static void saxs_thread_job_finish(saxs_thread_job *job, int status) {
+  pthread_mutex_lock(&job->lock);
+  job->status = status;
+  job->state  = SAXS_THREAD_JOB_FINISHED;
+  pthread_mutex_unlock(&job->lock);
+
+  if (job->complete)
+    job->complete(job->arg, status);
+
+  pthread_mutex_lock(&job->lock);
+  job->state  = SAXS_THREAD_JOB_DONE;
+  pthread_cond_broadcast(&job->done);
+  pthread_mutex_unlock(&job->lock);
+
+  saxs_thread_job_unref(job);
+}
+
+static void saxs_thread_job_run(void *arg) {
+  saxs_thread_job *job = arg;
+  int status, cancelled;
+
+  pthread_mutex_lock(&job->lock);
+  job->state = SAXS_THREAD_JOB_RUNNING;
+  cancelled = job->cancelled;
+  pthread_mutex_unlock(&job->lock);
+
+  status = cancelled ? ECANCELED : job->run(job->arg);
+
+  pthread_mutex_lock(&job->lock);
+  if (job->cancelled)
+    status = ECANCELED;
+  pthread_mutex_unlock(&job->lock);
+
+  saxs_thread_job_finish(job, status);
+}
+
+saxs_thread_job* saxs_thread_job_submit(saxs_thread_pool *pool,
+                                        int (*run)(void*),
+                                        void (*complete)(void*, int),
+                                        void (*destroy)(void*),
+                                        void *arg) {
+  saxs_thread_job *job = malloc(sizeof(saxs_thread_job));
+  if (!job)
+    return NULL;
+
+  job->task.fn    = saxs_thread_job_run;
+  job->task.arg   = job;
+  job->task.owned = 0;
+  job->pool       = pool;
+  job->run        = run;
+  job->complete   = complete;
+  job->destroy    = destroy;
+  job->arg        = arg;
+  job->state      = SAXS_THREAD_JOB_QUEUED;
+  job->cancelled  = 0;
+  job->status     = 0;
+  job->refcount   = 2;
+  pthread_mutex_init(&job->lock, NULL);
+  pthread_cond_init(&job->done, NULL);
+
+  if (pool) {
+    pthread_mutex_lock(&pool->lock);
+    saxs_thread_pool_enqueue(pool, &job->task);
+    pthread_cond_signal(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+
+  } else
+    saxs_thread_job_run(job);
+
+  return job;
+}
+
+int saxs_thread_job_poll(saxs_thread_job *job) {
+  int done;
+
+  pthread_mutex_lock(&job->lock);
+  done = (job->state >= SAXS_THREAD_JOB_FINISHED);
+  pthread_mutex_unlock(&job->lock);
+
+  return done;
+}
+
+int saxs_thread_job_status(saxs_thread_job *job) {
+  int status;
+
+  pthread_mutex_lock(&job->lock);
+  status = job->state >= SAXS_THREAD_JOB_FINISHED ? job->status : EINPROGRESS;
+  pthread_mutex_unlock(&job->lock);
+
+  return status;
+}
+
+int saxs_thread_job_wait(saxs_thread_job *job) {
+  int status;
+
+  pthread_mutex_lock(&job->lock);
+  while (job->state != SAXS_THREAD_JOB_DONE)
+    pthread_cond_wait(&job->done, &job->lock);
+  status = job->status;
+  pthread_mutex_unlock(&job->lock);
+
+  return status;
+}
+
+int saxs_thread_job_cancel(saxs_thread_job *job) {
+  int dequeued = 0;
+
+  pthread_mutex_lock(&job->lock);
+  if (job->state >= SAXS_THREAD_JOB_FINISHED) {
+    pthread_mutex_unlock(&job->lock);
+    return EALREADY;
+  }
+
+  job->cancelled = 1;
+
+  if (job->state == SAXS_THREAD_JOB_QUEUED) {
+    pthread_mutex_lock(&job->pool->lock);
+    dequeued = saxs_thread_pool_dequeue(job->pool, &job->task);
+    pthread_mutex_unlock(&job->pool->lock);
+  }
+  pthread_mutex_unlock(&job->lock);
+
+  /* Not picked up by a worker, complete it here. */
+  if (dequeued)
+    saxs_thread_job_finish(job, ECANCELED);
+
+  return 0;
+}
+
+int saxs_thread_job_cancelled(saxs_thread_job *job) {
+  int cancelled;
+
+  pthread_mutex_lock(&job->lock);
+  cancelled = job->cancelled;
+  pthread_mutex_unlock(&job->lock);
+
+  return cancelled;
+}
+
+void saxs_thread_job_release(saxs_thread_job *job) {
+  if (job)
+    saxs_thread_job_unref(job);
+}
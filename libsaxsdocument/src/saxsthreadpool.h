@@ -0,0 +1,216 @@
+/*
+ * A small pool of worker threads shared by libsaxsdocument and libsaxsimage.
+ *
+ * This file is part of libsaxsdocument.
+ *
+ * libsaxsdocument is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * libsaxsdocument is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with libsaxsdocument. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBSAXSDOCUMENT_SAXSTHREADPOOL_H
+#define LIBSAXSDOCUMENT_SAXSTHREADPOOL_H
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct saxs_thread_pool;
+typedef struct saxs_thread_pool saxs_thread_pool;
+
+struct saxs_thread_job;
+typedef struct saxs_thread_job saxs_thread_job;
+
+
+/**
+ * @brief The number of processors available to the process.
+ * @returns The number of online processors, at least 1.
+ */
+int
+saxs_thread_count();
+
+/**
+ * @brief Create a pool of worker threads.
+ *
+ * @param nthreads  The number of worker threads to start; if 0 or negative,
+ *                  one thread per available processor is started.
+ *
+ * @returns A newly allocated pool that must be free'd with
+ *          @ref saxs_thread_pool_free, or NULL if no threads could be
+ *          started.
+ */
+saxs_thread_pool*
+saxs_thread_pool_create(int nthreads);
+
+/**
+ * @brief Stop all worker threads and free the pool.
+ *
+ * Any tasks still queued are executed before the workers terminate.
+ */
+void
+saxs_thread_pool_free(saxs_thread_pool *pool);
+
+/**
+ * @brief The pool shared by all library functions.
+ *
+ * The pool is created on first use with one thread per available
+ * processor and stopped at application exit.
+ *
+ * @returns The shared pool, or NULL if no threads could be started.
+ */
+saxs_thread_pool*
+saxs_thread_pool_default();
+
+/**
+ * @brief The number of worker threads in a pool.
+ */
+int
+saxs_thread_pool_size(const saxs_thread_pool *pool);
+
+/**
+ * @brief Run a loop body for each index in [0, count) in parallel.
+ *
+ * The index range is split evenly between the calling thread and the
+ * workers of the pool. Whoever runs out of work steals half of the
+ * remaining range of another participant, thus unevenly sized work
+ * items (e.g. files of different length) are balanced automatically.
+ *
+ * The calling thread takes part in the work and the function returns
+ * once @a fn was called for all indices. It is safe to call this
+ * function from within a task running on the same pool.
+ *
+ * @param pool   A pool created by @ref saxs_thread_pool_create, or
+ *               NULL to run the loop in the calling thread only.
+ * @param count  The number of indices.
+ * @param fn     The loop body, called once per index; it must be
+ *               safe to call concurrently for different indices.
+ * @param arg    Passed through to @a fn.
+ *
+ * @returns 0 on success, ENOMEM on memory allocation failure (the
+ *          loop is then run in the calling thread).
+ */
+int
+saxs_thread_pool_for(saxs_thread_pool *pool, size_t count,
+                     void (*fn)(void *arg, size_t index), void *arg);
+
+/**
+ * @brief Run a function on a worker of the pool.
+ *
+ * @param pool  A pool created by @ref saxs_thread_pool_create, or NULL
+ *              to run @a fn immediately in the calling thread.
+ * @param fn    The function to run.
+ * @param arg   Passed through to @a fn.
+ *
+ * @returns 0 on success, ENOMEM on memory allocation failure.
+ */
+int
+saxs_thread_pool_submit(saxs_thread_pool *pool,
+                        void (*fn)(void *arg), void *arg);
+
+/**
+ * @brief Run a function on a worker and keep track of its completion.
+ *
+ * Unlike @ref saxs_thread_pool_submit, a job may be polled for, waited
+ * on and cancelled. This is the common ground of the asynchronous read
+ * functions of libsaxsdocument and libsaxsimage.
+ *
+ * @param pool      A pool created by @ref saxs_thread_pool_create, or NULL
+ *                  to run the job immediately in the calling thread.
+ * @param run       The work to be done; returns 0 on success, an error
+ *                  code otherwise. Not called if the job is cancelled
+ *                  before it started.
+ * @param complete  If not NULL, called with the final status after @a run
+ *                  finished or the job was cancelled. It is called from
+ *                  the worker thread, or from within
+ *                  @ref saxs_thread_job_cancel if the job did not start
+ *                  yet. The job polls as completed already; it must not
+ *                  wait for the job.
+ * @param destroy   If not NULL, called to release @a arg once the job
+ *                  has completed and @ref saxs_thread_job_release was
+ *                  called, whatever comes last.
+ * @param arg       Passed through to all of the above.
+ *
+ * @returns A job handle to be released by @ref saxs_thread_job_release,
+ *          or NULL on memory allocation failure.
+ */
+saxs_thread_job*
+saxs_thread_job_submit(saxs_thread_pool *pool,
+                       int (*run)(void *arg),
+                       void (*complete)(void *arg, int status),
+                       void (*destroy)(void *arg),
+                       void *arg);
+
+/**
+ * @brief Check for completion of a job.
+ * @returns Non-zero if the job completed, 0 otherwise.
+ */
+int
+saxs_thread_job_poll(saxs_thread_job *job);
+
+/**
+ * @brief Get the status of a job without waiting.
+ * @returns The status as by @ref saxs_thread_job_wait, EINPROGRESS if
+ *          the job did not complete yet.
+ */
+int
+saxs_thread_job_status(saxs_thread_job *job);
+
+/**
+ * @brief Wait for completion of a job.
+ *
+ * Returns only after the completion callback, if any, returned.
+ *
+ * @returns The status of the job, ECANCELED if it was cancelled.
+ */
+int
+saxs_thread_job_wait(saxs_thread_job *job);
+
+/**
+ * @brief Request cancellation of a job.
+ *
+ * A job that did not start yet is removed from the queue and completes
+ * immediately. A running job can not be interrupted, it is marked as
+ * cancelled and completes with status ECANCELED once done.
+ *
+ * @returns 0 if the job was cancelled, EALREADY if it had completed
+ *          already.
+ */
+int
+saxs_thread_job_cancel(saxs_thread_job *job);
+
+/**
+ * @brief Check whether cancellation of a job was requested.
+ *
+ * This may be used by long running jobs to stop early.
+ */
+int
+saxs_thread_job_cancelled(saxs_thread_job *job);
+
+/**
+ * @brief Release a job handle.
+ *
+ * The job is not cancelled, it completes in the background if still
+ * running.
+ */
+void
+saxs_thread_job_release(saxs_thread_job *job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !LIBSAXSDOCUMENT_SAXSTHREADPOOL_H */
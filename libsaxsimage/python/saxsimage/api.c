@@ -0,0 +1,551 @@
+
+#include <Python.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include "saxsimage.h"
+#include "saxsproperty.h"
+
+#if PY_VERSION_HEX < 0x03030000
+const char* PyUnicode_AsUTF8(PyObject *string) {
+  if (PyString_Check(string)) {
+    return PyString_AsString(string);
+
+  } else if (PyUnicode_Check(string)) {
+    PyObject *utf8 = PyUnicode_AsUTF8String(string);
+    if (!utf8)
+      return NULL;
+
+    return PyString_AsString(utf8);
+
+  } else {
+    PyErr_BadArgument();
+    return NULL;
+  }
+}
+#endif
+
+
+/**
+ * This module implements two types and one module
+ * function:
+ *  - type: saxsimage.api.image
+ *    wrapper for saxs_image, exports the pixels of the
+ *    current frame in their native type through the
+ *    buffer protocol
+ *  - type: saxsimage.api.frames
+ *    iterator over the frames of an image file
+ *
+ *  - procedure: read
+ *    reads a file, returns an image object
+ */
+
+typedef struct {
+  PyObject_HEAD
+
+  struct saxs_image *image;
+
+  /* The format the image was read with, NULL to deduce it. */
+  char *format;
+
+  /* Number of buffers exported from this image. */
+  Py_ssize_t exports;
+
+  /* Set while a frame is read with the GIL released. */
+  int running;
+
+  Py_ssize_t shape[2];
+  Py_ssize_t strides[2];
+
+} PySaxsImageObject;
+
+
+/* The struct module format of a pixel type. */
+static char*
+saxsimage_api_format(int type) {
+  switch (type) {
+    case SAXS_IMAGE_TYPE_UINT8:  return "B";
+    case SAXS_IMAGE_TYPE_INT16:  return "h";
+    case SAXS_IMAGE_TYPE_UINT16: return "H";
+    case SAXS_IMAGE_TYPE_INT32:  return "i";
+    case SAXS_IMAGE_TYPE_UINT32: return "I";
+    case SAXS_IMAGE_TYPE_FLOAT:  return "f";
+    default:                     return "d";
+  }
+}
+
+
+static PyObject*
+saxsimage_api_error(int result, const char *filename) {
+  /* Format handlers return either an errno value or -1. */
+  if (result > 0) {
+    errno = result;
+    return PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char*)filename);
+  }
+
+  return PyErr_Format(PyExc_IOError, "%s: could not read image", filename);
+}
+
+static void
+PySaxsImageObject_update(PySaxsImageObject *obj) {
+  obj->shape[0]   = saxs_image_height(obj->image);
+  obj->shape[1]   = saxs_image_width(obj->image);
+  obj->strides[1] = saxs_image_type_size(saxs_image_type(obj->image));
+  obj->strides[0] = obj->shape[0] > 0 ? saxs_image_row_stride(obj->image)
+                                      : obj->shape[1] * obj->strides[1];
+}
+
+static void
+PySaxsImageObject_dealloc(PyObject *self) {
+  PySaxsImageObject *obj = (PySaxsImageObject*)self;
+  saxs_image_free(obj->image);
+  PyMem_Free(obj->format);
+
+  Py_TYPE(self)->tp_free(self);
+}
+
+static int
+PySaxsImageObject_getbuffer(PyObject *self, Py_buffer *view, int flags) {
+  PySaxsImageObject *obj = (PySaxsImageObject*)self;
+  static double empty = 0.0;
+  const void *data;
+
+  if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "image is read-only");
+    return -1;
+  }
+
+  /* The pixels are being replaced by another thread. */
+  if (obj->running) {
+    PyErr_SetString(PyExc_BufferError, "image is reading a frame");
+    return -1;
+  }
+
+  /*
+   * Pixels mapped from a file may be stored top to bottom, exported
+   * as negative row strides. Consumers that can not handle strides
+   * get a contiguous copy, unless that would pull the pixels from
+   * under another export.
+   */
+  if (obj->strides[0] < 0 && (flags & PyBUF_STRIDES) != PyBUF_STRIDES) {
+    if (obj->exports > 0) {
+      PyErr_SetString(PyExc_BufferError, "image requires strides");
+      return -1;
+    }
+
+    if (!saxs_image_pixels(obj->image)) {
+      PyErr_NoMemory();
+      return -1;
+    }
+    PySaxsImageObject_update(obj);
+  }
+
+  data = obj->shape[0] > 0 ? saxs_image_row(obj->image, 0) : NULL;
+
+  view->obj        = self;
+  view->buf        = data ? (void*)data : (void*)&empty;
+  view->len        = obj->shape[0] * obj->shape[1] * obj->strides[1];
+  view->readonly   = 1;
+  view->itemsize   = obj->strides[1];
+  view->format     = (flags & PyBUF_FORMAT) ? saxsimage_api_format(saxs_image_type(obj->image)) : NULL;
+  view->ndim       = 2;
+  view->shape      = (flags & PyBUF_ND) ? obj->shape : NULL;
+  view->strides    = (flags & PyBUF_STRIDES) ? obj->strides : NULL;
+  view->suboffsets = NULL;
+  view->internal   = NULL;
+
+  Py_INCREF(self);
+  obj->exports += 1;
+
+  return 0;
+}
+
+static void
+PySaxsImageObject_releasebuffer(PyObject *self, Py_buffer *view) {
+  PySaxsImageObject *obj = (PySaxsImageObject*)self;
+  (void)view;
+
+  obj->exports -= 1;
+}
+
+static PyBufferProcs PySaxsImageObject_as_buffer = {
+#if PY_MAJOR_VERSION == 2
+  NULL, NULL, NULL, NULL,
+#endif
+  PySaxsImageObject_getbuffer,
+  PySaxsImageObject_releasebuffer
+};
+
+static PyObject*
+PySaxsImageObject_width(PyObject *self, PyObject *args) {
+  (void)args;
+  PySaxsImageObject *obj = (PySaxsImageObject*)self;
+  return PyLong_FromSize_t(saxs_image_width(obj->image));
+}
+
+static PyObject*
+PySaxsImageObject_height(PyObject *self, PyObject *args) {
+  (void)args;
+  PySaxsImageObject *obj = (PySaxsImageObject*)self;
+  return PyLong_FromSize_t(saxs_image_height(obj->image));
+}
+
+static PyObject*
+PySaxsImageObject_frame_count(PyObject *self, PyObject *args) {
+  (void)args;
+  PySaxsImageObject *obj = (PySaxsImageObject*)self;
+  return PyLong_FromLong(saxs_image_frame_count(obj->image));
+}
+
+static PyObject*
+PySaxsImageObject_current_frame(PyObject *self, PyObject *args) {
+  (void)args;
+  PySaxsImageObject *obj = (PySaxsImageObject*)self;
+  return PyLong_FromLong(saxs_image_current_frame(obj->image));
+}
+
+static PyObject*
+PySaxsImageObject_data(PyObject *self, PyObject *args) {
+  (void)args;
+  return PyMemoryView_FromObject(self);
+}
+
+static PyObject*
+PySaxsImageObject_read_frame(PyObject *self, PyObject *args) {
+  PySaxsImageObject *obj = (PySaxsImageObject*)self;
+  Py_ssize_t frame;
+  int result;
+
+  if (!PyArg_ParseTuple(args, "n", &frame))
+    return NULL;
+
+  if (obj->running)
+    return PyErr_Format(PyExc_ValueError, "image already reading a frame");
+
+  if (frame < 1 || frame > saxs_image_frame_count(obj->image))
+    return PyErr_Format(PyExc_IndexError, "frame out of range");
+
+  /* Reading a frame replaces the pixels. */
+  if (obj->exports > 0)
+    return PyErr_Format(PyExc_BufferError, "can not read a frame while the data is in use");
+
+  obj->running = 1;
+  Py_BEGIN_ALLOW_THREADS
+  result = saxs_image_read_frame(obj->image, frame);
+  Py_END_ALLOW_THREADS
+  obj->running = 0;
+
+  PySaxsImageObject_update(obj);
+
+  if (result)
+    return saxsimage_api_error(result, saxs_image_filename(obj->image));
+
+  Py_RETURN_NONE;
+}
+
+static PyObject*
+PySaxsImageObject_properties(PyObject *self, PyObject *args) {
+  (void)args;
+  PySaxsImageObject *obj = (PySaxsImageObject*)self;
+
+  /* Reading a frame replaces the properties too. */
+  if (obj->running)
+    return PyErr_Format(PyExc_ValueError, "image already reading a frame");
+
+  PyObject *properties = PyDict_New();
+  if (!properties)
+    return NULL;
+
+  /* Header values need not be valid UTF-8, undecodable bytes are kept. */
+  saxs_property *property = saxs_image_property_first(obj->image);
+  while (property) {
+    const char *text = saxs_property_value(property);
+    PyObject *value = PyUnicode_DecodeUTF8(text, strlen(text), "surrogateescape");
+    if (!value
+        || PyDict_SetItemString(properties, saxs_property_name(property), value) < 0) {
+      Py_XDECREF(value);
+      Py_DECREF(properties);
+      return NULL;
+    }
+    Py_DECREF(value);
+
+    property = saxs_property_next(property);
+  }
+
+  return properties;
+}
+
+static PyObject* PySaxsFramesObject_create(PySaxsImageObject *image);
+
+static PyObject*
+PySaxsImageObject_frames(PyObject *self, PyObject *args) {
+  (void)args;
+  return PySaxsFramesObject_create((PySaxsImageObject*)self);
+}
+
+static PyMethodDef PySaxsImageObject_methods[] = {
+    { "width", PySaxsImageObject_width, METH_NOARGS,
+      "Returns the width of the image in pixels" },
+    { "height", PySaxsImageObject_height, METH_NOARGS,
+      "Returns the height of the image in pixels" },
+    { "frame_count", PySaxsImageObject_frame_count, METH_NOARGS,
+      "Returns the number of frames in the file" },
+    { "current_frame", PySaxsImageObject_current_frame, METH_NOARGS,
+      "Returns the (1-based) frame currently loaded" },
+    { "data", PySaxsImageObject_data, METH_NOARGS,
+      "Returns a read-only (height, width) view of the pixels in their native "
+      "type without copying; use numpy.asarray() to obtain an array" },
+    { "read_frame", PySaxsImageObject_read_frame, METH_VARARGS,
+      "Loads the n-th (1-based) frame of the file" },
+    { "frames", PySaxsImageObject_frames, METH_NOARGS,
+      "Returns an iterator over all frames of the file, each one a new image" },
+    { "properties", PySaxsImageObject_properties, METH_NOARGS,
+      "Returns a dictionary of properties found in the image file" },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyTypeObject PySaxsImageObject_type = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  .tp_name = "saxsimage.api.image",
+  .tp_doc = "Image object, supports the buffer protocol",
+  .tp_basicsize = sizeof(PySaxsImageObject),
+  .tp_itemsize = 0,
+#if PY_MAJOR_VERSION == 2
+  .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER,
+#else
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+#endif
+  .tp_dealloc = PySaxsImageObject_dealloc,
+  .tp_as_buffer = &PySaxsImageObject_as_buffer,
+  .tp_methods = PySaxsImageObject_methods,
+};
+
+/*
+ * Wraps an image into a new image object, taking ownership of the
+ * image in either case.
+ */
+static PyObject*
+PySaxsImageObject_wrap(saxs_image *image, const char *format) {
+  PySaxsImageObject *obj;
+
+  obj = PyObject_New(PySaxsImageObject, &PySaxsImageObject_type);
+  if (!obj) {
+    saxs_image_free(image);
+    return NULL;
+  }
+
+  obj->image   = image;
+  obj->exports = 0;
+  obj->running = 0;
+  obj->format  = NULL;
+  if (format) {
+    obj->format = PyMem_Malloc(strlen(format) + 1);
+    if (!obj->format) {
+      Py_DECREF(obj);
+      return PyErr_NoMemory();
+    }
+    strcpy(obj->format, format);
+  }
+
+  PySaxsImageObject_update(obj);
+
+  return (PyObject*)obj;
+}
+
+/*
+ * Read a frame of a file into a new image object,
+ * the GIL is released while decoding.
+ */
+static PyObject*
+PySaxsImageObject_read(const char *filename, const char *format, size_t frame) {
+  saxs_image *image;
+  int result = ENOMEM;
+
+  Py_BEGIN_ALLOW_THREADS
+  image = saxs_image_create();
+  if (image)
+    result = saxs_image_read_at(image, filename, format, frame);
+  Py_END_ALLOW_THREADS
+
+  if (result) {
+    saxs_image_free(image);
+    return saxsimage_api_error(result, filename);
+  }
+
+  return PySaxsImageObject_wrap(image, format);
+}
+
+
+
+/*
+ * Iterating over the frames yields independent images, such that
+ * views of the data of earlier frames stay valid. The frames are read
+ * into an image of the iterator in turn, as the image object does;
+ * formats keep the file open between frames that way. Handed out are
+ * copies.
+ */
+typedef struct {
+  PyObject_HEAD
+
+  struct saxs_image *image;
+  char *filename;
+  char *format;
+  size_t frame, frame_count;
+
+  /* Set while a frame is read with the GIL released. */
+  int running;
+
+} PySaxsFramesObject;
+
+static void
+PySaxsFramesObject_dealloc(PyObject *self) {
+  PySaxsFramesObject *obj = (PySaxsFramesObject*)self;
+  saxs_image_free(obj->image);
+  PyMem_Free(obj->filename);
+  PyMem_Free(obj->format);
+
+  Py_TYPE(self)->tp_free(self);
+}
+
+static PyObject*
+PySaxsFramesObject_next(PyObject *self) {
+  PySaxsFramesObject *obj = (PySaxsFramesObject*)self;
+  saxs_image *copy = NULL;
+  int result;
+
+  if (obj->frame > obj->frame_count)
+    return NULL;
+
+  if (obj->running)
+    return PyErr_Format(PyExc_ValueError, "frames already executing");
+
+  obj->running = 1;
+  Py_BEGIN_ALLOW_THREADS
+  if (obj->frame == 1)
+    result = saxs_image_read_at(obj->image, obj->filename, obj->format, 1);
+  else
+    result = saxs_image_read_frame(obj->image, obj->frame);
+
+  if (result == 0) {
+    copy = saxs_image_copy(obj->image);
+    if (!copy)
+      result = ENOMEM;
+  }
+  Py_END_ALLOW_THREADS
+  obj->running = 0;
+
+  if (result)
+    return saxsimage_api_error(result, obj->filename);
+
+  obj->frame += 1;
+  return PySaxsImageObject_wrap(copy, obj->format);
+}
+
+static PyTypeObject PySaxsFramesObject_type = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  .tp_name = "saxsimage.api.frames",
+  .tp_doc = "Iterator over the frames of an image file",
+  .tp_basicsize = sizeof(PySaxsFramesObject),
+  .tp_itemsize = 0,
+#if PY_MAJOR_VERSION == 2
+  .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_ITER,
+#else
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+#endif
+  .tp_dealloc = PySaxsFramesObject_dealloc,
+  .tp_iter = PyObject_SelfIter,
+  .tp_iternext = PySaxsFramesObject_next,
+};
+
+static PyObject*
+PySaxsFramesObject_create(PySaxsImageObject *image) {
+  const char *filename = saxs_image_filename(image->image);
+  PySaxsFramesObject *obj;
+
+  if (!filename)
+    return PyErr_Format(PyExc_ValueError, "image was not read from a file");
+
+  obj = PyObject_New(PySaxsFramesObject, &PySaxsFramesObject_type);
+  if (!obj)
+    return NULL;
+
+  obj->frame       = 1;
+  obj->frame_count = saxs_image_frame_count(image->image);
+  obj->running     = 0;
+  obj->image       = saxs_image_create();
+  obj->filename    = PyMem_Malloc(strlen(filename) + 1);
+  obj->format      = image->format ? PyMem_Malloc(strlen(image->format) + 1) : NULL;
+  if (!obj->image || !obj->filename || (image->format && !obj->format)) {
+    Py_DECREF(obj);
+    return PyErr_NoMemory();
+  }
+  strcpy(obj->filename, filename);
+  if (image->format)
+    strcpy(obj->format, image->format);
+
+  /* Each frame is visited once. */
+  saxs_image_set_frame_cache_size(obj->image, 0);
+
+  return (PyObject*)obj;
+}
+
+
+
+static PyObject*
+saxsimage_api_read(PyObject *self, PyObject *args, PyObject *kwargs) {
+  static char *keywords[] = { "filename", "format", "frame", NULL };
+  char *filename = NULL, *format = NULL;
+  Py_ssize_t frame = 1;
+  (void)self;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|zn", keywords,
+                                   &filename, &format, &frame))
+    return NULL;
+
+  if (frame < 1)
+    return PyErr_Format(PyExc_IndexError, "frame out of range");
+
+  return PySaxsImageObject_read(filename, format, frame);
+}
+
+static PyMethodDef saxsimage_api_module_methods[] = {
+  { "read", (PyCFunction)(void(*)(void))saxsimage_api_read, METH_VARARGS | METH_KEYWORDS,
+    "read(filename, format=None, frame=1)\n\n"
+    "Reads a frame of an image file, returns an image object." },
+  { NULL, NULL, 0, NULL }
+};
+
+
+#if PY_MAJOR_VERSION == 2
+PyMODINIT_FUNC initapi(void) {
+  if (PyType_Ready(&PySaxsImageObject_type) < 0)
+    return;
+
+  if (PyType_Ready(&PySaxsFramesObject_type) < 0)
+    return;
+
+  Py_InitModule3("saxsimage.api",
+                 saxsimage_api_module_methods,
+                 "Python interface to libsaxsimage.");
+}
+
+#elif PY_MAJOR_VERSION == 3
+static PyModuleDef saxsimage_api_module = {
+  PyModuleDef_HEAD_INIT,
+  .m_name = "saxsimage.api",
+  .m_doc = "Python interface to libsaxsimage.",
+  .m_size = -1,
+  .m_methods = saxsimage_api_module_methods,
+};
+
+PyMODINIT_FUNC PyInit_api(void) {
+  if (PyType_Ready(&PySaxsImageObject_type) < 0)
+    return NULL;
+
+  if (PyType_Ready(&PySaxsFramesObject_type) < 0)
+    return NULL;
+
+  return PyModule_Create(&saxsimage_api_module);
+}
+#endif
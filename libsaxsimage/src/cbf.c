@@ -1,5 +1,5 @@
 /*
- * Read files in .cbf-format (using cbflib).
+ * Read and write files in .cbf-format.
  * Copyright (C) 2009, 2013 Daniel Franke <dfranke@users.sourceforge.net>
  *
  * This file is part of libsaxsdocument.
@@ -25,12 +25,341 @@
 #include "saxsimage_format.h"
 
 #include "cbf.h"
+#include "cbf_codes.h"      /* also MD5 */
 #include "cbf_simple.h"
 
 #include <assert.h>
+#include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+
+/*
+ * Almost all CBF files in use are written by PILATUS and EIGER
+ * detectors: a single binary section of signed 32-bit integers,
+ * compressed by byte offsets. These are decoded here, straight into
+ * the pixels of the image; anything else goes through cbflib.
+ */
+#define CBF_BINARY_SECTION "--CIF-BINARY-FORMAT-SECTION--"
+#define CBF_BINARY_MARKER  "\x0c\x1a\x04\xd5"
+
+struct cbf_binary_header {
+  int byte_offset, binary, int32, little_endian;
+  size_t size, elements, fastest, second, third;
+  char md5[25];
+};
+
+/* Case-insensitive prefix match as MIME header names ignore case. */
+static const char*
+cbf_header_value(const char *line, const char *name) {
+  for ( ; *name; ++line, ++name)
+    if (tolower((unsigned char)*line) != tolower((unsigned char)*name))
+      return NULL;
+
+  while (*line == ' ' || *line == '\t')
+    ++line;
+  return line;
+}
+
+/*
+ * Parses the MIME header of the first binary section, returns the
+ * first byte of binary data or NULL if there is none.
+ */
+static const unsigned char*
+cbf_parse_binary_header(const unsigned char *data, size_t size,
+                        struct cbf_binary_header *header) {
+  const size_t section_length = strlen(CBF_BINARY_SECTION);
+  const unsigned char *p = data, *end = data + size;
+  int content_type = 0;
+  char line[256];
+
+  memset(header, 0, sizeof(*header));
+  header->third = 1;
+
+  for ( ; p + section_length <= end; ++p)
+    if (*p == '-' && !memcmp(p, CBF_BINARY_SECTION, section_length))
+      break;
+  if (p + section_length > end)
+    return NULL;
+
+  /* Headers start on the next line. */
+  p = memchr(p, '\n', end - p);
+  if (!p)
+    return NULL;
+
+  for (p += 1; p < end; ) {
+    const unsigned char *eol = memchr(p, '\n', end - p);
+    size_t length;
+    const char *value;
+
+    if (!eol)
+      return NULL;
+
+    length = eol - p;
+    if (length > 0 && p[length - 1] == '\r')
+      length -= 1;
+    if (length >= sizeof(line))
+      length = sizeof(line) - 1;
+    memcpy(line, p, length);
+    line[length] = '\0';
+    p = eol + 1;
+
+    /* The empty line ends the header, the binary data follows. */
+    if (length == 0)
+      break;
+
+    /* Continuation lines belong to the header before. */
+    if (line[0] == ' ' || line[0] == '\t') {
+      if (content_type && strstr(line, "x-CBF_BYTE_OFFSET"))
+        header->byte_offset = 1;
+      continue;
+    }
+
+    content_type = 0;
+    if ((value = cbf_header_value(line, "Content-Type:"))) {
+      content_type = 1;
+      header->byte_offset = strstr(value, "x-CBF_BYTE_OFFSET") != NULL;
+
+    } else if ((value = cbf_header_value(line, "Content-Transfer-Encoding:")))
+      header->binary = !strcmp(value, "BINARY");
+
+    else if ((value = cbf_header_value(line, "X-Binary-Element-Type:")))
+      header->int32 = !strcmp(value, "\"signed 32-bit integer\"");
+
+    else if ((value = cbf_header_value(line, "X-Binary-Element-Byte-Order:")))
+      header->little_endian = !strcmp(value, "LITTLE_ENDIAN");
+
+    else if ((value = cbf_header_value(line, "Content-MD5:")))
+      strncpy(header->md5, value, sizeof(header->md5) - 1);
+
+    else if ((value = cbf_header_value(line, "X-Binary-Size:")))
+      header->size = strtoul(value, NULL, 10);
+
+    else if ((value = cbf_header_value(line, "X-Binary-Number-of-Elements:")))
+      header->elements = strtoul(value, NULL, 10);
+
+    else if ((value = cbf_header_value(line, "X-Binary-Size-Fastest-Dimension:")))
+      header->fastest = strtoul(value, NULL, 10);
+
+    else if ((value = cbf_header_value(line, "X-Binary-Size-Second-Dimension:")))
+      header->second = strtoul(value, NULL, 10);
+
+    else if ((value = cbf_header_value(line, "X-Binary-Size-Third-Dimension:")))
+      header->third = strtoul(value, NULL, 10);
+  }
+
+  /* The marker comes right after the header. */
+  if (p + 4 > end || memcmp(p, CBF_BINARY_MARKER, 4))
+    return NULL;
+
+  return p + 4;
+}
+
+/*
+ * Byte offset compression stores differences to the previous value
+ * in one byte; -128 escapes to two bytes, -32768 to four bytes and
+ * INT32_MIN to eight, all little endian. Decodes n values, continuing
+ * from *p and *value.
+ */
+static int
+cbf_decode_byte_offset(const unsigned char **p, const unsigned char *end,
+                       int64_t *value, int32_t *out, size_t n) {
+  const unsigned char *in = *p;
+  int64_t v = *value;
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    if (in >= end)
+      return -1;
+
+    if (*in != 0x80) {
+      v += (int8_t)*in;
+      in += 1;
+
+    } else if (end - in >= 3 && (in[1] != 0x00 || in[2] != 0x80)) {
+      v += (int16_t)(in[1] | in[2] << 8);
+      in += 3;
+
+    } else if (end - in >= 7 && (in[3] != 0x00 || in[4] != 0x00
+                                 || in[5] != 0x00 || in[6] != 0x80)) {
+      v += (int32_t)((uint32_t)in[3] | (uint32_t)in[4] << 8
+                     | (uint32_t)in[5] << 16 | (uint32_t)in[6] << 24);
+      in += 7;
+
+    } else if (end - in >= 15) {
+      uint64_t d = 0;
+      int k;
+      for (k = 7; k >= 0; --k)
+        d = d << 8 | in[7 + k];
+      v += (int64_t)d;
+      in += 15;
+
+    } else
+      return -1;
+
+    out[i] = (int32_t)v;
+  }
+
+  *p = in;
+  *value = v;
+  return 0;
+}
+
+/*
+ * Encodes n values, continuing from *value, into out, which must have
+ * room for 15 bytes per value. Returns the end of the encoded data.
+ */
+static unsigned char*
+cbf_encode_byte_offset(const int32_t *in, size_t n, int64_t *value,
+                       unsigned char *out) {
+  int64_t v = *value;
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    const int64_t d = (int64_t)in[i] - v;
+    const uint64_t u = (uint64_t)d;
+    int k;
+
+    v = in[i];
+
+    if (d >= -127 && d <= 127) {
+      *out++ = (unsigned char)u;
+
+    } else if (d >= -32767 && d <= 32767) {
+      out[0] = 0x80;
+      out[1] = (unsigned char)u;
+      out[2] = (unsigned char)(u >> 8);
+      out += 3;
+
+    } else if (d >= -2147483647 && d <= 2147483647) {
+      out[0] = 0x80;
+      out[1] = 0x00;
+      out[2] = 0x80;
+      for (k = 0; k < 4; ++k)
+        out[3 + k] = (unsigned char)(u >> 8 * k);
+      out += 7;
+
+    } else {
+      static const unsigned char escape[7] = { 0x80, 0x00, 0x80,
+                                               0x00, 0x00, 0x00, 0x80 };
+      memcpy(out, escape, sizeof(escape));
+      for (k = 0; k < 8; ++k)
+        out[7 + k] = (unsigned char)(u >> 8 * k);
+      out += 15;
+    }
+  }
+
+  *value = v;
+  return out;
+}
+
+/* Base64 encoded MD5 digest, as in the Content-MD5 header. */
+static void
+cbf_md5(const unsigned char *data, size_t size, char encoded[25]) {
+  unsigned char digest[16];
+  MD5_CTX context;
+
+  MD5Init(&context);
+  while (size > 0) {
+    const unsigned int n = size > (1u << 30) ? (1u << 30) : (unsigned int)size;
+    MD5Update(&context, (unsigned char*)data, n);
+    data += n;
+    size -= n;
+  }
+  MD5Final(digest, &context);
+
+  cbf_md5digest_to64(encoded, digest);
+  encoded[24] = '\0';
+}
+
+static int
+cbf_verify_md5(const unsigned char *data, size_t size, const char *expected) {
+  char encoded[25];
+
+  cbf_md5(data, size, encoded);
+  return strcmp(encoded, expected) == 0;
+}
+
+/*
+ * Returns ENOTSUP if the file is not of the kind decoded here, and
+ * should be read by cbflib instead.
+ */
+static int
+saxs_image_cbf_read_byte_offset(saxs_image *image, const char *filename) {
+  struct cbf_binary_header header;
+  const unsigned char *binary, *p, *end;
+  unsigned char *data;
+  int64_t value = 0;
+  long length;
+  size_t y;
+  FILE *fd;
+  int res;
+
+  fd = fopen(filename, "rb");
+  if (!fd)
+    return errno;
+
+  if (fseek(fd, 0, SEEK_END) != 0 || (length = ftell(fd)) <= 0
+      || fseek(fd, 0, SEEK_SET) != 0) {
+    fclose(fd);
+    return ENOTSUP;
+  }
+
+  data = malloc(length);
+  if (!data) {
+    fclose(fd);
+    return ENOMEM;
+  }
+
+  if (fread(data, 1, length, fd) != (size_t)length) {
+    free(data);
+    fclose(fd);
+    return ENOTSUP;
+  }
+  fclose(fd);
+
+  binary = cbf_parse_binary_header(data, length, &header);
+  if (!binary
+      || !header.byte_offset || !header.binary || !header.int32
+      || !header.little_endian || header.third != 1
+      || header.fastest == 0 || header.second == 0
+      || header.elements != header.fastest * header.second
+      || header.size == 0 || header.size > (size_t)(data + length - binary)) {
+    free(data);
+    return ENOTSUP;
+  }
+
+  if (saxs_image_verify_checksums(image) && header.md5[0]
+      && !cbf_verify_md5(binary, header.size, header.md5)) {
+    free(data);
+    return EIO;
+  }
+
+  res = saxs_image_resize(image, header.fastest, header.second, 1, 1,
+                          SAXS_IMAGE_TYPE_INT32);
+  if (res != 0) {
+    free(data);
+    return res;
+  }
+
+  /* Rows are stored from the top, images kept from the bottom. */
+  p   = binary;
+  end = binary + header.size;
+  for (y = header.second; y > 0; --y)
+    if (cbf_decode_byte_offset(&p, end, &value,
+                               saxs_image_row_data(image, y - 1),
+                               header.fastest) != 0) {
+      free(data);
+      return EIO;
+    }
+
+  saxs_image_modified(image);
+  free(data);
+  return 0;
+}
 
 
 static int
@@ -59,10 +388,11 @@ saxs_image_cbf_read_low_level(cbf_handle cbf,
 
   cbf_select_datablock(cbf, 0);
 
-  if (!cbf_find_category(cbf, "array_data"))
+  /* cbflib returns 0 on success */
+  if (cbf_find_category(cbf, "array_data") != 0)
     return -1;
 
-  if (!cbf_find_column(cbf, "data"))
+  if (cbf_find_column(cbf, "data") != 0)
     return -1;
 
   cbf_get_arrayparameters_wdims(cbf, &compression, NULL, &size, &is_signed,
@@ -91,7 +421,8 @@ saxs_image_cbf_read_low_level(cbf_handle cbf,
 
 
 int saxs_image_cbf_read(saxs_image *image, const char *filename, size_t frame) {
-  size_t width, height, res;
+  size_t width, height;
+  int res;
   int *data;
   cbf_handle cbf;
   FILE *fd;
@@ -100,6 +431,10 @@ int saxs_image_cbf_read(saxs_image *image, const char *filename, size_t frame) {
   if (frame != 1)
     return -2;
 
+  res = saxs_image_cbf_read_byte_offset(image, filename);
+  if (res != ENOTSUP)
+    return res;
+
   /* The 'b' is required for windows, overwise reading fails. */
   fd = fopen(filename, "rb");
   if (!fd)
@@ -110,7 +445,8 @@ int saxs_image_cbf_read(saxs_image *image, const char *filename, size_t frame) {
     return -1;
   }
 
-  cbf_read_file(cbf, fd, MSG_DIGEST);
+  cbf_read_file(cbf, fd, saxs_image_verify_checksums(image) ? MSG_DIGEST
+                                                            : MSG_NODIGEST);
 
   res = (saxs_image_cbf_read_high_level(cbf, &width, &height, &data) == 0
          || saxs_image_cbf_read_low_level(cbf, &width, &height, &data) == 0) ? 0 : -1;
@@ -119,12 +455,14 @@ int saxs_image_cbf_read(saxs_image *image, const char *filename, size_t frame) {
   cbf_free_handle(cbf);
 
   if (res == 0) {
-    size_t x, y;
+    res = saxs_image_resize(image, width, height, 1, 1, SAXS_IMAGE_TYPE_INT32);
+    if (res != 0) {
+      free(data);
+      return res;
+    }
 
-    saxs_image_set_size(image, width, height, 1, 1);
-    for (x = 0; x < width; ++x)
-      for (y = 0; y < height; ++y)
-        saxs_image_set_value(image, x, height - y - 1, *(data + y * width + x));
+    saxs_image_set_pixels(image, data, SAXS_IMAGE_TYPE_INT32,
+                          SAXS_IMAGE_LAYOUT_TOPDOWN);
 
     free(data);
   }
@@ -132,13 +470,146 @@ int saxs_image_cbf_read(saxs_image *image, const char *filename, size_t frame) {
   return res;
 }
 
+/*
+ * Pixels of other types are rounded to the nearest integer, halves away
+ * from zero, and clamped to the range of 32-bit integers. NaN, i.e. no
+ * value, is written as -1, as PILATUS detectors mark bad pixels.
+ */
+static void cbf_round_row(const double *from, int32_t *to, size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    const double v = from[i];
+
+    if (v != v)
+      to[i] = -1;
+    else if (v >= INT32_MAX)
+      to[i] = INT32_MAX;
+    else if (v <= INT32_MIN)
+      to[i] = INT32_MIN;
+    else
+      to[i] = (int32_t)(v < 0.0 ? v - 0.5 : v + 0.5);
+  }
+}
+
+/*
+ * Writes the pixels as signed 32-bit integers, compressed by byte
+ * offsets, in the layout of PILATUS files; cbflib, and most other
+ * software reading CBF, reads them.
+ */
+int saxs_image_cbf_write(saxs_image *image, const char *filename) {
+  const size_t width  = saxs_image_width(image);
+  const size_t height = saxs_image_height(image);
+  const int type = saxs_image_type(image);
+  unsigned char *data, *end;
+  int32_t *row;
+  double *converted = NULL;
+  int64_t value = 0;
+  size_t capacity, size, y;
+  char digest[25];
+  FILE *fd;
+  int res = 0;
+
+  /* Mostly one byte per pixel, grown as needed. */
+  capacity = width * height + 15 * width;
+  data = malloc(capacity);
+  row  = malloc(width * sizeof(int32_t));
+  if (type != SAXS_IMAGE_TYPE_INT32)
+    converted = malloc(width * sizeof(double));
+  if (!data || !row || (type != SAXS_IMAGE_TYPE_INT32 && !converted)) {
+    free(converted);
+    free(row);
+    free(data);
+    return ENOMEM;
+  }
+
+  /* The top row goes first. */
+  end = data;
+  for (y = height; y > 0; --y) {
+    const int32_t *values = row;
+    const size_t used = end - data;
+
+    if (capacity - used < 15 * width) {
+      unsigned char *grown = realloc(data, 2 * capacity);
+      if (!grown) {
+        free(converted);
+        free(row);
+        free(data);
+        return ENOMEM;
+      }
+      end      = grown + used;
+      data     = grown;
+      capacity = 2 * capacity;
+    }
+
+    if (type == SAXS_IMAGE_TYPE_INT32)
+      values = saxs_image_row(image, y - 1);
+    else {
+      saxs_image_get_row(image, y - 1, converted, SAXS_IMAGE_TYPE_DOUBLE);
+      cbf_round_row(converted, row, width);
+    }
+
+    end = cbf_encode_byte_offset(values, width, &value, end);
+  }
+  free(converted);
+  free(row);
+
+  size = end - data;
+  cbf_md5(data, size, digest);
+
+  fd = fopen(filename, "wb");
+  if (!fd) {
+    res = errno;
+    free(data);
+    return res;
+  }
+
+  errno = 0;
+  fprintf(fd,
+          "###CBF: VERSION 1.5\r\n"
+          "# CBF file written by libsaxsimage\r\n"
+          "\r\n"
+          "data_image_1\r\n"
+          "\r\n"
+          "_array_data.data\r\n"
+          ";\r\n"
+          CBF_BINARY_SECTION "\r\n"
+          "Content-Type: application/octet-stream;\r\n"
+          "     conversions=\"x-CBF_BYTE_OFFSET\"\r\n"
+          "Content-Transfer-Encoding: BINARY\r\n"
+          "X-Binary-Size: %lu\r\n"
+          "X-Binary-ID: 1\r\n"
+          "X-Binary-Element-Type: \"signed 32-bit integer\"\r\n"
+          "X-Binary-Element-Byte-Order: LITTLE_ENDIAN\r\n"
+          "Content-MD5: %s\r\n"
+          "X-Binary-Number-of-Elements: %lu\r\n"
+          "X-Binary-Size-Fastest-Dimension: %lu\r\n"
+          "X-Binary-Size-Second-Dimension: %lu\r\n"
+          "\r\n"
+          CBF_BINARY_MARKER,
+          (unsigned long)size, digest, (unsigned long)(width * height),
+          (unsigned long)width, (unsigned long)height);
+
+  fwrite(data, 1, size, fd);
+  fprintf(fd, "\r\n" CBF_BINARY_SECTION "--\r\n;\r\n\r\n");
+  free(data);
+
+  if (ferror(fd))
+    res = errno ? errno : EIO;
+  if (fclose(fd) != 0 && res == 0)
+    res = errno ? errno : EIO;
+
+  return res;
+}
+
 /**************************************************************************/
 #include "saxsimage_format.h"
 
 saxs_image_format*
 saxs_image_format_cbf(const char *filename, const char *format) {
   static saxs_image_format image_cbf = { saxs_image_cbf_read,
-                                         NULL, /* write */ };
+                                         saxs_image_cbf_write,
+                                         NULL  /* refresh */ };
 
   if (!compare_format(format, "cbf")
       || !compare_format(suffix(filename), "cbf")
@@ -27,12 +27,17 @@
 #include "edfio.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
-int saxs_image_edf_read(saxs_image *image, const char *filename, size_t frame) {
-  int i, fd, edf_errno, status;
+/* edfpack keeps its open files in global tables. */
+static pthread_mutex_t edf_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int edf_read(saxs_image *image, const char *filename, size_t frame) {
+  int i, fd, edf_errno, status, res = 0;
   float *data = NULL;
   long *dim = NULL;    /* allocated by edf_read_data, first element
                           holds number of elements to follow */
@@ -64,11 +69,9 @@ int saxs_image_edf_read(saxs_image *image, const char *filename, size_t frame) {
                   &edf_errno, &status);
 
   if (status == 0) {
-    int x, y;
-    saxs_image_set_size(image, dim[1], dim[2], 1, 1);
-    for (x = 0; x < dim[1]; ++x)
-      for (y = 0; y < dim[2]; ++y)
-        saxs_image_set_value(image, x, y, *(data + y * dim[1] + x));
+    res = saxs_image_resize(image, dim[1], dim[2], 1, 1, SAXS_IMAGE_TYPE_FLOAT);
+    if (res == 0)
+      saxs_image_set_data(image, data, SAXS_IMAGE_TYPE_FLOAT);
 
   } else
     fprintf(stderr, "edf: error on read: %s", edf_report_data_error(edf_errno));
@@ -76,7 +79,137 @@ int saxs_image_edf_read(saxs_image *image, const char *filename, size_t frame) {
   /* Also free's the data */
   edf_close_data_file(fd, &edf_errno, &status);
 
-  return status;
+  return res ? res : status;
+}
+
+/*
+ * Uncompressed single-block files in native byte order are mapped
+ * directly; anything else, and anything unexpected in the header,
+ * is left to edfpack.
+ */
+#define EDF_HEADER_MAX 65536
+
+static int edf_header_value(const char *header, const char *key,
+                            char *value, size_t length) {
+  const size_t keylen = strlen(key);
+  const char *p = header;
+
+  while ((p = strstr(p, key)) != NULL) {
+    const char *begin = p + keylen, *end;
+
+    /* Whole keys only, e.g. not "Dim_1" in "Dim_10". */
+    if ((p == header || strchr(" \t\n{;", p[-1]))
+        && strspn(begin, " \t") + begin == strchr(begin, '=')) {
+      begin = strchr(begin, '=') + 1;
+      begin += strspn(begin, " \t");
+      end = strchr(begin, ';');
+      if (!end)
+        return 0;
+      while (end > begin && (end[-1] == ' ' || end[-1] == '\t'))
+        --end;
+      if ((size_t)(end - begin) >= length)
+        return 0;
+
+      memcpy(value, begin, end - begin);
+      value[end - begin] = '\0';
+      return 1;
+    }
+    p += keylen;
+  }
+
+  return 0;
+}
+
+static int edf_map(saxs_image *image, const char *filename) {
+  static const struct {
+    const char *name;
+    int type;
+  } types[] = {
+    { "UnsignedByte",    SAXS_IMAGE_TYPE_UINT8 },
+    { "SignedShort",     SAXS_IMAGE_TYPE_INT16 },
+    { "UnsignedShort",   SAXS_IMAGE_TYPE_UINT16 },
+    { "SignedInteger",   SAXS_IMAGE_TYPE_INT32 },
+    { "UnsignedInteger", SAXS_IMAGE_TYPE_UINT32 },
+    { "FloatValue",      SAXS_IMAGE_TYPE_FLOAT },
+    { "FloatIEEE32",     SAXS_IMAGE_TYPE_FLOAT },
+    { "DoubleValue",     SAXS_IMAGE_TYPE_DOUBLE },
+    { "DoubleIEEE64",    SAXS_IMAGE_TYPE_DOUBLE },
+    { NULL, 0 }
+  };
+  const unsigned int one = 1;
+  const char *native = *(const char*)&one ? "LowByteFirst" : "HighByteFirst";
+
+  char *header, *end, value[64];
+  size_t n, width, height;
+  int i, type = 0, res = ENOTSUP;
+  FILE *fd;
+
+  fd = fopen(filename, "rb");
+  if (!fd)
+    return ENOTSUP;
+
+  header = malloc(EDF_HEADER_MAX + 1);
+  if (!header) {
+    fclose(fd);
+    return ENOTSUP;
+  }
+
+  n = fread(header, 1, EDF_HEADER_MAX, fd);
+  header[n] = '\0';
+  fclose(fd);
+
+  /* The header is "{ ... }\n", followed by the data. */
+  end = strchr(header, '}');
+  if (n == 0 || header[0] != '{' || !end || end[1] != '\n')
+    goto out;
+  end[1] = '\0';
+
+  if (edf_header_value(header, "EDF_BinaryFileName", value, sizeof(value))
+      || edf_header_value(header, "EDF_DataBlocks", value, sizeof(value))
+      || (edf_header_value(header, "Compression", value, sizeof(value))
+          && compare_format(value, "None"))
+      || (edf_header_value(header, "RasterConfiguration", value, sizeof(value))
+          && strcmp(value, "1"))
+      || !edf_header_value(header, "ByteOrder", value, sizeof(value))
+      || compare_format(value, native))
+    goto out;
+
+  if (edf_header_value(header, "DataType", value, sizeof(value)))
+    for (i = 0; types[i].name; ++i)
+      if (!compare_format(value, types[i].name))
+        type = types[i].type;
+
+  if (type == 0
+      || !edf_header_value(header, "Dim_1", value, sizeof(value))
+      || sscanf(value, "%zu", &width) != 1
+      || !edf_header_value(header, "Dim_2", value, sizeof(value))
+      || sscanf(value, "%zu", &height) != 1)
+    goto out;
+
+  if (edf_header_value(header, "Size", value, sizeof(value))
+      && (sscanf(value, "%zu", &n) != 1
+          || n != width * height * saxs_image_type_size(type)))
+    goto out;
+
+  res = saxs_image_map(image, filename, end + 2 - header,
+                       width, height, 1, 1, type, 0);
+
+out:
+  free(header);
+  return res;
+}
+
+int saxs_image_edf_read(saxs_image *image, const char *filename, size_t frame) {
+  int res;
+
+  if (frame == 1 && edf_map(image, filename) == 0)
+    return 0;
+
+  pthread_mutex_lock(&edf_lock);
+  res = edf_read(image, filename, frame);
+  pthread_mutex_unlock(&edf_lock);
+
+  return res;
 }
 
 /**************************************************************************/
@@ -85,7 +218,8 @@ int saxs_image_edf_read(saxs_image *image, const char *filename, size_t frame) {
 saxs_image_format*
 saxs_image_format_edf(const char *filename, const char *format) {
   static saxs_image_format image_edf = { saxs_image_edf_read,
-                                         NULL, /* write */ };
+                                         NULL, /* write */
+                                         NULL  /* refresh */ };
 
   if (!compare_format(format, "edf")
       || !compare_format(suffix(filename), "edf"))
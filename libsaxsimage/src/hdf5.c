@@ -22,85 +22,573 @@
  */
 
 #include "saxsimage.h"
+#include "saxsimage_format.h"
 
 #include <hdf5.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <errno.h>
+#include <pthread.h>
 
+/*
+ * Unless built with --enable-threadsafe, the HDF5 library must not be
+ * entered by more than one thread at a time.
+ */
+static pthread_mutex_t hdf5_lock = PTHREAD_MUTEX_INITIALIZER;
 
-int saxs_image_hdf5_read(saxs_image *image, const char *filename, size_t frame) {
+/*
+ * The frames of a file may be spread over several datasets: EIGER
+ * master files link to data files of a fixed number of frames each,
+ * data_000001, data_000002 and so on. Parts are opened when first
+ * read from and kept open from then on.
+ */
+struct hdf5_part {
+  char *path;                         /* of the dataset in the file */
+  hid_t dataset_id, filespace;
+  hsize_t first, frames;              /* first frame is zero-based */
+};
 
-  hid_t file_id, dataset_id, filespace, memspace;
-  hsize_t dim[3], offset[3], size[3]; /* frames, xdim, ydim */
-  herr_t res;
-  int rank, x, y;
+/*
+ * Kept with the image from the first frame read on, so that stepping
+ * through the frames of a file does not open the file and parse its
+ * metadata again for every frame.
+ */
+struct hdf5_state {
+  hid_t file_id, access, memspace;
+  hsize_t dim[3];                     /* frames, ydim, xdim */
+  struct hdf5_part *parts;
+  size_t nparts;
   int *mem;
+  int swmr;
+};
+
+static void hdf5_close_part(struct hdf5_part *part) {
+  if (part->filespace >= 0)
+    H5Sclose(part->filespace);
+  if (part->dataset_id >= 0)
+    H5Dclose(part->dataset_id);
+
+  part->filespace = part->dataset_id = -1;
+}
+
+static void hdf5_close(struct hdf5_state *state) {
+  size_t i;
+
+  for (i = 0; i < state->nparts; ++i) {
+    hdf5_close_part(&state->parts[i]);
+    free(state->parts[i].path);
+  }
+  free(state->parts);
+
+  if (state->memspace >= 0)
+    H5Sclose(state->memspace);
+  if (state->access != H5P_DEFAULT)
+    H5Pclose(state->access);
+  if (state->file_id >= 0)
+    H5Fclose(state->file_id);
+
+  free(state->mem);
+  free(state);
+}
+
+static void hdf5_state_free(void *state) {
+  pthread_mutex_lock(&hdf5_lock);
+  hdf5_close(state);
+  pthread_mutex_unlock(&hdf5_lock);
+}
+
+/*
+ * Frames are mostly read one after the other. If chunks span several
+ * frames, keep all chunks of a frame in the chunk cache; otherwise each
+ * chunk would be read and decompressed again for each of its frames.
+ */
+static hid_t hdf5_access_plist(hid_t dataset_id, const hsize_t *dim) {
+  hid_t plist, type;
+  hsize_t chunk[3];
+  size_t chunks, bytes;
+  int rank = -1;
+
+  plist = H5Dget_create_plist(dataset_id);
+  if (plist < 0)
+    return H5P_DEFAULT;
+  if (H5Pget_layout(plist) == H5D_CHUNKED)
+    rank = H5Pget_chunk(plist, 3, chunk);
+  H5Pclose(plist);
+
+  if (rank != 3 || chunk[0] <= 1)
+    return H5P_DEFAULT;
+
+  type = H5Dget_type(dataset_id);
+  if (type < 0)
+    return H5P_DEFAULT;
+
+  chunks = ((dim[1] + chunk[1] - 1) / chunk[1])
+             * ((dim[2] + chunk[2] - 1) / chunk[2]);
+  bytes  = chunks * chunk[0] * chunk[1] * chunk[2] * H5Tget_size(type);
+  H5Tclose(type);
+
+  plist = H5Pcreate(H5P_DATASET_ACCESS);
+  if (plist < 0)
+    return H5P_DEFAULT;
+
+  /*
+   * About 100 hash slots per cached chunk as suggested by the HDF5
+   * documentation; evict chunks read completely first.
+   */
+  H5Pset_chunk_cache(plist, 100 * chunks + 1, bytes, 1.0);
+  return plist;
+}
+
+#define HDF5_NAME_SIZE 256
+
+/*
+ * Reads the string attribute name of object into value, at most size - 1
+ * characters; returns 0 if there is no such attribute.
+ */
+static int hdf5_attribute(hid_t object, const char *name,
+                          char *value, size_t size) {
+  hid_t attribute, space, type, memtype;
+  herr_t res = -1;
+
+  value[0] = '\0';
+  if (H5Aexists(object, name) <= 0)
+    return 0;
+
+  attribute = H5Aopen(object, name, H5P_DEFAULT);
+  if (attribute < 0)
+    return 0;
+
+  space = H5Aget_space(attribute);
+  type  = H5Aget_type(attribute);
+  if (space >= 0 && H5Sget_simple_extent_npoints(space) == 1
+      && type >= 0 && H5Tget_class(type) == H5T_STRING) {
+    memtype = H5Tcopy(H5T_C_S1);
+
+    /* NeXus files written by h5py mostly use variable length strings. */
+    if (H5Tis_variable_str(type) > 0) {
+      char *string = NULL;
+
+      H5Tset_size(memtype, H5T_VARIABLE);
+      res = H5Aread(attribute, memtype, &string);
+      if (res >= 0 && string) {
+        strncpy(value, string, size - 1);
+        value[size - 1] = '\0';
+      }
+      H5free_memory(string);
+
+    } else {
+      H5Tset_size(memtype, size);
+      H5Tset_strpad(memtype, H5T_STR_NULLTERM);
+      res = H5Aread(attribute, memtype, value);
+    }
+
+    H5Tclose(memtype);
+  }
+
+  if (type >= 0)
+    H5Tclose(type);
+  if (space >= 0)
+    H5Sclose(space);
+  H5Aclose(attribute);
+
+  return res >= 0 && value[0] != '\0';
+}
+
+struct hdf5_find {
+  const char *nx_class;
+  char name[HDF5_NAME_SIZE];
+};
+
+static herr_t hdf5_find_class(hid_t group, const char *name,
+                              const H5L_info_t *info, void *arg) {
+  struct hdf5_find *find = arg;
+  char nx_class[HDF5_NAME_SIZE];
+  hid_t object;
+  int found;
+
+  /* Do not open other files just to look. */
+  if (info->type == H5L_TYPE_EXTERNAL || strlen(name) >= HDF5_NAME_SIZE)
+    return 0;
+
+  object = H5Oopen(group, name, H5P_DEFAULT);
+  if (object < 0)
+    return 0;
+
+  found = H5Iget_type(object) == H5I_GROUP
+          && hdf5_attribute(object, "NX_class", nx_class, sizeof(nx_class))
+          && !strcmp(nx_class, find->nx_class);
+  H5Oclose(object);
+
+  if (found)
+    strcpy(find->name, name);
+  return found;
+}
+
+/*
+ * The member of group named by its NeXus "default" attribute, else
+ * the first one of the given NX_class.
+ */
+static int hdf5_child(hid_t group, const char *nx_class, char *name) {
+  struct hdf5_find find;
+
+  if (hdf5_attribute(group, "default", name, HDF5_NAME_SIZE)
+      && H5Lexists(group, name, H5P_DEFAULT) > 0)
+    return 1;
+
+  find.nx_class = nx_class;
+  if (H5Literate(group, H5_INDEX_NAME, H5_ITER_INC, NULL,
+                 hdf5_find_class, &find) > 0) {
+    strcpy(name, find.name);
+    return 1;
+  }
+
+  return 0;
+}
+
+static int hdf5_add_part(struct hdf5_state *state, const char *group,
+                         const char *name) {
+  struct hdf5_part *parts, *part;
+
+  parts = realloc(state->parts, (state->nparts + 1) * sizeof(struct hdf5_part));
+  if (!parts)
+    return -1;
+  state->parts = parts;
+
+  part = &parts[state->nparts];
+  part->path = malloc(strlen(group) + strlen(name) + 2);
+  if (!part->path)
+    return -1;
+  sprintf(part->path, "%s/%s", group, name);
+
+  part->dataset_id = part->filespace = -1;
+  part->first  = 0;
+  part->frames = 0;
+
+  state->nparts += 1;
+  return 0;
+}
+
+struct hdf5_collect {
+  struct hdf5_state *state;
+  const char *group;
+};
+
+/* EIGER data files are linked as data_000001, data_000002, ... */
+static herr_t hdf5_collect_parts(hid_t group, const char *name,
+                                 const H5L_info_t *info, void *arg) {
+  struct hdf5_collect *collect = arg;
+  (void)group;
+  (void)info;
+
+  if (strncmp(name, "data_", 5) != 0 || name[5] == '\0'
+      || strspn(name + 5, "0123456789") != strlen(name + 5))
+    return 0;
 
-  /* Open an existing file. */
-  file_id = H5Fopen(filename, H5F_ACC_RDWR, H5P_DEFAULT);
+  return hdf5_add_part(collect->state, collect->group, name) == 0 ? 0 : -1;
+}
 
-  /* Open an existing dataset. */
-  /* FIXME: read this path out of the actual master file! */
-  dataset_id = H5Dopen2(file_id, "/entry/data/data/", H5P_DEFAULT);
+/*
+ * Finds the datasets of the frames. The NXdata group is the one the
+ * NeXus "default" attributes point to, else the first of the first
+ * NXentry, else /entry/data as in EIGER files of older firmware. Within
+ * the group, linked EIGER data files come first, then the "signal"
+ * dataset of NeXus, then one named "data".
+ */
+static int hdf5_discover(struct hdf5_state *state) {
+  char entry[HDF5_NAME_SIZE], data[HDF5_NAME_SIZE], signal[HDF5_NAME_SIZE];
+  char path[2 * HDF5_NAME_SIZE + 2] = "/entry/data";
+  struct hdf5_collect collect;
+  hid_t group;
+  int res = 0;
 
-  /* Obtain the dataspace for whole dataset */
-  filespace = H5Dget_space(dataset_id);
+  if (hdf5_child(state->file_id, "NXentry", entry)) {
+    group = H5Gopen2(state->file_id, entry, H5P_DEFAULT);
+    if (group >= 0) {
+      if (hdf5_child(group, "NXdata", data))
+        sprintf(path, "/%s/%s", entry, data);
+      H5Gclose(group);
+    }
+  }
 
-  /* Get rank and dimension of dataset */
-  rank = H5Sget_simple_extent_ndims(filespace);
-  H5Sget_simple_extent_dims(filespace, dim, NULL);
-printf("%ld %ld %ld\n", dim[0], dim[1], dim[2]);
-  mem = (int*)malloc(dim[1] * dim[2] * sizeof(int));
-  if (!mem)
+  group = H5Gopen2(state->file_id, path, H5P_DEFAULT);
+  if (group < 0)
     return -1;
 
+  collect.state = state;
+  collect.group = path;
+  if (H5Literate(group, H5_INDEX_NAME, H5_ITER_INC, NULL,
+                 hdf5_collect_parts, &collect) < 0)
+    res = -1;
+
+  else if (state->nparts == 0) {
+    if (!hdf5_attribute(group, "signal", signal, sizeof(signal)))
+      strcpy(signal, "data");
+    res = hdf5_add_part(state, path, signal);
+  }
+
+  H5Gclose(group);
+  return res;
+}
+
+/*
+ * Opens the dataset of a part, following links into other files, and
+ * checks that its frames are of the size of the others. Returns the
+ * number of frames in it, 0 on failure.
+ */
+static hsize_t hdf5_open_part(struct hdf5_state *state, struct hdf5_part *part) {
+  hsize_t dim[3];
+
+  part->dataset_id = H5Dopen2(state->file_id, part->path, state->access);
+  if (part->dataset_id < 0)
+    return 0;
+
+  part->filespace = H5Dget_space(part->dataset_id);
+  if (part->filespace < 0
+      || H5Sget_simple_extent_ndims(part->filespace) != 3
+      || H5Sget_simple_extent_dims(part->filespace, dim, NULL) < 0
+      || dim[0] == 0 || dim[1] == 0 || dim[2] == 0
+      || (state->dim[1] != 0
+          && (dim[1] != state->dim[1] || dim[2] != state->dim[2]))) {
+    hdf5_close_part(part);
+    return 0;
+  }
+
+  state->dim[1] = dim[1];
+  state->dim[2] = dim[2];
+  return dim[0];
+}
+
+static struct hdf5_state* hdf5_open(const char *filename) {
+  struct hdf5_state *state;
+  struct hdf5_part *first, *last;
+  hsize_t size[3];
+  size_t i;
+  int res;
+
+  state = calloc(1, sizeof(struct hdf5_state));
+  if (!state)
+    return NULL;
+
+  state->access   = H5P_DEFAULT;
+  state->memspace = -1;
+
+  /*
+   * Open an existing file, read-only. Detectors write files that allow
+   * for single-writer/multiple-reader access, so that frames can be read
+   * while others are still being added; older files need to be opened
+   * without, as does everything before HDF5 1.10.
+   */
+#if H5_VERSION_GE(1,10,0)
+  H5E_BEGIN_TRY {
+    state->file_id = H5Fopen(filename, H5F_ACC_RDONLY | H5F_ACC_SWMR_READ,
+                             H5P_DEFAULT);
+  } H5E_END_TRY;
+#else
+  state->file_id = -1;
+#endif
+
+  state->swmr = state->file_id >= 0;
+  if (!state->swmr)
+    state->file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (state->file_id < 0)
+    goto error;
+
+  /* Looking for what is not there is no error. */
+  H5E_BEGIN_TRY {
+    res = hdf5_discover(state);
+  } H5E_END_TRY;
+  if (res != 0 || state->nparts == 0)
+    goto error;
+
+  /* The first part tells the size of frames and how they are chunked. */
+  first = &state->parts[0];
+  first->frames = hdf5_open_part(state, first);
+  if (first->frames == 0)
+    goto error;
+
+  /* Reopen with a chunk cache suitable for the layout, as all parts. */
+  state->access = hdf5_access_plist(first->dataset_id, state->dim);
+  if (state->access != H5P_DEFAULT) {
+    hdf5_close_part(first);
+    if (hdf5_open_part(state, first) != first->frames)
+      goto error;
+  }
+
+  /*
+   * All but the last part are taken to hold as many frames as the
+   * first one, as EIGER data files do; this is checked once they are
+   * opened. The last one tells the number of frames.
+   */
+  for (i = 1; i < state->nparts; ++i) {
+    state->parts[i].first  = state->parts[i - 1].first + first->frames;
+    state->parts[i].frames = first->frames;
+  }
+
+  last = &state->parts[state->nparts - 1];
+  if (last != first) {
+    last->frames = hdf5_open_part(state, last);
+    if (last->frames == 0)
+      goto error;
+  }
+  state->dim[0] = last->first + last->frames;
+
+  state->mem = malloc(state->dim[1] * state->dim[2] * sizeof(int));
+  if (!state->mem)
+    goto error;
+
   /*
    * Create a description of the memory block we want to read, i.e. one frame.
    */
   size[0] = 1;
-  size[1] = dim[1];
-  size[2] = dim[2];
-  memspace = H5Screate_simple(rank, size, NULL);
+  size[1] = state->dim[1];
+  size[2] = state->dim[2];
+  state->memspace = H5Screate_simple(3, size, NULL);
+  if (state->memspace < 0)
+    goto error;
+
+  return state;
+
+error:
+  hdf5_close(state);
+  return NULL;
+}
+
+/* The state of the image, opened if not yet. */
+static struct hdf5_state* hdf5_state(saxs_image *image, const char *filename) {
+  struct hdf5_state *state = saxs_image_format_state(image);
+
+  if (!state) {
+    state = hdf5_open(filename);
+    if (state)
+      saxs_image_set_format_state(image, state, hdf5_state_free);
+  }
+
+  return state;
+}
+
+static int hdf5_read(saxs_image *image, const char *filename, size_t frame) {
+  struct hdf5_state *state = hdf5_state(image, filename);
+  struct hdf5_part *part;
+  hsize_t offset[3], size[3];
+  herr_t res;
+
+  if (!state)
+    return 1;
+
+  if (frame > state->dim[0])
+    return 1;
+
+  /* There are few parts, if more than one. */
+  part = state->parts;
+  while (frame - 1 >= part->first + part->frames)
+    ++part;
+
+  /* Frames would be numbered wrong unless as many as assumed. */
+  if (part->dataset_id < 0 && hdf5_open_part(state, part) != part->frames) {
+    hdf5_close_part(part);
+    return 1;
+  }
 
   /* 
    * Define the offset from the beginning of the data to the selected frame (hyperslab). 
    */
-  offset[0] = frame - 1;   /* this frame (zero-offset) */
-  offset[1] = 0;           /* beginning at (0,0) */
+  offset[0] = frame - 1 - part->first;   /* this frame (zero-offset) */
+  offset[1] = 0;                         /* beginning at (0,0) */
   offset[2] = 0;
-  H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, 
+  size[0] = 1;
+  size[1] = state->dim[1];
+  size[2] = state->dim[2];
+  H5Sselect_hyperslab(part->filespace, H5S_SELECT_SET, offset,
                       NULL /* stride */ , size, NULL /* block */);
 
-  res = H5Dread(dataset_id, H5T_NATIVE_INT, memspace, filespace, H5P_DEFAULT, mem);
+  res = H5Dread(part->dataset_id, H5T_NATIVE_INT, state->memspace,
+                part->filespace, H5P_DEFAULT, state->mem);
 
-  if (res >= 0) {
-    saxs_image_set_size(image, dim[2], dim[1], dim[0], frame);
+  if (res >= 0 && saxs_image_resize(image, state->dim[2], state->dim[1],
+                                    state->dim[0], frame,
+                                    SAXS_IMAGE_TYPE_INT32) != 0)
+    res = -1;
 
+  if (res >= 0) {
     /* Data in "mem" is stored in row-major. */
-    for(y = 0; y < dim[1]; y++)
-      for(x = 0; x < dim[2]; x++)
-         saxs_image_set_value(image, x, dim[1] - y - 1, *(mem + y * dim[2] + x));
+    saxs_image_set_pixels(image, state->mem, SAXS_IMAGE_TYPE_INT32,
+                          SAXS_IMAGE_LAYOUT_TOPDOWN);
   }
 
-  H5Sclose(memspace);
-  H5Sclose(filespace);
-  H5Dclose(dataset_id);
-  H5Fclose(file_id);
-  free(mem);
-
   return res < 0;
 }
 
+/*
+ * Frames added are followed in files of a single dataset only, and
+ * with HDF5 1.10 or later.
+ */
+#if H5_VERSION_GE(1,10,0)
+static int hdf5_refresh(saxs_image *image, size_t *frame_count) {
+  struct hdf5_state *state = hdf5_state(image, saxs_image_filename(image));
+  struct hdf5_part *part;
+  hsize_t dim[3];
+
+  if (!state)
+    return EIO;
+  if (!state->swmr || state->nparts != 1)
+    return ENOTSUP;
+
+  /* Frames are appended, the size of a frame stays. */
+  part = &state->parts[0];
+  if (H5Drefresh(part->dataset_id) < 0)
+    return EIO;
+
+  H5Sclose(part->filespace);
+  part->filespace = H5Dget_space(part->dataset_id);
+  if (part->filespace < 0
+      || H5Sget_simple_extent_dims(part->filespace, dim, NULL) != 3
+      || dim[1] != state->dim[1] || dim[2] != state->dim[2])
+    return EIO;
+
+  part->frames  = dim[0];
+  state->dim[0] = dim[0];
+  *frame_count  = dim[0];
+  return 0;
+}
+#else
+static int hdf5_refresh(saxs_image *image, size_t *frame_count) {
+  (void)image;
+  (void)frame_count;
+  return ENOTSUP;
+}
+#endif
+
+int saxs_image_hdf5_read(saxs_image *image, const char *filename, size_t frame) {
+  int res;
+
+  pthread_mutex_lock(&hdf5_lock);
+  res = hdf5_read(image, filename, frame);
+  pthread_mutex_unlock(&hdf5_lock);
+
+  return res;
+}
+
+int saxs_image_hdf5_refresh(saxs_image *image, size_t *frame_count) {
+  int res;
+
+  pthread_mutex_lock(&hdf5_lock);
+  res = hdf5_refresh(image, frame_count);
+  pthread_mutex_unlock(&hdf5_lock);
+
+  return res;
+}
+
 /**************************************************************************/
 #include "saxsimage_format.h"
 
 saxs_image_format*
 saxs_image_format_hdf5(const char *filename, const char *format) {
   static saxs_image_format image_hdf5 = { saxs_image_hdf5_read,
-                                          NULL };
+                                          NULL, /* write */
+                                          saxs_image_hdf5_refresh };
 
   if (!compare_format(format, "h5")
       || !compare_format(suffix(filename), "h5")
@@ -80,6 +80,7 @@ static msk_word MSK_GET(msk_word leword) {
 int saxs_image_msk_read(saxs_image *image, const char *filename, size_t frame) {
   msk_word magic[4] = { 0 };
   msk_word *data = NULL, *tmp;
+  uint8_t *values;
   msk_word lewidth, leheight, lepadding;
   unsigned int width, height;
   unsigned int row, col, bit;
@@ -143,19 +144,29 @@ int saxs_image_msk_read(saxs_image *image, const char *filename, size_t frame) {
    * this simplifies reading as no further special boundary
    * conditions need to be checked.
    */
-  saxs_image_set_size(image, width, height, 1, 1);
+  values = malloc(width);
+  if (!values
+      || saxs_image_resize(image, width, height, 1, 1, SAXS_IMAGE_TYPE_UINT8) != 0) {
+    free(values);
+    free(data);
+    return ENOMEM;
+  }
 
   tmp = data;
-  for (row = 0; row < height; ++row)
+  for (row = 0; row < height; ++row) {
     for (col = 0; col < width; col += MSK_WORD_BITS) {
       const msk_word leword = *tmp;
       const msk_word word = MSK_GET(leword);
       for (bit = 0; bit < MSK_WORD_BITS && col + bit < width; ++bit)
-        saxs_image_set_value(image, col + bit, row, (word & (1u << bit)) ? 1.0 : 0.0);
+        values[col + bit] = (word & (1u << bit)) ? 1 : 0;
 
       ++tmp;
     }
 
+    saxs_image_set_row(image, row, values, SAXS_IMAGE_TYPE_UINT8);
+  }
+
+  free(values);
   free(data);
   return 0;
 
@@ -177,6 +188,7 @@ int saxs_image_msk_write(saxs_image *image, const char *filename) {
   unsigned int width, height, padding;
   msk_word lewidth, leheight, lepadding;
   int row, col, bit;
+  double *values;
 
   FILE *fd = fopen(filename, "wb");
   if (!fd)
@@ -203,20 +215,30 @@ int saxs_image_msk_write(saxs_image *image, const char *filename) {
   if (fseek(fd, 1024, SEEK_SET) != 0)
     goto error;
 
-  for (row = 0; row < height; ++row)
+  values = malloc(width * sizeof(double));
+  if (!values && width > 0)
+    goto error;
+
+  for (row = 0; row < height; ++row) {
+    saxs_image_get_row(image, row, values, SAXS_IMAGE_TYPE_DOUBLE);
+
     for (col = 0; col < width; col += MSK_WORD_BITS) {
       msk_word word = 0;
 
       for (bit = 0; (unsigned)bit < MSK_WORD_BITS && col + bit < width; ++bit) {
-        double value = saxs_image_value(image, col + bit, row);
-        if (fabs(value) > DBL_EPSILON)
+        if (fabs(values[col + bit]) > DBL_EPSILON)
           word |= (1 << bit);
       }
 
       const msk_word leword = MSK_PUT(word);
-      if (fwrite(&leword, MSK_WORD_SIZE, 1, fd) != 1)
+      if (fwrite(&leword, MSK_WORD_SIZE, 1, fd) != 1) {
+        free(values);
         goto error;
+      }
     }
+  }
+
+  free(values);
 
   /* Any footer? */
 
@@ -239,7 +261,8 @@ error:
 saxs_image_format*
 saxs_image_format_msk(const char *filename, const char *format) {
   static saxs_image_format image_msk = { saxs_image_msk_read,
-                                         saxs_image_msk_write };
+                                         saxs_image_msk_write,
+                                         NULL  /* refresh */ };
 
   if (!compare_format(format, "msk")
       || !compare_format(suffix(filename), "msk"))
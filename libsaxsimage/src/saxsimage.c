@@ -24,6 +24,7 @@
 #include "saxsimage.h"
 #include "saxsimage_format.h"
 #include "saxsproperty.h"
+#include "saxsthreadpool.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,13 +33,57 @@
 #include <float.h>
 #include <errno.h>
 #include <assert.h>
+#include <stdint.h>
+#include <math.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 struct saxs_image {
   char *image_filename;
 
   size_t image_width;
   size_t image_height;
-  double *image_data;
+
+  /* Pixels in their native type, see saxs_image_type(). */
+  int image_type;
+  void *image_data;
+
+  /*
+   * If not NULL, image_data points into this private mapping of the
+   * file instead of being malloc'ed, see saxs_image_map().
+   */
+  void *image_mapping;
+  size_t image_mapping_size;
+
+  /* Rows in memory from top to bottom, i.e. as in most files. */
+  int image_topdown;
+
+  /* Pixels converted to double on demand, NULL if not (yet) needed. */
+  double *image_data_double;
+  int image_data_double_valid;
+
+  /* Set if the pixels differ from what the reader decoded. */
+  int image_data_modified;
+
+  /* Decoded frames other than the current one, most recent first. */
+  struct saxs_image_cached_frame *frame_cache;
+  size_t frame_cache_bytes, frame_cache_size;
+
+  /* Frames being decoded in the background, see saxs_image_set_prefetch(). */
+  struct saxs_image_prefetch *prefetch;
+  size_t prefetch_count;
+  int prefetch_direction;
+
+  /* Requests dropped while still decoding, freed once done. */
+  struct saxs_image_prefetch *prefetch_dropped;
+
+  /* See saxs_image_set_verify_checksums(). */
+  int verify_checksums;
 
   size_t image_frame_count;
   size_t image_current_frame;
@@ -46,37 +91,192 @@ struct saxs_image {
   /* Callback functions to deal with the current format. */
   const saxs_image_format *image_format;
 
+  /* See saxs_image_set_format_state(). */
+  void *format_state;
+  void (*format_state_free)(void*);
+
   saxs_property_list *image_properties;
 
   /* pre computed and cached values */
   int cache_valid;
-  double cache_min_value, cache_max_value;
+  saxs_image_stats cache_stats;
+
+  /*
+   * Summed-area tables of the valid pixels, see saxs_image_roi_sum(),
+   * (width + 1) x (height + 1) with a first row and column of zeros.
+   */
+  int table_valid;
+  double *table_sum;
+  uint32_t *table_count;
+};
+
+struct saxs_image_cached_frame {
+  size_t frame;
+  size_t width, height;
+  int type;
+  void *data;
+  void *mapping;
+  size_t mapping_size;
+  int topdown;
+
+  int stats_valid;
+  saxs_image_stats stats;
+
+  struct saxs_image_cached_frame *next;
 };
 
+struct saxs_image_prefetch {
+  size_t frame;
+  saxs_image_request *request;
+  struct saxs_image_prefetch *next;
+};
+
+static void saxs_image_update_cache(saxs_image *image);
 
 static void
-saxs_image_update_cache(saxs_image *image) {
-  if (image && !image->cache_valid) {
-    size_t i, j;
-    const size_t width = saxs_image_width(image);
-    const size_t height = saxs_image_height(image);
-
-    image->cache_min_value = DBL_MAX;
-    image->cache_max_value = DBL_MIN;
-
-    for (i = 0; i < width; ++i)
-      for (j = 0; j < height; ++j) {
-        double value = saxs_image_value(image, i, j);
-        if (image->cache_min_value > value)
-          image->cache_min_value = value;
-        if (image->cache_max_value < value)
-          image->cache_max_value = value;
-      }
+free_pixels(void *data, void *mapping, size_t mapping_size) {
+#ifndef _WIN32
+  if (mapping) {
+    munmap(mapping, mapping_size);
+    return;
+  }
+#endif
+  free(data);
+}
 
-    image->cache_valid = 1;
+/* Row y, counted from the bottom, in memory. */
+static char*
+pixel_row(saxs_image *image, size_t y) {
+  if (image->image_topdown)
+    y = image->image_height - y - 1;
+
+  return (char*)image->image_data
+           + y * image->image_width * saxs_image_type_size(image->image_type);
+}
+
+static void prefetch_clear(saxs_image *image);
+static void prefetch_harvest(saxs_image *image);
+static void prefetch_schedule(saxs_image *image);
+static struct saxs_image_cached_frame* prefetch_take(saxs_image *image,
+                                                     size_t frame);
+
+
+static size_t
+frame_cache_bytes(const struct saxs_image_cached_frame *entry) {
+  return entry->width * entry->height * saxs_image_type_size(entry->type);
+}
+
+/* Drops least recently used frames until at most 'bytes' are used. */
+static void
+frame_cache_trim(saxs_image *image, size_t bytes) {
+  struct saxs_image_cached_frame **link;
+
+  while (image->frame_cache_bytes > bytes) {
+    for (link = &image->frame_cache; (*link)->next; link = &(*link)->next)
+      ;
+
+    image->frame_cache_bytes -= frame_cache_bytes(*link);
+    free_pixels((*link)->data, (*link)->mapping, (*link)->mapping_size);
+    free(*link);
+    *link = NULL;
   }
 }
 
+/* Moves the current pixels out of the image into 'entry'. */
+static void
+frame_cache_detach(saxs_image *image, struct saxs_image_cached_frame *entry) {
+  entry->frame        = image->image_current_frame;
+  entry->width        = image->image_width;
+  entry->height       = image->image_height;
+  entry->type         = image->image_type;
+  entry->data         = image->image_data;
+  entry->mapping      = image->image_mapping;
+  entry->mapping_size = image->image_mapping_size;
+  entry->topdown      = image->image_topdown;
+  entry->stats_valid  = image->cache_valid;
+  entry->stats        = image->cache_stats;
+  entry->next         = NULL;
+
+  image->image_data = NULL;
+  image->image_mapping = NULL;
+  image->image_mapping_size = 0;
+  image->image_topdown = 0;
+  free(image->image_data_double);
+  image->image_data_double = NULL;
+  image->image_data_double_valid = 0;
+}
+
+/* The reverse of frame_cache_detach(), the image must not have pixels. */
+static void
+frame_cache_attach(saxs_image *image, struct saxs_image_cached_frame *entry) {
+  assert(image->image_data == NULL);
+
+  image->image_current_frame = entry->frame;
+  image->image_width         = entry->width;
+  image->image_height        = entry->height;
+  image->image_type          = entry->type;
+  image->image_data          = entry->data;
+  image->image_mapping       = entry->mapping;
+  image->image_mapping_size  = entry->mapping_size;
+  image->image_topdown       = entry->topdown;
+  image->image_data_modified = 0;
+  image->cache_valid         = entry->stats_valid;
+  image->cache_stats         = entry->stats;
+  image->table_valid         = 0;
+}
+
+/*
+ * Takes ownership of the pixels of a detached frame. Frames that were
+ * modified or do not fit at all are dropped right away.
+ */
+static void
+frame_cache_insert(saxs_image *image, struct saxs_image_cached_frame *entry,
+                   int modified) {
+  const size_t bytes = frame_cache_bytes(entry);
+  struct saxs_image_cached_frame *cached = NULL;
+
+  if (!modified && entry->data && bytes <= image->frame_cache_size)
+    cached = malloc(sizeof(struct saxs_image_cached_frame));
+
+  if (!cached) {
+    free_pixels(entry->data, entry->mapping, entry->mapping_size);
+    return;
+  }
+
+  frame_cache_trim(image, image->frame_cache_size - bytes);
+
+  *cached = *entry;
+  cached->next = image->frame_cache;
+  image->frame_cache = cached;
+  image->frame_cache_bytes += bytes;
+}
+
+static int
+frame_cache_contains(saxs_image *image, size_t frame) {
+  struct saxs_image_cached_frame *entry;
+
+  for (entry = image->frame_cache; entry; entry = entry->next)
+    if (entry->frame == frame)
+      return 1;
+
+  return 0;
+}
+
+/* Removes and returns the cached frame, NULL if there is none. */
+static struct saxs_image_cached_frame*
+frame_cache_take(saxs_image *image, size_t frame) {
+  struct saxs_image_cached_frame **link, *entry;
+
+  for (link = &image->frame_cache; *link; link = &(*link)->next)
+    if ((*link)->frame == frame) {
+      entry = *link;
+      *link = entry->next;
+      image->frame_cache_bytes -= frame_cache_bytes(entry);
+      return entry;
+    }
+
+  return NULL;
+}
 
 
 saxs_image*
@@ -88,13 +288,31 @@ saxs_image_create() {
   image->image_filename      = NULL;
   image->image_width         = 0;
   image->image_height        = 0;
+  image->image_type          = SAXS_IMAGE_TYPE_DOUBLE;
   image->image_data          = NULL;
+  image->image_mapping       = NULL;
+  image->image_mapping_size  = 0;
+  image->image_topdown       = 0;
+  image->image_data_double   = NULL;
+  image->image_data_double_valid = 0;
+  image->image_data_modified = 0;
+  image->frame_cache         = NULL;
+  image->frame_cache_bytes   = 0;
+  image->frame_cache_size    = SAXS_IMAGE_FRAME_CACHE_SIZE;
+  image->prefetch            = NULL;
+  image->prefetch_count      = 0;
+  image->prefetch_direction  = 1;
+  image->prefetch_dropped    = NULL;
+  image->verify_checksums    = 0;
   image->image_frame_count   = 0;
   image->image_current_frame = 0;
   image->cache_valid         = 0;
-  image->cache_min_value     = DBL_MAX;
-  image->cache_max_value     = DBL_MIN;
+  image->table_valid         = 0;
+  image->table_sum           = NULL;
+  image->table_count         = NULL;
   image->image_format        = NULL;
+  image->format_state        = NULL;
+  image->format_state_free   = NULL;
   image->image_properties    = saxs_property_list_create();
   if (!image->image_properties) {
     free(image);
@@ -113,6 +331,28 @@ saxs_image_copy(saxs_image *image) {
   if (!copy)
     return NULL;
 
+  copy->image_filename      = NULL;
+  copy->image_data          = NULL;
+  copy->image_mapping       = NULL;
+  copy->image_mapping_size  = 0;
+  copy->image_topdown       = 0;
+  copy->image_data_double   = NULL;
+  copy->image_data_double_valid = 0;
+  copy->image_data_modified = image->image_data_modified;
+  copy->frame_cache         = NULL;
+  copy->frame_cache_bytes   = 0;
+  copy->frame_cache_size    = image->frame_cache_size;
+  copy->prefetch            = NULL;
+  copy->prefetch_count      = image->prefetch_count;
+  copy->prefetch_direction  = image->prefetch_direction;
+  copy->prefetch_dropped    = NULL;
+  copy->verify_checksums    = image->verify_checksums;
+  copy->image_properties    = NULL;
+  copy->table_valid         = 0;
+  copy->table_sum           = NULL;
+  copy->table_count         = NULL;
+  copy->format_state        = NULL;
+  copy->format_state_free   = NULL;
   if (image->image_filename) {
     copy->image_filename      = strdup(image->image_filename);
     if (!copy->image_filename) {
@@ -120,13 +360,13 @@ saxs_image_copy(saxs_image *image) {
       return NULL;
     }
   }
-  copy->image_data          = NULL;
-  copy->image_format        = NULL;
+  copy->image_format        = image->image_format;
+  copy->image_width         = image->image_width;
+  copy->image_height        = image->image_height;
   copy->image_frame_count   = image->image_frame_count;
   copy->image_current_frame = image->image_current_frame;
   copy->cache_valid         = image->cache_valid;
-  copy->cache_min_value     = image->cache_min_value;
-  copy->cache_max_value     = image->cache_max_value;
+  copy->cache_stats         = image->cache_stats;
 
   copy->image_properties    = saxs_property_list_create();
   if (!copy->image_properties) {
@@ -145,16 +385,22 @@ saxs_image_copy(saxs_image *image) {
     saxs_property_list_insert(copy->image_properties, prop_copy);
   }
 
+  copy->image_type          = image->image_type;
   if (image->image_data) {
-    saxs_image_set_size(copy, image->image_width, image->image_height,
-                        image->image_frame_count, image->image_current_frame);
-    if (!copy->image_data) {
+    if (saxs_image_resize(copy, image->image_width, image->image_height,
+                          image->image_frame_count, image->image_current_frame,
+                          image->image_type) != 0) {
       saxs_image_free(copy);
       return NULL;
     }
 
-    memcpy(copy->image_data, image->image_data,
-           image->image_width * image->image_height * sizeof(double));
+    saxs_image_convert_block(pixel_row(image, 0), image->image_type,
+                             saxs_image_type_size(image->image_type),
+                             saxs_image_row_stride(image),
+                             copy->image_data, copy->image_type,
+                             saxs_image_row_stride(copy),
+                             image->image_width, image->image_height);
+    copy->image_data_modified = image->image_data_modified;
   }
 
   assert(copy);
@@ -169,35 +415,58 @@ saxs_image_copy(saxs_image *image) {
   return copy;
 }
 
-int
-saxs_image_read(saxs_image *image, const char *filename, const char *format) {
-  assert(image);
-  assert(filename);
-
-  const saxs_image_format* handler = saxs_image_format_find(filename, format);
-  if (!handler)
-    return -1;
-  if (!handler->read)
-    return -2;
-
+/* Reads with a known format handler, see saxs_image_read_at(). */
+static int
+saxs_image_read_with(saxs_image *image, const char *filename,
+                     const saxs_image_format *handler, size_t frame) {
   free(image->image_filename);
   image->image_filename = strdup(filename);
   if (!image->image_filename)
     return -3;
   image->image_format   = handler;
 
-  int res = image->image_format->read(image, filename, 1);
+  /* Frames of whatever was read before. */
+  prefetch_clear(image);
+  frame_cache_trim(image, 0);
+  saxs_image_set_format_state(image, NULL, NULL);
+
+  int res = image->image_format->read(image, filename, frame);
 
   if (res == 0) {
+    image->image_data_modified = 0;
+    image->prefetch_direction  = 1;
+    prefetch_schedule(image);
+
     assert(image->image_data);
     assert(image->image_frame_count > 0);
-    assert(image->image_current_frame == 1);
+    assert(image->image_current_frame == frame);
     assert(image->image_height > 0);
     assert(image->image_width > 0);
   }
   return res;
 }
 
+int
+saxs_image_read(saxs_image *image, const char *filename, const char *format) {
+  return saxs_image_read_at(image, filename, format, 1);
+}
+
+int
+saxs_image_read_at(saxs_image *image, const char *filename,
+                   const char *format, size_t frame) {
+  assert(image);
+  assert(filename);
+  assert(frame >= 1);
+
+  const saxs_image_format* handler = saxs_image_format_find(filename, format);
+  if (!handler)
+    return -1;
+  if (!handler->read)
+    return -2;
+
+  return saxs_image_read_with(image, filename, handler, frame);
+}
+
 int
 saxs_image_write(saxs_image *image, const char *filename, const char *format) {
   assert(image);
@@ -218,18 +487,69 @@ saxs_image_write(saxs_image *image, const char *filename, const char *format) {
   if (!image->image_filename)
     return -3;
   image->image_format   = handler;
+  saxs_image_set_format_state(image, NULL, NULL);
 
   return image->image_format->write(image, filename);
 }
 
+struct write_many_args {
+  saxs_image **images;
+  const char **filenames;
+  const char *format;
+  int *results;
+};
+
+static void
+write_many_one(void *arg, size_t i) {
+  struct write_many_args *args = arg;
+  args->results[i] = saxs_image_write(args->images[i], args->filenames[i],
+                                      args->format);
+}
+
+int
+saxs_image_write_many(saxs_image **images, const char **filenames,
+                      size_t count, const char *format) {
+  struct write_many_args args;
+  size_t i;
+  int res = 0;
+
+  assert(images || count == 0);
+  assert(filenames || count == 0);
+
+  if (count == 0)
+    return 0;
+
+  args.images    = images;
+  args.filenames = filenames;
+  args.format    = format;
+  args.results   = malloc(count * sizeof(int));
+  if (!args.results)
+    return ENOMEM;
+
+  saxs_thread_pool_for(count > 1 ? saxs_thread_pool_default() : NULL,
+                       count, write_many_one, &args);
+
+  for (i = 0; i < count && res == 0; ++i)
+    res = args.results[i];
+
+  free(args.results);
+  return res;
+}
+
 void
 saxs_image_free(saxs_image *image) {
   if (image) {
     if (image->image_filename)
       free(image->image_filename);
 
-    if (image->image_data)
-      free(image->image_data);
+    free_pixels(image->image_data, image->image_mapping,
+                image->image_mapping_size);
+    free(image->image_data_double);
+    free(image->table_sum);
+    free(image->table_count);
+    prefetch_clear(image);
+    frame_cache_trim(image, 0);
+    saxs_image_set_format_state(image, NULL, NULL);
 
     saxs_property_list_free(image->image_properties);
 
@@ -237,6 +557,360 @@ saxs_image_free(saxs_image *image) {
   }
 }
 
+void*
+saxs_image_format_state(saxs_image *image) {
+  return image->format_state;
+}
+
+void
+saxs_image_set_format_state(saxs_image *image, void *state,
+                            void (*free_state)(void*)) {
+  /* Frames prefetched with the state must be done with it. */
+  if (image->format_state)
+    prefetch_clear(image);
+
+  if (image->format_state && image->format_state_free)
+    image->format_state_free(image->format_state);
+
+  image->format_state      = state;
+  image->format_state_free = free_state;
+}
+
+struct saxs_image_request {
+  saxs_thread_job *job;
+
+  char *filename;
+  char *format;
+  const saxs_image_format *handler;
+  void *format_state;
+  size_t frame;
+  saxs_image *image;
+
+  saxs_image_request_callback callback;
+  void *userdata;
+};
+
+static int
+saxs_image_read_async_run(void *arg) {
+  saxs_image_request *request = arg;
+  int res = ENOMEM;
+
+  request->image = saxs_image_create();
+  if (request->image) {
+    if (request->format_state) {
+      /* Borrowed from the image the frame is prefetched for. */
+      request->image->image_format = request->handler;
+      request->image->format_state = request->format_state;
+      res = request->handler->read(request->image, request->filename,
+                                   request->frame);
+
+    } else if (request->handler)
+      res = saxs_image_read_with(request->image, request->filename,
+                                 request->handler, request->frame);
+    else
+      res = saxs_image_read_at(request->image, request->filename,
+                               request->format, request->frame);
+
+    if (res != 0) {
+      saxs_image_free(request->image);
+      request->image = NULL;
+    }
+  }
+
+  return res;
+}
+
+static void
+saxs_image_read_async_complete(void *arg, int status) {
+  saxs_image_request *request = arg;
+
+  if (request->callback)
+    request->callback(request, status, request->userdata);
+}
+
+static void
+saxs_image_read_async_destroy(void *arg) {
+  saxs_image_request *request = arg;
+
+  saxs_image_free(request->image);
+  free(request->filename);
+  free(request->format);
+  free(request);
+}
+
+static saxs_image_request*
+saxs_image_read_async_submit(const char *filename, const char *format,
+                             const saxs_image_format *handler,
+                             void *format_state, size_t frame,
+                             saxs_image_request_callback callback,
+                             void *userdata) {
+  assert(filename);
+
+  saxs_image_request *request = malloc(sizeof(saxs_image_request));
+  if (!request)
+    return NULL;
+
+  request->filename  = strdup(filename);
+  request->format    = format ? strdup(format) : NULL;
+  request->handler   = handler;
+  request->format_state = format_state;
+  request->frame     = frame;
+  request->image     = NULL;
+  request->callback  = callback;
+  request->userdata  = userdata;
+  request->job       = NULL;
+
+  if (!request->filename || (format && !request->format)) {
+    saxs_image_read_async_destroy(request);
+    return NULL;
+  }
+
+  request->job = saxs_thread_job_submit(saxs_thread_pool_default(),
+                                        saxs_image_read_async_run,
+                                        saxs_image_read_async_complete,
+                                        saxs_image_read_async_destroy,
+                                        request);
+  if (!request->job) {
+    saxs_image_read_async_destroy(request);
+    return NULL;
+  }
+
+  return request;
+}
+
+saxs_image_request*
+saxs_image_read_async(const char *filename, const char *format, size_t frame,
+                      saxs_image_request_callback callback, void *userdata) {
+  return saxs_image_read_async_submit(filename, format, NULL, NULL, frame,
+                                      callback, userdata);
+}
+
+/*
+ * Reads another frame of an image with its format handler and state,
+ * if any; the state must be kept until the request is done.
+ */
+static saxs_image_request*
+saxs_image_read_async_with(const char *filename,
+                           const saxs_image_format *handler,
+                           void *format_state, size_t frame) {
+  return saxs_image_read_async_submit(filename, NULL, handler, format_state,
+                                      frame, NULL, NULL);
+}
+
+int
+saxs_image_request_poll(saxs_image_request *request) {
+  return saxs_thread_job_poll(request->job);
+}
+
+int
+saxs_image_request_wait(saxs_image_request *request) {
+  return saxs_thread_job_wait(request->job);
+}
+
+int
+saxs_image_request_cancel(saxs_image_request *request) {
+  return saxs_thread_job_cancel(request->job);
+}
+
+saxs_image*
+saxs_image_request_take(saxs_image_request *request) {
+  saxs_image *image = NULL;
+
+  /* An image read by a request cancelled meanwhile is dropped with it. */
+  if (saxs_thread_job_status(request->job) == 0) {
+    image = request->image;
+    request->image = NULL;
+  }
+
+  return image;
+}
+
+void
+saxs_image_request_free(saxs_image_request *request) {
+  if (request) {
+    saxs_thread_job_cancel(request->job);
+    saxs_thread_job_release(request->job);
+  }
+}
+
+
+/*
+ * Prefetched frames are decoded into images of their own on the
+ * shared thread pool. Their pixels are moved into the frame cache
+ * only from the thread that owns the image, i.e. in the next call to
+ * saxs_image_read_frame(), so the image itself needs no locking.
+ *
+ * Requests share the format state of the image, e.g. the open file,
+ * which the readers serialize access to. Requests dropped while still
+ * decoding are kept until done, the state is replaced or released only
+ * after all requests finished, see saxs_image_set_format_state().
+ */
+static void
+prefetch_remove(struct saxs_image_prefetch **link) {
+  struct saxs_image_prefetch *next = (*link)->next;
+
+  saxs_image_request_free((*link)->request);
+  free(*link);
+  *link = next;
+}
+
+/* Cancels a request no longer needed, keeping it if still decoding. */
+static void
+prefetch_drop(saxs_image *image, struct saxs_image_prefetch **link) {
+  struct saxs_image_prefetch *prefetch = *link;
+
+  saxs_image_request_cancel(prefetch->request);
+  if (saxs_image_request_poll(prefetch->request)) {
+    prefetch_remove(link);
+    return;
+  }
+
+  *link = prefetch->next;
+  prefetch->next = image->prefetch_dropped;
+  image->prefetch_dropped = prefetch;
+}
+
+/* Moves the pixels of a finished request into a detached frame. */
+static struct saxs_image_cached_frame*
+prefetch_result(saxs_image_request *request) {
+  struct saxs_image_cached_frame *entry;
+  saxs_image *decoded;
+
+  decoded = saxs_image_request_take(request);
+  if (!decoded)
+    return NULL;
+
+  entry = malloc(sizeof(struct saxs_image_cached_frame));
+  if (entry)
+    frame_cache_detach(decoded, entry);
+
+  saxs_image_free(decoded);
+  return entry;
+}
+
+static void
+prefetch_clear(saxs_image *image) {
+  while (image->prefetch)
+    prefetch_drop(image, &image->prefetch);
+
+  while (image->prefetch_dropped) {
+    saxs_image_request_wait(image->prefetch_dropped->request);
+    prefetch_remove(&image->prefetch_dropped);
+  }
+}
+
+/* Moves whatever has been decoded so far into the frame cache. */
+static void
+prefetch_harvest(saxs_image *image) {
+  struct saxs_image_prefetch **link = &image->prefetch;
+  struct saxs_image_cached_frame *entry;
+
+  while (*link) {
+    if (!saxs_image_request_poll((*link)->request)) {
+      link = &(*link)->next;
+      continue;
+    }
+
+    entry = prefetch_result((*link)->request);
+    if (entry) {
+      frame_cache_insert(image, entry, 0);
+      free(entry);
+    }
+
+    prefetch_remove(link);
+  }
+
+  for (link = &image->prefetch_dropped; *link; )
+    if (saxs_image_request_poll((*link)->request))
+      prefetch_remove(link);
+    else
+      link = &(*link)->next;
+}
+
+/* Waits for the frame if it is being prefetched. */
+static struct saxs_image_cached_frame*
+prefetch_take(saxs_image *image, size_t frame) {
+  struct saxs_image_prefetch **link;
+  struct saxs_image_cached_frame *entry = NULL;
+
+  for (link = &image->prefetch; *link; link = &(*link)->next)
+    if ((*link)->frame == frame) {
+      if (saxs_image_request_wait((*link)->request) == 0)
+        entry = prefetch_result((*link)->request);
+
+      prefetch_remove(link);
+      break;
+    }
+
+  return entry;
+}
+
+/*
+ * Starts decoding the next prefetch_count frames in the direction of
+ * travel that are neither cached nor pending; drops requests outside
+ * of that window.
+ */
+static void
+prefetch_schedule(saxs_image *image) {
+  struct saxs_image_prefetch **link, *prefetch;
+  const size_t current = image->image_current_frame;
+  const size_t count = image->image_frame_count;
+  size_t i, frame;
+
+  link = &image->prefetch;
+  while (*link) {
+    frame = (*link)->frame;
+    if (image->prefetch_direction > 0
+          ? frame > current && frame <= current + image->prefetch_count
+          : frame < current && frame + image->prefetch_count >= current)
+      link = &(*link)->next;
+    else
+      prefetch_drop(image, link);
+  }
+
+  if (!image->image_format || !image->image_filename)
+    return;
+
+  for (i = 1; i <= image->prefetch_count; ++i) {
+    if (image->prefetch_direction > 0) {
+      if (current + i > count)
+        break;
+      frame = current + i;
+
+    } else {
+      if (current <= i)
+        break;
+      frame = current - i;
+    }
+
+    if (frame_cache_contains(image, frame))
+      continue;
+
+    for (prefetch = image->prefetch; prefetch; prefetch = prefetch->next)
+      if (prefetch->frame == frame)
+        break;
+    if (prefetch)
+      continue;
+
+    prefetch = malloc(sizeof(struct saxs_image_prefetch));
+    if (!prefetch)
+      return;
+
+    prefetch->frame   = frame;
+    prefetch->request = saxs_image_read_async_with(image->image_filename,
+                                                   image->image_format,
+                                                   image->format_state,
+                                                   frame);
+    if (!prefetch->request) {
+      free(prefetch);
+      return;
+    }
+
+    prefetch->next = image->prefetch;
+    image->prefetch = prefetch;
+  }
+}
+
 const char *
 saxs_image_filename(saxs_image *image) {
   return image ? image->image_filename : NULL;
@@ -262,18 +936,134 @@ saxs_image_current_frame(saxs_image *image) {
   return image ? image->image_current_frame : 0;
 }
 
-void
-saxs_image_set_size(saxs_image *image, size_t width, size_t height,
-                    size_t frame_count, size_t current_frame) {
+size_t
+saxs_image_type_size(int type) {
+  switch (type) {
+    case SAXS_IMAGE_TYPE_UINT8:  return sizeof(uint8_t);
+    case SAXS_IMAGE_TYPE_INT16:  return sizeof(int16_t);
+    case SAXS_IMAGE_TYPE_UINT16: return sizeof(uint16_t);
+    case SAXS_IMAGE_TYPE_INT32:  return sizeof(int32_t);
+    case SAXS_IMAGE_TYPE_UINT32: return sizeof(uint32_t);
+    case SAXS_IMAGE_TYPE_FLOAT:  return sizeof(float);
+    case SAXS_IMAGE_TYPE_DOUBLE: return sizeof(double);
+    default:                     return 0;
+  }
+}
 
-  if (image->image_data)
-    free(image->image_data);
+int
+saxs_image_type(saxs_image *image) {
+  return image ? image->image_type : 0;
+}
+
+int
+saxs_image_resize(saxs_image *image, size_t width, size_t height,
+                  size_t frame_count, size_t current_frame, int type) {
+  size_t size = saxs_image_type_size(type);
+  void *data;
+
+  assert(image);
+  if (size == 0)
+    return EINVAL;
+
+  data = calloc(width * height, size);
+  if (!data && width * height > 0)
+    return ENOMEM;
 
+  free_pixels(image->image_data, image->image_mapping,
+              image->image_mapping_size);
+  free(image->image_data_double);
+
+  image->image_mapping       = NULL;
+  image->image_mapping_size  = 0;
+  image->image_topdown       = 0;
+  image->image_width         = width;
+  image->image_height        = height;
+  image->image_frame_count   = frame_count;
+  image->image_current_frame = current_frame;
+  image->image_type          = type;
+  image->image_data          = data;
+  image->image_data_double   = NULL;
+  image->image_data_double_valid = 0;
+  image->image_data_modified = 1;
+  image->cache_valid         = 0;
+  image->table_valid         = 0;
+
+  return 0;
+}
+
+int
+saxs_image_map(saxs_image *image, const char *filename, off_t offset,
+               size_t width, size_t height, size_t frame_count,
+               size_t current_frame, int type, int topdown) {
+#ifdef _WIN32
+  return ENOTSUP;
+#else
+  const size_t size = saxs_image_type_size(type);
+  const off_t page = sysconf(_SC_PAGESIZE);
+  off_t start;
+  size_t length;
+  struct stat st;
+  void *mapping;
+  int fd;
+
+  assert(image);
+  if (size == 0)
+    return EINVAL;
+
+  /* Pixels must be aligned for their type. */
+  if (offset < 0 || offset % size != 0 || width * height == 0)
+    return ENOTSUP;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return errno;
+
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+      || (uintmax_t)st.st_size < (uintmax_t)offset + width * height * size) {
+    close(fd);
+    return ENOTSUP;
+  }
+
+  /*
+   * A private, writable mapping: pages are copied on first write,
+   * modifications never reach the file.
+   */
+  start   = offset - offset % page;
+  length  = (offset - start) + width * height * size;
+  mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, start);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+    return ENOTSUP;
+
+  free_pixels(image->image_data, image->image_mapping,
+              image->image_mapping_size);
+  free(image->image_data_double);
+
+  image->image_mapping       = mapping;
+  image->image_mapping_size  = length;
+  image->image_topdown       = topdown;
   image->image_width         = width;
   image->image_height        = height;
   image->image_frame_count   = frame_count;
   image->image_current_frame = current_frame;
-  image->image_data          = (double*) calloc(width * height, sizeof(double));
+  image->image_type          = type;
+  image->image_data          = (char*)mapping + (offset - start);
+  image->image_data_double   = NULL;
+  image->image_data_double_valid = 0;
+  image->image_data_modified = 1;
+  image->cache_valid         = 0;
+  image->table_valid         = 0;
+
+  return 0;
+#endif
+}
+
+void
+saxs_image_set_size(saxs_image *image, size_t width, size_t height,
+                    size_t frame_count, size_t current_frame) {
+  saxs_image_resize(image, width, height, frame_count, current_frame,
+                    SAXS_IMAGE_TYPE_DOUBLE);
 }
 
 int
@@ -287,13 +1077,112 @@ saxs_image_read_frame(saxs_image *image, size_t frame) {
   if (frame == image->image_current_frame)
     return 0;
 
-  int res = image->image_format->read(image, image->image_filename, frame);
+  struct saxs_image_cached_frame current, *cached;
+  const int modified = image->image_data_modified;
+  int res = 0;
+
+  frame_cache_detach(image, &current);
+
+  prefetch_harvest(image);
+
+  cached = frame_cache_take(image, frame);
+  if (!cached)
+    cached = prefetch_take(image, frame);
+
+  if (cached) {
+    frame_cache_attach(image, cached);
+    free(cached);
+
+  } else {
+    res = image->image_format->read(image, image->image_filename, frame);
+
+    if (res == 0)
+      image->image_data_modified = 0;
+    else {
+      /* Keep the frame we had. */
+      free_pixels(image->image_data, image->image_mapping,
+                  image->image_mapping_size);
+      free(image->image_data_double);
+      image->image_data = NULL;
+      image->image_mapping = NULL;
+      image->image_mapping_size = 0;
+      image->image_data_double = NULL;
+      image->image_data_double_valid = 0;
+      frame_cache_attach(image, &current);
+      image->image_data_modified = modified;
+      return res;
+    }
+  }
+
+  frame_cache_insert(image, &current, modified);
+
+  image->prefetch_direction = frame > current.frame ? 1 : -1;
+  prefetch_schedule(image);
 
   assert(image->image_data);
   assert(frame == image->image_current_frame);
   return res;
 }
 
+int
+saxs_image_refresh(saxs_image *image) {
+  size_t count;
+  int res;
+
+  assert(image);
+
+  if (!image->image_format || !image->image_filename || !image->image_data)
+    return EINVAL;
+  if (!image->image_format->refresh)
+    return ENOTSUP;
+
+  res = image->image_format->refresh(image, &count);
+  if (res == 0 && count != image->image_frame_count) {
+    image->image_frame_count = count;
+    prefetch_schedule(image);
+  }
+
+  return res;
+}
+
+void
+saxs_image_set_prefetch(saxs_image *image, size_t frames) {
+  assert(image);
+
+  image->prefetch_count = frames;
+  prefetch_schedule(image);
+}
+
+size_t
+saxs_image_prefetch(saxs_image *image) {
+  return image ? image->prefetch_count : 0;
+}
+
+void
+saxs_image_set_verify_checksums(saxs_image *image, int verify) {
+  assert(image);
+
+  image->verify_checksums = verify;
+}
+
+int
+saxs_image_verify_checksums(saxs_image *image) {
+  return image ? image->verify_checksums : 0;
+}
+
+void
+saxs_image_set_frame_cache_size(saxs_image *image, size_t bytes) {
+  assert(image);
+
+  image->frame_cache_size = bytes;
+  frame_cache_trim(image, bytes);
+}
+
+size_t
+saxs_image_frame_cache_size(saxs_image *image) {
+  return image ? image->frame_cache_size : 0;
+}
+
 
 double
 saxs_image_value(saxs_image *image, int x, int y) {
@@ -304,7 +1193,13 @@ saxs_image_value(saxs_image *image, int x, int y) {
   assert(y >= 0);
   assert(y < (signed)image->image_height);
 
-  return image->image_data[y * image->image_width + x];
+  const char *row = pixel_row(image, y);
+
+#define GET_VALUE(ctype) return (double)((const ctype*)row)[x]
+  SAXS_IMAGE_SWITCH_TYPE(image->image_type, GET_VALUE)
+#undef GET_VALUE
+
+  return 0.0;
 }
 
 void
@@ -316,18 +1211,625 @@ saxs_image_set_value(saxs_image *image, int x, int y, double value) {
   assert(y >= 0);
   assert(y < (signed)image->image_height);
 
-  image->image_data[y * image->image_width + x] = value;
+  char *row = pixel_row(image, y);
+
+#define SET_VALUE(ctype) ((ctype*)row)[x] = (ctype)value
+  SAXS_IMAGE_SWITCH_TYPE(image->image_type, SET_VALUE)
+#undef SET_VALUE
 
   if (image->cache_valid)
     image->cache_valid = 0;
+  if (image->table_valid)
+    image->table_valid = 0;
+  if (image->image_data_double_valid)
+    image->image_data_double_valid = 0;
+  image->image_data_modified = 1;
+}
+
+const void*
+saxs_image_pixels(saxs_image *image) {
+  if (image && image->image_topdown) {
+    const size_t size = saxs_image_type_size(image->image_type);
+    char *data = malloc(image->image_width * image->image_height * size);
+
+    if (!data)
+      return NULL;
+
+    saxs_image_convert_block(pixel_row(image, 0), image->image_type, size,
+                             saxs_image_row_stride(image),
+                             data, image->image_type, image->image_width * size,
+                             image->image_width, image->image_height);
+
+    free_pixels(image->image_data, image->image_mapping,
+                image->image_mapping_size);
+    image->image_data         = data;
+    image->image_mapping      = NULL;
+    image->image_mapping_size = 0;
+    image->image_topdown      = 0;
+  }
+
+  return image ? image->image_data : NULL;
+}
+
+ptrdiff_t
+saxs_image_row_stride(saxs_image *image) {
+  const ptrdiff_t rowsize = image->image_width
+                              * saxs_image_type_size(image->image_type);
+
+  return image->image_topdown ? -rowsize : rowsize;
+}
+
+const void*
+saxs_image_row(saxs_image *image, size_t y) {
+  assert(image != NULL);
+  assert(image->image_data != NULL);
+  assert(y < image->image_height);
+
+  return pixel_row(image, y);
+}
+
+void*
+saxs_image_row_data(saxs_image *image, size_t y) {
+  return (void*)saxs_image_row(image, y);
+}
+
+void
+saxs_image_modified(saxs_image *image) {
+  image->cache_valid = 0;
+  image->table_valid = 0;
+  image->image_data_double_valid = 0;
+  image->image_data_modified = 1;
+}
+
+int
+saxs_image_get_row(saxs_image *image, size_t y, void *values, int type) {
+  assert(image != NULL);
+  assert(values != NULL);
+
+  if (!image->image_data || y >= image->image_height
+      || saxs_image_type_size(type) == 0)
+    return EINVAL;
+
+  saxs_image_convert_pixels(saxs_image_row(image, y), image->image_type,
+                            values, type, image->image_width);
+  return 0;
+}
+
+int
+saxs_image_set_row(saxs_image *image, size_t y, const void *values, int type) {
+  assert(image != NULL);
+  assert(values != NULL);
+
+  if (!image->image_data || y >= image->image_height
+      || saxs_image_type_size(type) == 0)
+    return EINVAL;
+
+  saxs_image_convert_pixels(values, type,
+                            (void*)saxs_image_row(image, y), image->image_type,
+                            image->image_width);
+
+  image->cache_valid = 0;
+  image->table_valid = 0;
+  image->image_data_double_valid = 0;
+  image->image_data_modified = 1;
+  return 0;
+}
+
+int
+saxs_image_set_data(saxs_image *image, const void *values, int type) {
+  return saxs_image_set_pixels(image, values, type, 0);
+}
+
+int
+saxs_image_set_pixels(saxs_image *image, const void *values, int type,
+                      int layout) {
+  const size_t size = saxs_image_type_size(type);
+  const char *from = values;
+  ptrdiff_t xstride, ystride;
+
+  assert(image != NULL);
+  assert(values != NULL);
+
+  if (!image->image_data || size == 0)
+    return EINVAL;
+
+  if (layout & SAXS_IMAGE_LAYOUT_TRANSPOSED) {
+    xstride = image->image_height * size;
+    ystride = size;
+  } else {
+    xstride = size;
+    ystride = image->image_width * size;
+  }
+
+  /* Start at the bottom row and walk up. */
+  if ((layout & SAXS_IMAGE_LAYOUT_TOPDOWN) && image->image_height > 0) {
+    from   += (ptrdiff_t)(image->image_height - 1) * ystride;
+    ystride = -ystride;
+  }
+
+  saxs_image_convert_block(from, type, xstride, ystride,
+                           pixel_row(image, 0), image->image_type,
+                           saxs_image_row_stride(image),
+                           image->image_width, image->image_height);
+
+  image->cache_valid = 0;
+  image->table_valid = 0;
+  image->image_data_double_valid = 0;
+  image->image_data_modified = 1;
+  return 0;
+}
+
+const double*
+saxs_image_data(saxs_image *image) {
+  const size_t n = saxs_image_width(image) * saxs_image_height(image);
+
+  if (!image || !image->image_data)
+    return NULL;
+
+  if (image->image_type == SAXS_IMAGE_TYPE_DOUBLE && !image->image_topdown)
+    return image->image_data;
+
+  if (!image->image_data_double_valid) {
+    if (!image->image_data_double) {
+      image->image_data_double = malloc((n ? n : 1) * sizeof(double));
+      if (!image->image_data_double)
+        return NULL;
+    }
+
+    saxs_image_convert_block(pixel_row(image, 0), image->image_type,
+                             saxs_image_type_size(image->image_type),
+                             saxs_image_row_stride(image),
+                             image->image_data_double, SAXS_IMAGE_TYPE_DOUBLE,
+                             image->image_width * sizeof(double),
+                             image->image_width, image->image_height);
+    image->image_data_double_valid = 1;
+  }
+
+  return image->image_data_double;
+}
+
+int
+saxs_image_convert(saxs_image *image, int type) {
+  const size_t n = saxs_image_width(image) * saxs_image_height(image);
+  size_t size = saxs_image_type_size(type);
+  void *data;
+
+  assert(image);
+  if (size == 0)
+    return EINVAL;
+
+  if (type == image->image_type)
+    return 0;
+
+  if (image->image_data) {
+    data = malloc((n ? n : 1) * size);
+    if (!data)
+      return ENOMEM;
+
+    /* Keeps the order of rows in memory. */
+    saxs_image_convert_pixels(image->image_data, image->image_type,
+                              data, type, n);
+    free_pixels(image->image_data, image->image_mapping,
+                image->image_mapping_size);
+    image->image_data = data;
+    image->image_mapping = NULL;
+    image->image_mapping_size = 0;
+  }
+
+  free(image->image_data_double);
+  image->image_data_double = NULL;
+  image->image_data_double_valid = 0;
+  image->image_type = type;
+  image->image_data_modified = 1;
+  image->cache_valid = 0;
+  image->table_valid = 0;
+
+  return 0;
 }
 
 
+/*
+ * Statistics are computed over blocks of rows, in parallel for large
+ * images. Each row is scanned twice while it is in cache: a branch-free
+ * min/max on the native pixels that the compiler can vectorise, then
+ * the valid pixel count, sum and histogram.
+ */
+#define STATS_BLOCK_ROWS   64
+#define STATS_PARALLEL_MIN (1 << 20)
+
+struct stats_block_args {
+  saxs_image *image, *mask;
+  size_t rows;
+  saxs_image_stats *blocks;
+  uint8_t *masked;           /* a row of the mask per block */
+};
+
+static void
+stats_clear(saxs_image_stats *stats) {
+  memset(stats, 0, sizeof(saxs_image_stats));
+  stats->min = HUGE_VAL;
+  stats->max = -HUGE_VAL;
+}
+
+static void
+stats_merge(saxs_image_stats *stats, const saxs_image_stats *other) {
+  int i;
+
+  if (stats->min > other->min)
+    stats->min = other->min;
+  if (stats->max < other->max)
+    stats->max = other->max;
+
+  stats->sum   += other->sum;
+  stats->valid += other->valid;
+  for (i = 0; i < SAXS_IMAGE_HISTOGRAM_BINS; ++i)
+    stats->histogram[i] += other->histogram[i];
+}
+
+/* The histogram bin of a valid, i.e. finite and non-negative, value. */
+static int
+stats_bin(double value) {
+  union { double d; uint64_t u; } bits;
+  int exponent;
+
+  bits.d = value;
+  exponent = (int)((bits.u >> 52) & 0x7ff) - 1022;
+
+  if (exponent <= 0)
+    return 0;
+  return exponent < SAXS_IMAGE_HISTOGRAM_BINS ? exponent
+                                              : SAXS_IMAGE_HISTOGRAM_BINS - 1;
+}
+
+/* As stats_bin(), for integers. */
+static int
+stats_bin_int(uint64_t value) {
+#ifdef __GNUC__
+  return value ? 64 - __builtin_clzll(value) : 0;
+#else
+  return stats_bin((double)value);
+#endif
+}
+
+/*
+ * The integer branches are resolved at compile time. Integer pixels
+ * are compared in their native type, floating point ones as double
+ * where NaN compares false and never replaces rmin or rmax.
+ */
+#define STATS_IS_INTEGER(ctype) ((ctype)0.5 == 0)
+
+#define STATS_MINMAX(ctype)                                   \
+  do {                                                        \
+    const ctype *p = (const ctype*)row;                       \
+    if (STATS_IS_INTEGER(ctype)) {                            \
+      ctype mn = p[0], mx = p[0];                             \
+      for (x = 1; x < width; ++x) {                           \
+        mn = p[x] < mn ? p[x] : mn;                           \
+        mx = p[x] > mx ? p[x] : mx;                           \
+      }                                                       \
+      rmin = mn;                                              \
+      rmax = mx;                                              \
+                                                              \
+    } else {                                                  \
+      for (x = 0; x < width; ++x) {                           \
+        const double v = p[x];                                \
+        rmin = v < rmin ? v : rmin;                           \
+        rmax = v > rmax ? v : rmax;                           \
+      }                                                       \
+    }                                                         \
+  } while (0)
+
+/*
+ * Unsigned pixels are all valid unless masked, only signed ones are
+ * compared against zero; the caller dispatches on the signedness.
+ */
+#define STATS_NONNEGATIVE(v) ((v) >= 0)
+#define STATS_ANY(v)         1
+
+#define STATS_VALID_INT(ctype, NONNEGATIVE)                   \
+  do {                                                        \
+    const ctype *p = (const ctype*)row;                       \
+    uint64_t isum = 0;                                        \
+    for (x = 0; x < width; ++x)                               \
+      if (NONNEGATIVE(p[x]) && !(masked && masked[x])) {      \
+        const uint64_t v = (uint64_t)p[x];                    \
+        isum += v;                                            \
+        valid += 1;                                           \
+        histogram[stats_bin_int(v)] += 1;                     \
+      }                                                       \
+    sum = (double)isum;                                       \
+  } while (0)
+
+#define STATS_VALID_FLOAT(ctype)                              \
+  do {                                                        \
+    const ctype *p = (const ctype*)row;                       \
+    for (x = 0; x < width; ++x) {                             \
+      const double v = p[x];                                  \
+      if (v >= 0.0 && v <= DBL_MAX && !(masked && masked[x])) { \
+        sum += v;                                             \
+        valid += 1;                                           \
+        histogram[stats_bin(v)] += 1;                         \
+      }                                                       \
+    }                                                         \
+  } while (0)
+
+static void
+stats_block(void *arg, size_t index) {
+  struct stats_block_args *args = arg;
+  saxs_image *image = args->image;
+  saxs_image_stats *stats = &args->blocks[index];
+  const size_t width = image->image_width;
+  const size_t y0 = index * args->rows;
+  const size_t y1 = y0 + args->rows < image->image_height
+                      ? y0 + args->rows : image->image_height;
+  uint8_t *masked = args->masked ? args->masked + index * width : NULL;
+  size_t histogram[SAXS_IMAGE_HISTOGRAM_BINS] = { 0 };
+  size_t x, y;
+
+  stats_clear(stats);
+
+  for (y = y0; y < y1; ++y) {
+    const void *row = saxs_image_row(image, y);
+    double rmin = HUGE_VAL, rmax = -HUGE_VAL, sum = 0.0;
+    size_t valid = 0;
+
+    SAXS_IMAGE_SWITCH_TYPE(image->image_type, STATS_MINMAX)
+
+    if (stats->min > rmin)
+      stats->min = rmin;
+    if (stats->max < rmax)
+      stats->max = rmax;
+
+    if (masked)
+      saxs_image_get_row(args->mask, y, masked, SAXS_IMAGE_TYPE_UINT8);
+
+    switch (image->image_type) {
+      case SAXS_IMAGE_TYPE_UINT8:  STATS_VALID_INT(uint8_t, STATS_ANY);          break;
+      case SAXS_IMAGE_TYPE_INT16:  STATS_VALID_INT(int16_t, STATS_NONNEGATIVE);  break;
+      case SAXS_IMAGE_TYPE_UINT16: STATS_VALID_INT(uint16_t, STATS_ANY);         break;
+      case SAXS_IMAGE_TYPE_INT32:  STATS_VALID_INT(int32_t, STATS_NONNEGATIVE);  break;
+      case SAXS_IMAGE_TYPE_UINT32: STATS_VALID_INT(uint32_t, STATS_ANY);         break;
+      case SAXS_IMAGE_TYPE_FLOAT:  STATS_VALID_FLOAT(float);                     break;
+      case SAXS_IMAGE_TYPE_DOUBLE: STATS_VALID_FLOAT(double);                    break;
+    }
+
+    stats->sum   += sum;
+    stats->valid += valid;
+  }
+
+  memcpy(stats->histogram, histogram, sizeof(histogram));
+}
+
+#undef STATS_IS_INTEGER
+#undef STATS_MINMAX
+#undef STATS_NONNEGATIVE
+#undef STATS_ANY
+#undef STATS_VALID_INT
+#undef STATS_VALID_FLOAT
+
+int
+saxs_image_statistics(saxs_image *image, saxs_image *mask,
+                      saxs_image_stats *stats) {
+  struct stats_block_args args;
+  size_t i, nblocks;
+
+  assert(image != NULL);
+  assert(stats != NULL);
+
+  if (!mask && image->cache_valid) {
+    *stats = image->cache_stats;
+    return 0;
+  }
+
+  if (mask && (mask->image_width != image->image_width
+               || mask->image_height != image->image_height))
+    return EINVAL;
+
+  stats_clear(stats);
+
+  if (image->image_data && image->image_width > 0) {
+    args.image  = image;
+    args.mask   = mask;
+    args.rows   = STATS_BLOCK_ROWS;
+    nblocks     = (image->image_height + args.rows - 1) / args.rows;
+    args.blocks = malloc(nblocks * sizeof(saxs_image_stats));
+    args.masked = mask ? malloc(nblocks * image->image_width) : NULL;
+    if (!args.blocks || (mask && !args.masked)) {
+      free(args.blocks);
+      free(args.masked);
+      return ENOMEM;
+    }
+
+    if (image->image_width * image->image_height >= STATS_PARALLEL_MIN)
+      saxs_thread_pool_for(saxs_thread_pool_default(), nblocks,
+                           stats_block, &args);
+    else
+      saxs_thread_pool_for(NULL, nblocks, stats_block, &args);
+
+    for (i = 0; i < nblocks; ++i)
+      stats_merge(stats, &args.blocks[i]);
+
+    free(args.blocks);
+    free(args.masked);
+  }
+
+  /* An empty image, or all NaN. */
+  if (stats->min > stats->max)
+    stats->min = stats->max = 0.0;
+
+  if (!mask) {
+    image->cache_stats = *stats;
+    image->cache_valid = 1;
+  }
+
+  return 0;
+}
+
+/*
+ * Summed-area tables are built in two passes that both run in
+ * parallel for large frames: prefix sums along each row, by blocks
+ * of rows, then down each column, by strips of columns.
+ */
+#define TABLE_BLOCK_ROWS    64
+#define TABLE_STRIP_COLUMNS 512
+
+#define TABLE_ROW(ctype)                                      \
+  do {                                                        \
+    const ctype *p = (const ctype*)row;                       \
+    for (x = 0; x < width; ++x) {                             \
+      const double v = p[x];                                  \
+      if (v >= 0.0 && v <= DBL_MAX) {                         \
+        sum += v;                                             \
+        count += 1;                                           \
+      }                                                       \
+      sums[x + 1]   = sum;                                    \
+      counts[x + 1] = count;                                  \
+    }                                                         \
+  } while (0)
+
+static void
+table_rows(void *arg, size_t index) {
+  saxs_image *image = arg;
+  const size_t width = image->image_width;
+  const size_t y0 = index * TABLE_BLOCK_ROWS;
+  const size_t y1 = y0 + TABLE_BLOCK_ROWS < image->image_height
+                      ? y0 + TABLE_BLOCK_ROWS : image->image_height;
+  size_t x, y;
+
+  for (y = y0; y < y1; ++y) {
+    const void *row = saxs_image_row(image, y);
+    double *sums = image->table_sum + (y + 1) * (width + 1);
+    uint32_t *counts = image->table_count + (y + 1) * (width + 1);
+    double sum = 0.0;
+    uint32_t count = 0;
+
+    sums[0]   = 0.0;
+    counts[0] = 0;
+    SAXS_IMAGE_SWITCH_TYPE(image->image_type, TABLE_ROW)
+  }
+}
+
+#undef TABLE_ROW
+
+static void
+table_columns(void *arg, size_t index) {
+  saxs_image *image = arg;
+  const size_t stride = image->image_width + 1;
+  const size_t x0 = index * TABLE_STRIP_COLUMNS;
+  const size_t x1 = x0 + TABLE_STRIP_COLUMNS < stride
+                      ? x0 + TABLE_STRIP_COLUMNS : stride;
+  size_t x, y;
+
+  for (y = 2; y <= image->image_height; ++y) {
+    double *sums = image->table_sum + y * stride;
+    uint32_t *counts = image->table_count + y * stride;
+
+    for (x = x0; x < x1; ++x) {
+      sums[x]   += sums[x - stride];
+      counts[x] += counts[x - stride];
+    }
+  }
+}
+
+static int
+table_update(saxs_image *image) {
+  const size_t width = image->image_width, height = image->image_height;
+  const size_t n = (width + 1) * (height + 1);
+  saxs_thread_pool *pool = NULL;
+  double *sums;
+  uint32_t *counts;
+
+  if (image->table_valid)
+    return 0;
+
+  if (!image->image_data || width * height > UINT32_MAX)
+    return ENOMEM;
+
+  sums = realloc(image->table_sum, n * sizeof(double));
+  if (sums)
+    image->table_sum = sums;
+  counts = realloc(image->table_count, n * sizeof(uint32_t));
+  if (counts)
+    image->table_count = counts;
+  if (!sums || !counts)
+    return ENOMEM;
+
+  memset(sums, 0, (width + 1) * sizeof(double));
+  memset(counts, 0, (width + 1) * sizeof(uint32_t));
+
+  if (width * height >= STATS_PARALLEL_MIN)
+    pool = saxs_thread_pool_default();
+
+  saxs_thread_pool_for(pool, (height + TABLE_BLOCK_ROWS - 1) / TABLE_BLOCK_ROWS,
+                       table_rows, image);
+  saxs_thread_pool_for(pool, (width + TABLE_STRIP_COLUMNS) / TABLE_STRIP_COLUMNS,
+                       table_columns, image);
+
+  image->table_valid = 1;
+  return 0;
+}
+
+int
+saxs_image_roi_sum(saxs_image *image, size_t x, size_t y,
+                   size_t width, size_t height,
+                   double *sum, size_t *valid) {
+  size_t stride, x1, y1;
+  int res;
+
+  assert(image != NULL);
+
+  if (x > image->image_width || width > image->image_width - x
+      || y > image->image_height || height > image->image_height - y)
+    return EINVAL;
+
+  if ((res = table_update(image)) != 0)
+    return res;
+
+  /*
+   * The sum over a rectangle from the table entries at its corners:
+   * everything below and left of the top right corner, minus what is
+   * left of and below the rectangle, plus what was subtracted twice.
+   */
+  stride = image->image_width + 1;
+  x1 = x + width;
+  y1 = y + height;
+
+  if (sum)
+    *sum = image->table_sum[y1 * stride + x1] - image->table_sum[y * stride + x1]
+           - image->table_sum[y1 * stride + x] + image->table_sum[y * stride + x];
+  if (valid)
+    *valid = image->table_count[y1 * stride + x1] - image->table_count[y * stride + x1]
+             - image->table_count[y1 * stride + x] + image->table_count[y * stride + x];
+
+  return 0;
+}
+
+double
+saxs_image_roi_mean(saxs_image *image, size_t x, size_t y,
+                    size_t width, size_t height) {
+  double sum;
+  size_t valid;
+
+  if (saxs_image_roi_sum(image, x, y, width, height, &sum, &valid) != 0
+      || valid == 0)
+    return NAN;
+
+  return sum / valid;
+}
+
+static void
+saxs_image_update_cache(saxs_image *image) {
+  saxs_image_stats stats;
+
+  if (image && !image->cache_valid)
+    saxs_image_statistics(image, NULL, &stats);
+}
+
 double
 saxs_image_value_min(saxs_image *image) {
   if (image) {
     saxs_image_update_cache(image);
-    return image->cache_min_value;
+    return image->cache_stats.min;
 
   } else
     return 0.0;
@@ -337,7 +1839,7 @@ double
 saxs_image_value_max(saxs_image *image) {
   if (image) {
     saxs_image_update_cache(image);
-    return image->cache_max_value;
+    return image->cache_stats.max;
 
   } else
     return 0.0;
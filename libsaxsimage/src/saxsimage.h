@@ -28,6 +28,7 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
 #include <sys/types.h>
 
 /*
@@ -46,11 +47,32 @@ extern "C" {
 #endif
 
 
+/*
+ * Types of pixels; images keep their pixels in the type found in the
+ * file, e.g. PILATUS images in 32bit integers, masks in bytes.
+ */
+enum {
+  SAXS_IMAGE_TYPE_UINT8 = 1,
+  SAXS_IMAGE_TYPE_INT16,
+  SAXS_IMAGE_TYPE_UINT16,
+  SAXS_IMAGE_TYPE_INT32,
+  SAXS_IMAGE_TYPE_UINT32,
+  SAXS_IMAGE_TYPE_FLOAT,
+  SAXS_IMAGE_TYPE_DOUBLE
+};
+
 struct saxs_property;
+struct saxs_curve;
 
 struct saxs_image;
 typedef struct saxs_image saxs_image;
 
+struct saxs_image_request;
+typedef struct saxs_image_request saxs_image_request;
+
+typedef void (*saxs_image_request_callback)(saxs_image_request *request,
+                                            int status, void *userdata);
+
 saxs_image*
 saxs_image_create();
 
@@ -60,15 +82,108 @@ saxs_image_copy(saxs_image* image);
 int
 saxs_image_read(saxs_image *image, const char *filename, const char *format);
 
+/*
+ * Like saxs_image_read(), but decodes the given (1-based) frame right
+ * away instead of the first one.
+ */
+int
+saxs_image_read_at(saxs_image *image, const char *filename,
+                   const char *format, size_t frame);
+
 int
 saxs_image_read_frame(saxs_image *image, size_t frameid);
 
+/*
+ * Checks the file the image was read from for frames added since,
+ * e.g. by a detector still writing, and updates the frame count. This
+ * is cheap enough to be polled. Returns 0 on success, ENOTSUP if the
+ * format or file does not support growing while being read, EINVAL if
+ * the image was not read from a file, or another errno.
+ */
+int
+saxs_image_refresh(saxs_image *image);
+
+/*
+ * Frames left by saxs_image_read_frame() are kept decoded, unless
+ * modified, so that going back to them does not read the file again.
+ * Least recently used frames are dropped once the cached pixels exceed
+ * the given number of bytes; 0 disables the cache.
+ */
+#define SAXS_IMAGE_FRAME_CACHE_SIZE (256 * 1024 * 1024)
+
+void
+saxs_image_set_frame_cache_size(saxs_image *image, size_t bytes);
+
+size_t
+saxs_image_frame_cache_size(saxs_image *image) SAXSIMAGE_PURE;
+
+/*
+ * Speculatively decodes up to the given number of frames following
+ * the current one on background threads, or preceding it if the last
+ * saxs_image_read_frame() went backwards. Decoded frames go into the
+ * frame cache; a frame still being decoded when requested is waited
+ * for. Defaults to 0, i.e. no prefetching.
+ */
+void
+saxs_image_set_prefetch(saxs_image *image, size_t frames);
+
+size_t
+saxs_image_prefetch(saxs_image *image) SAXSIMAGE_PURE;
+
+/*
+ * Whether reading checks the checksums stored along with the pixels,
+ * e.g. the MD5 digests of CBF files, and fails on a mismatch. This
+ * takes about as long as decoding; defaults to 0, i.e. not checked.
+ */
+void
+saxs_image_set_verify_checksums(saxs_image *image, int verify);
+
+int
+saxs_image_verify_checksums(saxs_image *image) SAXSIMAGE_PURE;
+
 int
 saxs_image_write(saxs_image *image, const char *filename, const char *format);
 
+/*
+ * Writes each of count images to the file of the same index, several
+ * at a time on the thread pool. Returns 0 if all were written, else
+ * the result of the first that failed; the others are written anyway.
+ */
+int
+saxs_image_write_many(saxs_image **images, const char **filenames,
+                      size_t count, const char *format);
+
 void
 saxs_image_free(saxs_image *image);
 
+/*
+ * Asynchronous reading, see saxs_document_read_async() for details.
+ * The image is read and the requested frame selected on a worker thread,
+ * the callback is run there as well. Pending requests are cancelled
+ * on free, an image not taken is free'd with the request.
+ */
+saxs_image_request*
+saxs_image_read_async(const char *filename, const char *format, size_t frame,
+                      saxs_image_request_callback callback, void *userdata);
+
+int
+saxs_image_request_poll(saxs_image_request *request);
+
+int
+saxs_image_request_wait(saxs_image_request *request);
+
+int
+saxs_image_request_cancel(saxs_image_request *request);
+
+saxs_image*
+saxs_image_request_take(saxs_image_request *request);
+
+void
+saxs_image_request_free(saxs_image_request *request);
+
+const char*
+saxs_image_filename(saxs_image *image) SAXSIMAGE_PURE;
+
 size_t
 saxs_image_width(saxs_image *image) SAXSIMAGE_PURE;
 
@@ -81,11 +196,38 @@ saxs_image_frame_count(saxs_image *image) SAXSIMAGE_PURE;
 int
 saxs_image_current_frame(saxs_image *image) SAXSIMAGE_PURE;
 
+/*
+ * Sets the size and allocates zero-initialised pixels of type double.
+ */
 void
 saxs_image_set_size(saxs_image *image,
                     size_t width, size_t height,
                     size_t frame_count, size_t current_frame);
 
+/*
+ * As saxs_image_set_size(), but with pixels of the given type.
+ * Returns 0 on success, EINVAL for an unknown type or ENOMEM.
+ */
+int
+saxs_image_resize(saxs_image *image,
+                  size_t width, size_t height,
+                  size_t frame_count, size_t current_frame, int type);
+
+int
+saxs_image_type(saxs_image *image) SAXSIMAGE_PURE;
+
+/* The size of a pixel of the given type in bytes, 0 if unknown. */
+size_t
+saxs_image_type_size(int type);
+
+/*
+ * Converts the pixels to another type in place. Values that do not
+ * fit into the new type are undefined. Returns 0 on success, EINVAL
+ * for an unknown type or ENOMEM.
+ */
+int
+saxs_image_convert(saxs_image *image, int type);
+
 
 /**
  * Filters out values below 0.
@@ -96,12 +238,281 @@ saxs_image_value(saxs_image *image, int x, int y) SAXSIMAGE_PURE;
 void
 saxs_image_set_value(saxs_image *image, int x, int y, double value);
 
+/*
+ * The pixels of the current frame in their native type, row-major,
+ * width * height values; valid until the next frame is read.
+ *
+ * Uncompressed files may be mapped into memory rather than read,
+ * with rows in the order of the file. This makes a contiguous copy
+ * first; prefer saxs_image_row() and saxs_image_row_stride().
+ */
+const void*
+saxs_image_pixels(saxs_image *image);
+
+/*
+ * Row y of the pixels in their native type, width values.
+ *
+ * If the pixels are mapped from a file, they are private to the
+ * image, but the file must not be truncated while mapped.
+ */
+const void*
+saxs_image_row(saxs_image *image, size_t y) SAXSIMAGE_PURE;
+
+/*
+ * Distance in bytes from row y to row y + 1, negative if the rows
+ * are stored top to bottom.
+ */
+ptrdiff_t
+saxs_image_row_stride(saxs_image *image) SAXSIMAGE_PURE;
+
+/*
+ * Bulk access, preferable over saxs_image_value() and
+ * saxs_image_set_value() for anything but single pixels.
+ *
+ * Copies the width values of row y to or from a buffer of the given
+ * type, converting as needed; saxs_image_set_data() copies all
+ * width * height values. Return 0 on success, EINVAL if y is out
+ * of range, the type unknown or the image is empty.
+ */
+int
+saxs_image_get_row(saxs_image *image, size_t y, void *values, int type);
+
+int
+saxs_image_set_row(saxs_image *image, size_t y, const void *values, int type);
+
+int
+saxs_image_set_data(saxs_image *image, const void *values, int type);
+
+/*
+ * As saxs_image_pixels(), but converted to double. Unless the pixels
+ * are of type double already, the conversion is done on first access
+ * and kept until the image is modified. Returns NULL if out of memory.
+ */
+const double*
+saxs_image_data(saxs_image *image);
+
 double
 saxs_image_value_min(saxs_image *image);
 
 double
 saxs_image_value_max(saxs_image *image);
 
+/*
+ * Histogram bin 0 counts valid pixels in [0, 1), bin k > 0 those in
+ * [2^(k-1), 2^k); the last bin also takes everything above.
+ */
+#define SAXS_IMAGE_HISTOGRAM_BINS 64
+
+typedef struct saxs_image_stats {
+  double min, max;       /* over all pixels but NaN */
+  double sum;            /* over valid pixels */
+  size_t valid;          /* finite, non-negative and not masked */
+  size_t histogram[SAXS_IMAGE_HISTOGRAM_BINS];
+} saxs_image_stats;
+
+/*
+ * Statistics of the current frame, computed in a single pass that
+ * runs in parallel for large frames. Pixels where the optional mask
+ * is non-zero are not valid. Results without mask are cached until
+ * the image is modified, and also give saxs_image_value_min() and
+ * saxs_image_value_max().
+ *
+ * Returns 0 on success, EINVAL if the mask is of different size,
+ * ENOMEM if out of memory.
+ */
+int
+saxs_image_statistics(saxs_image *image, saxs_image *mask,
+                      saxs_image_stats *stats);
+
+/*
+ * Sum and number of the valid, i.e. finite and non-negative, pixels
+ * in the rectangle of width x height pixels whose lower left pixel is
+ * (x, y). The first call after the frame was read or modified builds
+ * summed-area tables of the frame, afterwards any rectangle takes the
+ * same constant time. Either of sum or valid may be NULL.
+ *
+ * Returns 0 on success, EINVAL if the rectangle is not within the
+ * frame, ENOMEM if out of memory.
+ */
+int
+saxs_image_roi_sum(saxs_image *image, size_t x, size_t y,
+                   size_t width, size_t height,
+                   double *sum, size_t *valid);
+
+/* The mean of the valid pixels, NaN if there are none. */
+double
+saxs_image_roi_mean(saxs_image *image, size_t x, size_t y,
+                    size_t width, size_t height);
+
+
+/*
+ * Frame arithmetic. Operands must be of the same size; pixels where
+ * the optional mask is non-zero are left as they are. Large frames
+ * are processed in parallel. Integer images are converted to double
+ * first so that fractions are kept.
+ *
+ * saxs_image_add() adds factor * other to the image, e.g. -1.0 to
+ * subtract a background; saxs_image_subtract() is a shorthand.
+ * saxs_image_scale() multiplies the image by factor.
+ *
+ * Return 0 on success, EINVAL if sizes differ, ENOMEM if out of memory.
+ */
+int
+saxs_image_add(saxs_image *image, saxs_image *other, double factor,
+               saxs_image *mask);
+
+int
+saxs_image_subtract(saxs_image *image, saxs_image *other, saxs_image *mask);
+
+int
+saxs_image_scale(saxs_image *image, double factor, saxs_image *mask);
+
+/*
+ * Mean and median over count frames of the same size, written to
+ * result as a single frame of type double. Masked pixels are 0, the
+ * median ignores NaN. saxs_image_median_frames() takes frames first
+ * to first + count - 1 of a multi-frame image, e.g. an HDF5 stack,
+ * and holds all of them in memory while computing.
+ */
+int
+saxs_image_mean(saxs_image *result, saxs_image **images, size_t count,
+                saxs_image *mask);
+
+int
+saxs_image_median(saxs_image *result, saxs_image **images, size_t count,
+                  saxs_image *mask);
+
+int
+saxs_image_median_frames(saxs_image *result, saxs_image *image,
+                         size_t first, size_t count, saxs_image *mask);
+
+/*
+ * A running sum of frames in double precision, for averaging series
+ * without keeping them. Masked pixels are not accumulated. The mask,
+ * if any, must be of the given size and is referenced, not copied.
+ * Returns NULL if out of memory or the mask is of different size.
+ */
+typedef struct saxs_image_accumulator saxs_image_accumulator;
+
+saxs_image_accumulator*
+saxs_image_accumulator_create(size_t width, size_t height, saxs_image *mask);
+
+void
+saxs_image_accumulator_free(saxs_image_accumulator *acc);
+
+/*
+ * Adds factor times the current frame of the image; returns EINVAL if
+ * the image is of different size.
+ */
+int
+saxs_image_accumulator_add(saxs_image_accumulator *acc, saxs_image *image,
+                           double factor);
+
+/*
+ * Reads frames first to first + count - 1 of the image, see
+ * saxs_image_read_frame(), and adds each of them.
+ */
+int
+saxs_image_accumulator_add_frames(saxs_image_accumulator *acc,
+                                  saxs_image *image,
+                                  size_t first, size_t count);
+
+size_t
+saxs_image_accumulator_count(saxs_image_accumulator *acc);
+
+/*
+ * The sum, or the sum divided by the number of frames added, as a
+ * single frame of type double; the mean of no frames is EINVAL.
+ */
+int
+saxs_image_accumulator_sum(saxs_image_accumulator *acc, saxs_image *result);
+
+int
+saxs_image_accumulator_mean(saxs_image_accumulator *acc, saxs_image *result);
+
+
+/*
+ * Azimuthal integration of frames into curves of the mean intensity
+ * per pixel over q = 4 pi sin(theta) / wavelength.
+ *
+ * The beam centre is given in pixels, in the coordinates of
+ * saxs_image_value(). The distance and pixel sizes are in the same
+ * unit, e.g. mm; q is in units of 1/wavelength. No solid angle or
+ * polarisation corrections are applied.
+ */
+typedef struct saxs_image_geometry {
+  double center_x, center_y;
+  double distance;
+  double pixel_size_x, pixel_size_y;
+  double wavelength;
+} saxs_image_geometry;
+
+typedef struct saxs_image_integrator saxs_image_integrator;
+
+/*
+ * Assigns each pixel of a width * height frame, but those where the
+ * optional mask is non-zero, to one of bins equally wide q bins over
+ * the range covered. The assignment is computed once and reused for
+ * every frame integrated. Returns NULL if out of memory or arguments
+ * are invalid.
+ */
+saxs_image_integrator*
+saxs_image_integrator_create(size_t width, size_t height,
+                             const saxs_image_geometry *geometry,
+                             size_t bins, saxs_image *mask);
+
+void
+saxs_image_integrator_free(saxs_image_integrator *integrator);
+
+size_t
+saxs_image_integrator_bins(saxs_image_integrator *integrator) SAXSIMAGE_PURE;
+
+/*
+ * Writes the tables of an integrator to a file that other processes,
+ * on this or similar machines, can map instead of computing the tables
+ * again. The file is replaced atomically. Returns 0 on success, an
+ * errno value otherwise.
+ */
+int
+saxs_image_integrator_save(saxs_image_integrator *integrator,
+                           const char *filename);
+
+/*
+ * Maps the tables saved by saxs_image_integrator_save(), if they were
+ * computed for the same frame size, geometry, number of bins and
+ * masked pixels. Returns NULL if not, or if the file is missing or
+ * damaged.
+ */
+saxs_image_integrator*
+saxs_image_integrator_load(const char *filename,
+                           size_t width, size_t height,
+                           const saxs_image_geometry *geometry,
+                           size_t bins, saxs_image *mask);
+
+/*
+ * Loads the tables from filename if possible, otherwise creates them
+ * and tries to save them there for the next process.
+ */
+saxs_image_integrator*
+saxs_image_integrator_open(const char *filename,
+                           size_t width, size_t height,
+                           const saxs_image_geometry *geometry,
+                           size_t bins, saxs_image *mask);
+
+/*
+ * Integrates the current frame and appends one data point per non-empty
+ * bin to the curve: the mean q of its pixels, the mean intensity and
+ * its Poisson error. Negative pixels, i.e. detector gaps and bad pixels,
+ * and non-finite ones are left out. Large frames are integrated in
+ * parallel; threads may share an integrator for frames of their own.
+ *
+ * Returns 0 on success, EINVAL if the frame is of different size,
+ * ENOMEM if out of memory.
+ */
+int
+saxs_image_integrate(saxs_image_integrator *integrator, saxs_image *image,
+                     struct saxs_curve *curve);
+
 
 struct saxs_property*
 saxs_image_add_property(saxs_image *image, const char *name, const char *value);
@@ -0,0 +1,569 @@
+/*
+ * Arithmetic on SAXS images and series of frames.
+ *
+ * This file is part of libsaxsdocument.
+ *
+ * libsaxsdocument is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * libsaxsdocument is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with libsaxsdocument. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "saxsimage.h"
+#include "saxsimage_format.h"
+#include "saxsthreadpool.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Rows are processed in blocks; frames of at least ARITH_PARALLEL_MIN
+ * pixels spread the blocks over the default thread pool.
+ */
+#define ARITH_BLOCK_ROWS   16
+#define ARITH_PARALLEL_MIN (1 << 18)
+
+struct arith_args {
+  saxs_image *image, *other, *mask;
+  saxs_image **images;
+  size_t count;
+  double a, b;
+  double *sum;
+  size_t width, height;
+  int *status;                  /* per block, written by its worker only */
+};
+
+/* y = a * y + b * x, or y = a * y if x is NULL. */
+static void
+arith_axpby(double *y, const double *x, double a, double b, size_t n) {
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128d va = _mm_set1_pd(a), vb = _mm_set1_pd(b);
+
+  if (x)
+    for (; i + 2 <= n; i += 2)
+      _mm_storeu_pd(y + i, _mm_add_pd(_mm_mul_pd(va, _mm_loadu_pd(y + i)),
+                                      _mm_mul_pd(vb, _mm_loadu_pd(x + i))));
+  else
+    for (; i + 2 <= n; i += 2)
+      _mm_storeu_pd(y + i, _mm_mul_pd(va, _mm_loadu_pd(y + i)));
+#endif
+
+  if (x)
+    for (; i < n; ++i)
+      y[i] = a * y[i] + b * x[i];
+  else
+    for (; i < n; ++i)
+      y[i] = a * y[i];
+}
+
+static int
+arith_check_size(saxs_image *image, size_t width, size_t height) {
+  return image
+      && saxs_image_width(image) == width
+      && saxs_image_height(image) == height;
+}
+
+static int
+arith_run(struct arith_args *args, void (*fn)(void*, size_t)) {
+  const size_t nblocks = (args->height + ARITH_BLOCK_ROWS - 1) / ARITH_BLOCK_ROWS;
+  size_t i;
+  int res = 0;
+
+  args->status = calloc(nblocks > 0 ? nblocks : 1, sizeof(int));
+  if (!args->status)
+    return ENOMEM;
+
+  if (args->width * args->height >= ARITH_PARALLEL_MIN)
+    saxs_thread_pool_for(saxs_thread_pool_default(), nblocks, fn, args);
+  else
+    saxs_thread_pool_for(NULL, nblocks, fn, args);
+
+  for (i = 0; i < nblocks && res == 0; ++i)
+    res = args->status[i];
+
+  free(args->status);
+  args->status = NULL;
+  return res;
+}
+
+/* Scratch space for a block: n doubles, followed by a row of mask. */
+static void*
+arith_scratch(struct arith_args *args, size_t index, size_t n, int with_mask) {
+  void *scratch = malloc(n * sizeof(double) + (with_mask ? args->width : 0));
+  if (!scratch)
+    args->status[index] = ENOMEM;
+  return scratch;
+}
+
+/*
+ * image = a * image + b * other in place, masked pixels unchanged.
+ */
+static void
+arith_inplace_block(void *arg, size_t index) {
+  struct arith_args *args = arg;
+  const size_t width = args->width;
+  const size_t y0 = index * ARITH_BLOCK_ROWS;
+  const size_t y1 = y0 + ARITH_BLOCK_ROWS < args->height
+                      ? y0 + ARITH_BLOCK_ROWS : args->height;
+  const int type = saxs_image_type(args->image);
+  double *row, *other, *orig;
+  uint8_t *masked;
+  void *scratch;
+  size_t x, y;
+
+  scratch = arith_scratch(args, index, 3 * width, args->mask != NULL);
+  if (!scratch)
+    return;
+
+  row    = scratch;
+  other  = row + width;
+  orig   = other + width;
+  masked = (uint8_t*)(orig + width);
+
+  for (y = y0; y < y1; ++y) {
+    void *data = saxs_image_row_data(args->image, y);
+
+    saxs_image_convert_pixels(data, type, row, SAXS_IMAGE_TYPE_DOUBLE, width);
+    if (args->other)
+      saxs_image_get_row(args->other, y, other, SAXS_IMAGE_TYPE_DOUBLE);
+
+    if (args->mask) {
+      memcpy(orig, row, width * sizeof(double));
+      saxs_image_get_row(args->mask, y, masked, SAXS_IMAGE_TYPE_UINT8);
+    }
+
+    arith_axpby(row, args->other ? other : NULL, args->a, args->b, width);
+
+    if (args->mask)
+      for (x = 0; x < width; ++x)
+        if (masked[x])
+          row[x] = orig[x];
+
+    saxs_image_convert_pixels(row, SAXS_IMAGE_TYPE_DOUBLE, data, type, width);
+  }
+
+  free(scratch);
+}
+
+static int
+arith_inplace(saxs_image *image, saxs_image *other, double a, double b,
+              saxs_image *mask) {
+  struct arith_args args;
+  int res;
+
+  assert(image != NULL);
+
+  memset(&args, 0, sizeof(args));
+  args.width  = saxs_image_width(image);
+  args.height = saxs_image_height(image);
+
+  if ((other && !arith_check_size(other, args.width, args.height))
+      || (mask && !arith_check_size(mask, args.width, args.height)))
+    return EINVAL;
+
+  /* Keep fractions. */
+  if (saxs_image_type(image) != SAXS_IMAGE_TYPE_FLOAT
+      && saxs_image_type(image) != SAXS_IMAGE_TYPE_DOUBLE) {
+    res = saxs_image_convert(image, SAXS_IMAGE_TYPE_DOUBLE);
+    if (res != 0)
+      return res;
+  }
+
+  args.image = image;
+  args.other = other;
+  args.mask  = mask;
+  args.a     = a;
+  args.b     = b;
+
+  res = arith_run(&args, arith_inplace_block);
+  saxs_image_modified(image);
+
+  return res;
+}
+
+int
+saxs_image_add(saxs_image *image, saxs_image *other, double factor,
+               saxs_image *mask) {
+  assert(other != NULL);
+  return arith_inplace(image, other, 1.0, factor, mask);
+}
+
+int
+saxs_image_subtract(saxs_image *image, saxs_image *other, saxs_image *mask) {
+  assert(other != NULL);
+  return arith_inplace(image, other, 1.0, -1.0, mask);
+}
+
+int
+saxs_image_scale(saxs_image *image, double factor, saxs_image *mask) {
+  return arith_inplace(image, NULL, factor, 0.0, mask);
+}
+
+
+/**************************************************************************/
+struct saxs_image_accumulator {
+  size_t width, height;
+  saxs_image *mask;
+  double *sum;
+  size_t count;
+};
+
+saxs_image_accumulator*
+saxs_image_accumulator_create(size_t width, size_t height, saxs_image *mask) {
+  saxs_image_accumulator *acc;
+
+  if (mask && !arith_check_size(mask, width, height))
+    return NULL;
+
+  acc = malloc(sizeof(saxs_image_accumulator));
+  if (!acc)
+    return NULL;
+
+  acc->width  = width;
+  acc->height = height;
+  acc->mask   = mask;
+  acc->count  = 0;
+  acc->sum    = calloc(width * height > 0 ? width * height : 1, sizeof(double));
+  if (!acc->sum) {
+    free(acc);
+    return NULL;
+  }
+
+  return acc;
+}
+
+void
+saxs_image_accumulator_free(saxs_image_accumulator *acc) {
+  if (acc) {
+    free(acc->sum);
+    free(acc);
+  }
+}
+
+static void
+accumulate_block(void *arg, size_t index) {
+  struct arith_args *args = arg;
+  const size_t width = args->width;
+  const size_t y0 = index * ARITH_BLOCK_ROWS;
+  const size_t y1 = y0 + ARITH_BLOCK_ROWS < args->height
+                      ? y0 + ARITH_BLOCK_ROWS : args->height;
+  uint8_t *masked;
+  double *row;
+  size_t x, y;
+
+  row = arith_scratch(args, index, width, args->mask != NULL);
+  if (!row)
+    return;
+  masked = (uint8_t*)(row + width);
+
+  for (y = y0; y < y1; ++y) {
+    saxs_image_get_row(args->image, y, row, SAXS_IMAGE_TYPE_DOUBLE);
+
+    if (args->mask) {
+      saxs_image_get_row(args->mask, y, masked, SAXS_IMAGE_TYPE_UINT8);
+      for (x = 0; x < width; ++x)
+        if (masked[x])
+          row[x] = 0.0;
+    }
+
+    arith_axpby(args->sum + y * width, row, 1.0, args->b, width);
+  }
+
+  free(row);
+}
+
+int
+saxs_image_accumulator_add(saxs_image_accumulator *acc, saxs_image *image,
+                           double factor) {
+  struct arith_args args;
+  int res;
+
+  assert(acc != NULL);
+
+  if (!arith_check_size(image, acc->width, acc->height))
+    return EINVAL;
+
+  memset(&args, 0, sizeof(args));
+  args.image  = image;
+  args.mask   = acc->mask;
+  args.b      = factor;
+  args.sum    = acc->sum;
+  args.width  = acc->width;
+  args.height = acc->height;
+
+  res = arith_run(&args, accumulate_block);
+  if (res == 0)
+    acc->count += 1;
+
+  return res;
+}
+
+int
+saxs_image_accumulator_add_frames(saxs_image_accumulator *acc,
+                                  saxs_image *image,
+                                  size_t first, size_t count) {
+  size_t frame;
+  int res = 0;
+
+  for (frame = first; frame < first + count && res == 0; ++frame) {
+    res = saxs_image_read_frame(image, frame);
+    if (res == 0)
+      res = saxs_image_accumulator_add(acc, image, 1.0);
+  }
+
+  return res;
+}
+
+size_t
+saxs_image_accumulator_count(saxs_image_accumulator *acc) {
+  return acc ? acc->count : 0;
+}
+
+static int
+accumulator_result(saxs_image_accumulator *acc, saxs_image *result,
+                   double factor) {
+  size_t y;
+  int res;
+
+  res = saxs_image_resize(result, acc->width, acc->height, 1, 1,
+                          SAXS_IMAGE_TYPE_DOUBLE);
+  if (res != 0)
+    return res;
+
+  for (y = 0; y < acc->height; ++y) {
+    double *row = saxs_image_row_data(result, y);
+    memcpy(row, acc->sum + y * acc->width, acc->width * sizeof(double));
+    if (factor != 1.0)
+      arith_axpby(row, NULL, factor, 0.0, acc->width);
+  }
+
+  saxs_image_modified(result);
+  return 0;
+}
+
+int
+saxs_image_accumulator_sum(saxs_image_accumulator *acc, saxs_image *result) {
+  assert(acc != NULL);
+  assert(result != NULL);
+
+  return accumulator_result(acc, result, 1.0);
+}
+
+int
+saxs_image_accumulator_mean(saxs_image_accumulator *acc, saxs_image *result) {
+  assert(acc != NULL);
+  assert(result != NULL);
+
+  if (acc->count == 0)
+    return EINVAL;
+
+  return accumulator_result(acc, result, 1.0 / acc->count);
+}
+
+
+/**************************************************************************/
+int
+saxs_image_mean(saxs_image *result, saxs_image **images, size_t count,
+                saxs_image *mask) {
+  saxs_image_accumulator *acc;
+  size_t i;
+  int res = 0;
+
+  assert(result != NULL);
+  assert(images != NULL);
+
+  if (count == 0)
+    return EINVAL;
+
+  acc = saxs_image_accumulator_create(saxs_image_width(images[0]),
+                                      saxs_image_height(images[0]), mask);
+  if (!acc)
+    return mask ? EINVAL : ENOMEM;
+
+  for (i = 0; i < count && res == 0; ++i)
+    res = saxs_image_accumulator_add(acc, images[i], 1.0);
+
+  if (res == 0)
+    res = saxs_image_accumulator_mean(acc, result);
+
+  saxs_image_accumulator_free(acc);
+  return res;
+}
+
+/* Wirth's selection: the k-th smallest of n values, reordering them. */
+static double
+median_select(double *v, ptrdiff_t n, ptrdiff_t k) {
+  ptrdiff_t left = 0, right = n - 1;
+
+  while (left < right) {
+    const double pivot = v[k];
+    ptrdiff_t i = left, j = right;
+
+    do {
+      while (v[i] < pivot) ++i;
+      while (pivot < v[j]) --j;
+      if (i <= j) {
+        const double t = v[i];
+        v[i++] = v[j];
+        v[j--] = t;
+      }
+    } while (i <= j);
+
+    if (j < k)
+      left = i;
+    if (k < i)
+      right = j;
+  }
+
+  return v[k];
+}
+
+static void
+median_block(void *arg, size_t index) {
+  struct arith_args *args = arg;
+  const size_t width = args->width, count = args->count;
+  const size_t y0 = index * ARITH_BLOCK_ROWS;
+  const size_t y1 = y0 + ARITH_BLOCK_ROWS < args->height
+                      ? y0 + ARITH_BLOCK_ROWS : args->height;
+  double *rows, *values;
+  uint8_t *masked;
+  size_t i, n, x, y;
+
+  rows = arith_scratch(args, index, count * width + count, args->mask != NULL);
+  if (!rows)
+    return;
+  values = rows + count * width;
+  masked = (uint8_t*)(values + count);
+
+  for (y = y0; y < y1; ++y) {
+    double *out = saxs_image_row_data(args->image, y);
+
+    for (i = 0; i < count; ++i)
+      saxs_image_get_row(args->images[i], y, rows + i * width,
+                         SAXS_IMAGE_TYPE_DOUBLE);
+    if (args->mask)
+      saxs_image_get_row(args->mask, y, masked, SAXS_IMAGE_TYPE_UINT8);
+
+    for (x = 0; x < width; ++x) {
+      if (args->mask && masked[x]) {
+        out[x] = 0.0;
+        continue;
+      }
+
+      /* NaN does not order, leave it out. */
+      for (i = 0, n = 0; i < count; ++i)
+        if (rows[i * width + x] == rows[i * width + x])
+          values[n++] = rows[i * width + x];
+
+      if (n == 0)
+        out[x] = NAN;
+      else if (n % 2)
+        out[x] = median_select(values, n, n / 2);
+      else {
+        /* After selecting the upper middle, the lower is the largest below. */
+        double lower, upper = median_select(values, n, n / 2);
+        for (i = 1, lower = values[0]; i < n / 2; ++i)
+          if (values[i] > lower)
+            lower = values[i];
+        out[x] = 0.5 * (lower + upper);
+      }
+    }
+  }
+
+  free(rows);
+}
+
+int
+saxs_image_median(saxs_image *result, saxs_image **images, size_t count,
+                  saxs_image *mask) {
+  struct arith_args args;
+  size_t i;
+  int res;
+
+  assert(result != NULL);
+  assert(images != NULL);
+
+  if (count == 0)
+    return EINVAL;
+
+  memset(&args, 0, sizeof(args));
+  args.width  = saxs_image_width(images[0]);
+  args.height = saxs_image_height(images[0]);
+
+  for (i = 1; i < count; ++i)
+    if (!arith_check_size(images[i], args.width, args.height))
+      return EINVAL;
+  if (mask && !arith_check_size(mask, args.width, args.height))
+    return EINVAL;
+
+  res = saxs_image_resize(result, args.width, args.height, 1, 1,
+                          SAXS_IMAGE_TYPE_DOUBLE);
+  if (res != 0)
+    return res;
+
+  args.image  = result;
+  args.images = images;
+  args.count  = count;
+  args.mask   = mask;
+
+  res = arith_run(&args, median_block);
+  saxs_image_modified(result);
+
+  return res;
+}
+
+int
+saxs_image_median_frames(saxs_image *result, saxs_image *image,
+                         size_t first, size_t count, saxs_image *mask) {
+  saxs_image **frames;
+  size_t i;
+  int res = 0;
+
+  assert(image != NULL);
+
+  if (count == 0)
+    return EINVAL;
+
+  frames = calloc(count, sizeof(saxs_image*));
+  if (!frames)
+    return ENOMEM;
+
+  for (i = 0; i < count && res == 0; ++i) {
+    res = saxs_image_read_frame(image, first + i);
+    if (res == 0) {
+      frames[i] = saxs_image_copy(image);
+      if (!frames[i])
+        res = ENOMEM;
+    }
+  }
+
+  if (res == 0)
+    res = saxs_image_median(result, frames, count, mask);
+
+  for (i = 0; i < count; ++i)
+    saxs_image_free(frames[i]);
+  free(frames);
+
+  return res;
+}
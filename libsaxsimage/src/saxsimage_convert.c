@@ -0,0 +1,240 @@
+/*
+ * Pixel type and layout conversion kernels for SAXS images.
+ *
+ * This file is part of libsaxsdocument.
+ *
+ * libsaxsdocument is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * libsaxsdocument is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with libsaxsdocument. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "saxsimage.h"
+#include "saxsimage_format.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Vectorised conversions of the pixel types detectors actually write
+ * (PILATUS: int32, MAR: uint16, EDF: float) to float and double. Each
+ * returns the number of pixels converted, the rest is left to the
+ * generic loops below.
+ */
+#ifdef __SSE2__
+static size_t
+convert_int32_double(const int32_t *from, double *to, size_t n) {
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(from + i));
+    _mm_storeu_pd(to + i,     _mm_cvtepi32_pd(v));
+    _mm_storeu_pd(to + i + 2, _mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2))));
+  }
+
+  return i;
+}
+
+static size_t
+convert_int32_float(const int32_t *from, float *to, size_t n) {
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    _mm_storeu_ps(to + i,
+                  _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(from + i))));
+
+  return i;
+}
+
+static size_t
+convert_float_double(const float *from, double *to, size_t n) {
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    const __m128 v = _mm_loadu_ps(from + i);
+    _mm_storeu_pd(to + i,     _mm_cvtps_pd(v));
+    _mm_storeu_pd(to + i + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+  }
+
+  return i;
+}
+
+/* Widen 8 16-bit values to two vectors of 4 int32. */
+#define WIDEN16(v, lo, hi, is_signed)                             \
+  do {                                                            \
+    if (is_signed) {                                              \
+      lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);          \
+      hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);          \
+    } else {                                                      \
+      lo = _mm_unpacklo_epi16(v, _mm_setzero_si128());            \
+      hi = _mm_unpackhi_epi16(v, _mm_setzero_si128());            \
+    }                                                             \
+  } while (0)
+
+static size_t
+convert_16_double(const void *from, double *to, size_t n, int is_signed) {
+  const uint16_t *src = from;
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i lo, hi;
+
+    WIDEN16(v, lo, hi, is_signed);
+    _mm_storeu_pd(to + i,     _mm_cvtepi32_pd(lo));
+    _mm_storeu_pd(to + i + 2, _mm_cvtepi32_pd(_mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2))));
+    _mm_storeu_pd(to + i + 4, _mm_cvtepi32_pd(hi));
+    _mm_storeu_pd(to + i + 6, _mm_cvtepi32_pd(_mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2))));
+  }
+
+  return i;
+}
+
+static size_t
+convert_16_float(const void *from, float *to, size_t n, int is_signed) {
+  const uint16_t *src = from;
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i lo, hi;
+
+    WIDEN16(v, lo, hi, is_signed);
+    _mm_storeu_ps(to + i,     _mm_cvtepi32_ps(lo));
+    _mm_storeu_ps(to + i + 4, _mm_cvtepi32_ps(hi));
+  }
+
+  return i;
+}
+
+#undef WIDEN16
+
+static size_t
+convert_simd(const void *from, int from_type, void *to, int to_type, size_t n) {
+  switch (from_type * 16 + to_type) {
+    case SAXS_IMAGE_TYPE_INT32 * 16 + SAXS_IMAGE_TYPE_DOUBLE:
+      return convert_int32_double(from, to, n);
+    case SAXS_IMAGE_TYPE_INT32 * 16 + SAXS_IMAGE_TYPE_FLOAT:
+      return convert_int32_float(from, to, n);
+    case SAXS_IMAGE_TYPE_FLOAT * 16 + SAXS_IMAGE_TYPE_DOUBLE:
+      return convert_float_double(from, to, n);
+    case SAXS_IMAGE_TYPE_UINT16 * 16 + SAXS_IMAGE_TYPE_DOUBLE:
+      return convert_16_double(from, to, n, 0);
+    case SAXS_IMAGE_TYPE_INT16 * 16 + SAXS_IMAGE_TYPE_DOUBLE:
+      return convert_16_double(from, to, n, 1);
+    case SAXS_IMAGE_TYPE_UINT16 * 16 + SAXS_IMAGE_TYPE_FLOAT:
+      return convert_16_float(from, to, n, 0);
+    case SAXS_IMAGE_TYPE_INT16 * 16 + SAXS_IMAGE_TYPE_FLOAT:
+      return convert_16_float(from, to, n, 1);
+    default:
+      return 0;
+  }
+}
+#else
+static size_t
+convert_simd(const void *from, int from_type, void *to, int to_type, size_t n) {
+  return 0;
+}
+#endif
+
+
+#define CONVERT_TO(totype)                                    \
+  for (i = 0; i < n; ++i)                                     \
+    ((totype*)to)[i] = (totype)((const fromtype*)from)[i]
+
+#define CONVERT_FROM(ftype)                                   \
+  do {                                                        \
+    typedef ftype fromtype;                                   \
+    SAXS_IMAGE_SWITCH_TYPE_INNER(to_type, CONVERT_TO)         \
+  } while (0)
+
+void
+saxs_image_convert_pixels(const void *from, int from_type,
+                          void *to, int to_type, size_t n) {
+  size_t i;
+
+  if (from_type == to_type) {
+    memcpy(to, from, n * saxs_image_type_size(from_type));
+    return;
+  }
+
+  i = convert_simd(from, from_type, to, to_type, n);
+  if (i > 0) {
+    from = (const char*)from + i * saxs_image_type_size(from_type);
+    to   = (char*)to + i * saxs_image_type_size(to_type);
+    n   -= i;
+  }
+
+  SAXS_IMAGE_SWITCH_TYPE(from_type, CONVERT_FROM)
+}
+
+#undef CONVERT_FROM
+#undef CONVERT_TO
+
+
+/*
+ * Gathers with a stride between neighbouring pixels in a row go
+ * tile by tile, so that both the source columns and the destination
+ * rows of a tile stay in cache.
+ */
+#define GATHER_TILE 32
+
+#define GATHER_TO(totype)                                                   \
+  for (y0 = 0; y0 < height; y0 += GATHER_TILE)                              \
+    for (x0 = 0; x0 < width; x0 += GATHER_TILE) {                           \
+      const size_t y1 = y0 + GATHER_TILE < height ? y0 + GATHER_TILE : height; \
+      const size_t x1 = x0 + GATHER_TILE < width ? x0 + GATHER_TILE : width; \
+                                                                            \
+      for (y = y0; y < y1; ++y) {                                           \
+        const char *src = (const char*)from + (ptrdiff_t)y * from_ystride;  \
+        totype *dst = (totype*)((char*)to + (ptrdiff_t)y * to_ystride);     \
+                                                                            \
+        for (x = x0; x < x1; ++x)                                           \
+          dst[x] = (totype)*(const fromtype*)(src + (ptrdiff_t)x * from_xstride); \
+      }                                                                     \
+    }
+
+#define GATHER_FROM(ftype)                                    \
+  do {                                                        \
+    typedef ftype fromtype;                                   \
+    SAXS_IMAGE_SWITCH_TYPE_INNER(to_type, GATHER_TO)          \
+  } while (0)
+
+void
+saxs_image_convert_block(const void *from, int from_type,
+                         ptrdiff_t from_xstride, ptrdiff_t from_ystride,
+                         void *to, int to_type, ptrdiff_t to_ystride,
+                         size_t width, size_t height) {
+  size_t x, y, x0, y0;
+
+  /* Rows are contiguous, possibly flipped: convert row by row. */
+  if (from_xstride == (ptrdiff_t)saxs_image_type_size(from_type)) {
+    for (y = 0; y < height; ++y)
+      saxs_image_convert_pixels((const char*)from + (ptrdiff_t)y * from_ystride,
+                                from_type,
+                                (char*)to + (ptrdiff_t)y * to_ystride,
+                                to_type, width);
+    return;
+  }
+
+  SAXS_IMAGE_SWITCH_TYPE(from_type, GATHER_FROM)
+}
+
+#undef GATHER_FROM
+#undef GATHER_TO
+#undef GATHER_TILE
@@ -24,6 +24,8 @@
 #ifndef LIBSAXSDOCUMENT_SAXSIMAGE_FORMAT_H
 #define LIBSAXSDOCUMENT_SAXSIMAGE_FORMAT_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 #ifdef __cplusplus
@@ -35,6 +37,12 @@ struct saxs_image;
 struct saxs_image_format {
   int (*read)(struct saxs_image*, const char *filename, size_t frame);
   int (*write)(struct saxs_image*, const char *filename);
+
+  /*
+   * Optional, for files that grow while open: the number of frames
+   * in the file read now, see saxs_image_refresh().
+   */
+  int (*refresh)(struct saxs_image*, size_t *frame_count);
 };
 typedef struct saxs_image_format saxs_image_format;
 
@@ -42,6 +50,105 @@ typedef struct saxs_image_format saxs_image_format;
 const saxs_image_format*
 saxs_image_format_find(const char *filename, const char *format);
 
+/*
+ * For readers of uncompressed files: map height rows of width pixels
+ * of the given type, starting at offset in filename, as the pixels
+ * of the image. Pass topdown if the first row in the file is the top
+ * row of the image. Returns 0 on success, ENOTSUP if the data can not
+ * be mapped, e.g. if misaligned, or another errno; the image is left
+ * as is on failure and the reader should fall back to reading.
+ */
+int saxs_image_map(struct saxs_image *image, const char *filename,
+                   off_t offset, size_t width, size_t height,
+                   size_t frame_count, size_t current_frame,
+                   int type, int topdown);
+
+
+/*
+ * For readers keeping a file open between frames: state attached to
+ * the image, e.g. open handles. It is released by free_state once the
+ * image is free'd or read from a file again; copies start without.
+ * saxs_image_format_state() returns NULL if none is set.
+ *
+ * Frames prefetched for the image are read with its state from other
+ * threads, readers must serialize access to it. Replacing the state
+ * waits for those reads to finish.
+ */
+void* saxs_image_format_state(struct saxs_image *image);
+void saxs_image_set_format_state(struct saxs_image *image, void *state,
+                                 void (*free_state)(void*));
+
+
+/*
+ * Layout of the pixels passed to saxs_image_set_pixels(). By default,
+ * rows are stored bottom to top, each row from left to right.
+ */
+#define SAXS_IMAGE_LAYOUT_TOPDOWN      1     /* first row is the top row */
+#define SAXS_IMAGE_LAYOUT_TRANSPOSED   2     /* column-major */
+
+/*
+ * For readers: replace all pixels of the image by width * height
+ * values of the given type, converted and reordered as needed.
+ * Returns 0 on success, EINVAL if the type is unknown or the image
+ * is empty.
+ */
+int saxs_image_set_pixels(struct saxs_image *image, const void *values,
+                          int type, int layout);
+
+
+/*
+ * For operations writing pixels in place: row y of the pixels, see
+ * saxs_image_row(), and dropping everything derived from the pixels
+ * once done.
+ */
+void* saxs_image_row_data(struct saxs_image *image, size_t y);
+void saxs_image_modified(struct saxs_image *image);
+
+
+/*
+ * Conversion kernels, see saxsimage_convert.c.
+ *
+ * saxs_image_convert_pixels() converts n contiguous pixels.
+ * saxs_image_convert_block() converts width * height pixels, where
+ * pixel (x, y) is found at from + x * from_xstride + y * from_ystride
+ * and stored in row y at to + y * to_ystride; strides are in bytes and
+ * may be negative to flip, an xstride other than the size of the type
+ * transposes.
+ */
+void saxs_image_convert_pixels(const void *from, int from_type,
+                               void *to, int to_type, size_t n);
+
+void saxs_image_convert_block(const void *from, int from_type,
+                              ptrdiff_t from_xstride, ptrdiff_t from_ystride,
+                              void *to, int to_type, ptrdiff_t to_ystride,
+                              size_t width, size_t height);
+
+/*
+ * Expand MACRO(ctype) for the C type of a pixel type. Macros do not
+ * expand recursively, hence the second switch for nesting.
+ */
+#define SAXS_IMAGE_SWITCH_TYPE(type, MACRO)                 \
+  switch (type) {                                           \
+    case SAXS_IMAGE_TYPE_UINT8:  MACRO(uint8_t);  break;    \
+    case SAXS_IMAGE_TYPE_INT16:  MACRO(int16_t);  break;    \
+    case SAXS_IMAGE_TYPE_UINT16: MACRO(uint16_t); break;    \
+    case SAXS_IMAGE_TYPE_INT32:  MACRO(int32_t);  break;    \
+    case SAXS_IMAGE_TYPE_UINT32: MACRO(uint32_t); break;    \
+    case SAXS_IMAGE_TYPE_FLOAT:  MACRO(float);    break;    \
+    case SAXS_IMAGE_TYPE_DOUBLE: MACRO(double);   break;    \
+  }
+
+#define SAXS_IMAGE_SWITCH_TYPE_INNER(type, MACRO)           \
+  switch (type) {                                           \
+    case SAXS_IMAGE_TYPE_UINT8:  MACRO(uint8_t);  break;    \
+    case SAXS_IMAGE_TYPE_INT16:  MACRO(int16_t);  break;    \
+    case SAXS_IMAGE_TYPE_UINT16: MACRO(uint16_t); break;    \
+    case SAXS_IMAGE_TYPE_INT32:  MACRO(int32_t);  break;    \
+    case SAXS_IMAGE_TYPE_UINT32: MACRO(uint32_t); break;    \
+    case SAXS_IMAGE_TYPE_FLOAT:  MACRO(float);    break;    \
+    case SAXS_IMAGE_TYPE_DOUBLE: MACRO(double);   break;    \
+  }
+
 
 /*
  * Also in saxsdocument_format.h, but to keep things separate ...
@@ -0,0 +1,681 @@
+/*
+ * Azimuthal integration of SAXS images into curves.
+ *
+ * This file is part of libsaxsdocument.
+ *
+ * libsaxsdocument is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU Lesser General
+ * Public License as published by the Free Software Foundation,
+ * either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * libsaxsdocument is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General
+ * Public License along with libsaxsdocument. If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "saxsimage.h"
+#include "saxsimage_format.h"
+#include "saxsdocument.h"
+#include "saxsthreadpool.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*
+ * Bins are integrated in chunks of about INTEGRATE_CHUNK_PIXELS pixels,
+ * so that chunks take about the same time no matter how many pixels
+ * fall into each bin. Frames of at least INTEGRATE_PARALLEL_MIN pixels
+ * spread the chunks over the default thread pool.
+ */
+#define INTEGRATE_CHUNK_PIXELS (1 << 16)
+#define INTEGRATE_PARALLEL_MIN (1 << 18)
+
+struct saxs_image_integrator {
+  size_t width, height, bins;
+
+  /*
+   * Compressed sparse rows: the pixels of bin b are index[offsets[b]]
+   * to index[offsets[b + 1] - 1], as y * width + x, in ascending order
+   * to keep the reads moving forward. Frames stored top to bottom use
+   * index_topdown, built on first use under lock, as integrators may
+   * be shared between threads.
+   */
+  size_t *offsets;
+  uint32_t *index;
+  uint32_t *index_topdown;
+  pthread_mutex_t lock;
+
+  /* Mean q of the pixels in each bin. */
+  double *q;
+
+  /* Chunks of bins, chunk c being bins chunks[c] to chunks[c + 1] - 1. */
+  size_t *chunks;
+  size_t nchunks;
+
+  /* Hash of the geometry, number of bins and mask, see integrator_key(). */
+  uint64_t key;
+
+  /*
+   * If loaded from a table file, offsets, index, q and chunks point
+   * into this block instead of being allocated one by one.
+   */
+  void *mapping;
+  size_t mapping_size;
+};
+
+/*
+ * Table files, see saxs_image_integrator_save(): this header, then
+ * offsets, chunks, q and index as in memory. The tables are only
+ * valid on machines like the one they were written on; byte order
+ * and the size of size_t are checked on load.
+ */
+#define INTEGRATOR_FILE_MAGIC   "SAXSQMAP"
+#define INTEGRATOR_FILE_VERSION 1
+
+struct integrator_file_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t size_t_size;
+  uint32_t reserved;
+  uint64_t key;
+  uint64_t width, height, bins, pixels, nchunks;
+};
+
+static double
+integrator_q(const saxs_image_geometry *geometry, size_t x, size_t y) {
+  const double dx = (x - geometry->center_x) * geometry->pixel_size_x;
+  const double dy = (y - geometry->center_y) * geometry->pixel_size_y;
+  const double two_theta = atan2(sqrt(dx * dx + dy * dy), geometry->distance);
+
+  return 4.0 * M_PI / geometry->wavelength * sin(0.5 * two_theta);
+}
+
+/*
+ * FNV-1a over everything the tables depend on. Masks are hashed by
+ * which pixels are masked, not by their values or pixel type.
+ */
+static uint64_t
+integrator_hash(uint64_t hash, const void *data, size_t n) {
+  const unsigned char *p = data;
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    hash ^= p[i];
+    hash *= UINT64_C(0x100000001b3);
+  }
+  return hash;
+}
+
+static int
+integrator_key(size_t width, size_t height,
+               const saxs_image_geometry *geometry, size_t bins,
+               saxs_image *mask, uint64_t *key) {
+  const uint64_t sizes[3] = { width, height, bins };
+  const double parameters[6] = { geometry->center_x, geometry->center_y,
+                                 geometry->distance,
+                                 geometry->pixel_size_x, geometry->pixel_size_y,
+                                 geometry->wavelength };
+  uint64_t hash = UINT64_C(0xcbf29ce484222325);
+  uint8_t *masked;
+  size_t x, y;
+
+  hash = integrator_hash(hash, sizes, sizeof(sizes));
+  hash = integrator_hash(hash, parameters, sizeof(parameters));
+
+  if (mask) {
+    masked = malloc(width);
+    if (!masked)
+      return ENOMEM;
+
+    for (y = 0; y < height; ++y) {
+      saxs_image_get_row(mask, y, masked, SAXS_IMAGE_TYPE_UINT8);
+      for (x = 0; x < width; ++x)
+        masked[x] = masked[x] != 0;
+      hash = integrator_hash(hash, masked, width);
+    }
+
+    free(masked);
+  }
+
+  *key = hash;
+  return 0;
+}
+
+static int
+integrator_valid_arguments(size_t width, size_t height,
+                           const saxs_image_geometry *geometry,
+                           size_t bins, saxs_image *mask) {
+  return bins > 0 && bins < UINT32_MAX
+         && width * height > 0 && width * height <= UINT32_MAX
+         && geometry->distance > 0.0 && geometry->wavelength > 0.0
+         && (!mask || (saxs_image_width(mask) == width
+                       && saxs_image_height(mask) == height));
+}
+
+saxs_image_integrator*
+saxs_image_integrator_create(size_t width, size_t height,
+                             const saxs_image_geometry *geometry,
+                             size_t bins, saxs_image *mask) {
+  saxs_image_integrator *integrator;
+  uint8_t *masked = NULL;
+  uint32_t *bin = NULL;
+  double *q = NULL, qmin = HUGE_VAL, qmax = -HUGE_VAL;
+  size_t *next = NULL;
+  size_t b, c, i, n, x, y;
+
+  assert(geometry != NULL);
+
+  if (!integrator_valid_arguments(width, height, geometry, bins, mask))
+    return NULL;
+
+  integrator = calloc(1, sizeof(saxs_image_integrator));
+  if (!integrator)
+    return NULL;
+  pthread_mutex_init(&integrator->lock, NULL);
+
+  integrator->width   = width;
+  integrator->height  = height;
+  integrator->bins    = bins;
+  integrator->offsets = calloc(bins + 1, sizeof(size_t));
+  integrator->q       = calloc(bins, sizeof(double));
+  integrator->chunks  = malloc((bins + 1) * sizeof(size_t));
+  q      = malloc(width * height * sizeof(double));
+  bin    = malloc(width * height * sizeof(uint32_t));
+  next   = malloc(bins * sizeof(size_t));
+  masked = malloc(width);
+  if (!integrator->offsets || !integrator->q || !integrator->chunks
+      || !q || !bin || !next || !masked
+      || integrator_key(width, height, geometry, bins, mask,
+                        &integrator->key) != 0)
+    goto error;
+
+  /* The q of each pixel, and the range over those not masked. */
+  for (y = 0; y < height; ++y) {
+    if (mask)
+      saxs_image_get_row(mask, y, masked, SAXS_IMAGE_TYPE_UINT8);
+    else
+      memset(masked, 0, width);
+
+    for (x = 0; x < width; ++x) {
+      i = y * width + x;
+      if (masked[x]) {
+        q[i] = NAN;
+        continue;
+      }
+
+      q[i] = integrator_q(geometry, x, y);
+      if (q[i] < qmin)
+        qmin = q[i];
+      if (q[i] > qmax)
+        qmax = q[i];
+    }
+  }
+
+  /* Count the pixels per bin, then place them in a second pass. */
+  for (i = 0, n = 0; i < width * height; ++i) {
+    if (q[i] != q[i]) {
+      bin[i] = UINT32_MAX;
+      continue;
+    }
+
+    b = qmax > qmin ? (size_t)((q[i] - qmin) / (qmax - qmin) * bins) : 0;
+    if (b >= bins)
+      b = bins - 1;
+
+    bin[i] = b;
+    integrator->offsets[b + 1] += 1;
+    integrator->q[b] += q[i];
+    n += 1;
+  }
+
+  for (b = 0; b < bins; ++b) {
+    if (integrator->offsets[b + 1] > 0)
+      integrator->q[b] /= integrator->offsets[b + 1];
+    integrator->offsets[b + 1] += integrator->offsets[b];
+  }
+
+  integrator->index = malloc((n ? n : 1) * sizeof(uint32_t));
+  if (!integrator->index)
+    goto error;
+
+  memcpy(next, integrator->offsets, bins * sizeof(size_t));
+  for (i = 0; i < width * height; ++i)
+    if (bin[i] != UINT32_MAX)
+      integrator->index[next[bin[i]]++] = i;
+
+  /* Chunks of roughly equal numbers of pixels. */
+  integrator->chunks[0] = 0;
+  for (b = 1, c = 0; b <= bins; ++b)
+    if (b == bins || integrator->offsets[b] - integrator->offsets[integrator->chunks[c]]
+                       >= INTEGRATE_CHUNK_PIXELS)
+      integrator->chunks[++c] = b;
+  integrator->nchunks = c;
+
+  free(masked);
+  free(next);
+  free(bin);
+  free(q);
+  return integrator;
+
+error:
+  free(masked);
+  free(next);
+  free(bin);
+  free(q);
+  saxs_image_integrator_free(integrator);
+  return NULL;
+}
+
+void
+saxs_image_integrator_free(saxs_image_integrator *integrator) {
+  if (integrator) {
+    if (integrator->mapping) {
+#ifndef _WIN32
+      munmap(integrator->mapping, integrator->mapping_size);
+#else
+      free(integrator->mapping);
+#endif
+    } else {
+      free(integrator->offsets);
+      free(integrator->index);
+      free(integrator->q);
+      free(integrator->chunks);
+    }
+    free(integrator->index_topdown);
+    pthread_mutex_destroy(&integrator->lock);
+    free(integrator);
+  }
+}
+
+int
+saxs_image_integrator_save(saxs_image_integrator *integrator,
+                           const char *filename) {
+  struct integrator_file_header header;
+  size_t bins, pixels, nchunks;
+  char *tmpname;
+  FILE *fd;
+  int res = 0;
+
+  assert(integrator != NULL);
+  assert(filename != NULL);
+
+  bins    = integrator->bins;
+  pixels  = integrator->offsets[bins];
+  nchunks = integrator->nchunks;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, INTEGRATOR_FILE_MAGIC, sizeof(header.magic));
+  header.version     = INTEGRATOR_FILE_VERSION;
+  header.byte_order  = 0x01020304;
+  header.size_t_size = sizeof(size_t);
+  header.key         = integrator->key;
+  header.width       = integrator->width;
+  header.height      = integrator->height;
+  header.bins        = bins;
+  header.pixels      = pixels;
+  header.nchunks     = nchunks;
+
+  /*
+   * Write to a temporary file next to the target and rename it, so
+   * that processes loading the tables never see a partial file.
+   */
+  tmpname = malloc(strlen(filename) + 32);
+  if (!tmpname)
+    return ENOMEM;
+#ifndef _WIN32
+  sprintf(tmpname, "%s.%ld.tmp", filename, (long)getpid());
+#else
+  sprintf(tmpname, "%s.tmp", filename);
+#endif
+
+  fd = fopen(tmpname, "wb");
+  if (!fd) {
+    res = errno;
+    free(tmpname);
+    return res;
+  }
+
+  errno = 0;
+  if (fwrite(&header, sizeof(header), 1, fd) != 1
+      || fwrite(integrator->offsets, sizeof(size_t), bins + 1, fd) != bins + 1
+      || fwrite(integrator->chunks, sizeof(size_t), nchunks + 1, fd) != nchunks + 1
+      || fwrite(integrator->q, sizeof(double), bins, fd) != bins
+      || fwrite(integrator->index, sizeof(uint32_t), pixels, fd) != pixels)
+    res = errno ? errno : EIO;
+
+  if (fclose(fd) != 0 && res == 0)
+    res = errno ? errno : EIO;
+
+#ifdef _WIN32
+  if (res == 0)
+    remove(filename);
+#endif
+  if (res == 0 && rename(tmpname, filename) != 0)
+    res = errno;
+
+  if (res != 0)
+    remove(tmpname);
+
+  free(tmpname);
+  return res;
+}
+
+/* The whole file, mapped read-only where possible. */
+static void*
+integrator_map_file(const char *filename, size_t *size) {
+#ifndef _WIN32
+  struct stat st;
+  void *mapping;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+      || (size_t)st.st_size < sizeof(struct integrator_file_header)) {
+    close(fd);
+    return NULL;
+  }
+
+  *size   = st.st_size;
+  mapping = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  return mapping == MAP_FAILED ? NULL : mapping;
+#else
+  FILE *fd = fopen(filename, "rb");
+  void *data = NULL;
+  long n = 0;
+
+  if (!fd)
+    return NULL;
+
+  if (fseek(fd, 0, SEEK_END) == 0 && (n = ftell(fd)) > 0
+      && (size_t)n >= sizeof(struct integrator_file_header)
+      && fseek(fd, 0, SEEK_SET) == 0 && (data = malloc(n)) != NULL
+      && fread(data, 1, n, fd) != (size_t)n) {
+    free(data);
+    data = NULL;
+  }
+
+  fclose(fd);
+  *size = n;
+  return data;
+#endif
+}
+
+/*
+ * Checks that the tables are consistent, so that a damaged file
+ * can not make saxs_image_integrate() read outside of a frame.
+ */
+static int
+integrator_check(const saxs_image_integrator *integrator) {
+  const size_t n = integrator->offsets[integrator->bins];
+  size_t b, c, i;
+
+  if (integrator->offsets[0] != 0 || integrator->chunks[0] != 0
+      || integrator->chunks[integrator->nchunks] != integrator->bins)
+    return 0;
+
+  for (b = 0; b < integrator->bins; ++b)
+    if (integrator->offsets[b] > integrator->offsets[b + 1])
+      return 0;
+
+  for (c = 0; c < integrator->nchunks; ++c)
+    if (integrator->chunks[c] > integrator->chunks[c + 1])
+      return 0;
+
+  for (i = 0; i < n; ++i)
+    if (integrator->index[i] >= integrator->width * integrator->height)
+      return 0;
+
+  return 1;
+}
+
+saxs_image_integrator*
+saxs_image_integrator_load(const char *filename,
+                           size_t width, size_t height,
+                           const saxs_image_geometry *geometry,
+                           size_t bins, saxs_image *mask) {
+  saxs_image_integrator *integrator;
+  const struct integrator_file_header *header;
+  uint64_t key;
+  size_t size, nchunks, pixels;
+  char *data;
+
+  assert(filename != NULL);
+  assert(geometry != NULL);
+
+  if (!integrator_valid_arguments(width, height, geometry, bins, mask)
+      || integrator_key(width, height, geometry, bins, mask, &key) != 0)
+    return NULL;
+
+  integrator = calloc(1, sizeof(saxs_image_integrator));
+  if (!integrator)
+    return NULL;
+  pthread_mutex_init(&integrator->lock, NULL);
+
+  integrator->mapping = integrator_map_file(filename, &size);
+  if (!integrator->mapping)
+    goto error;
+  integrator->mapping_size = size;
+
+  header  = integrator->mapping;
+  pixels  = header->pixels;
+  nchunks = header->nchunks;
+  if (memcmp(header->magic, INTEGRATOR_FILE_MAGIC, sizeof(header->magic)) != 0
+      || header->version != INTEGRATOR_FILE_VERSION
+      || header->byte_order != 0x01020304
+      || header->size_t_size != sizeof(size_t)
+      || header->key != key
+      || header->width != width || header->height != height
+      || header->bins != bins || pixels > width * height || nchunks > bins
+      || size != sizeof(*header) + (bins + 1 + nchunks + 1) * sizeof(size_t)
+                 + bins * sizeof(double) + pixels * sizeof(uint32_t))
+    goto error;
+
+  data = (char*)integrator->mapping + sizeof(*header);
+  integrator->width   = width;
+  integrator->height  = height;
+  integrator->bins    = bins;
+  integrator->key     = key;
+  integrator->nchunks = nchunks;
+  integrator->offsets = (size_t*)data;
+  integrator->chunks  = integrator->offsets + bins + 1;
+  integrator->q       = (double*)(integrator->chunks + nchunks + 1);
+  integrator->index   = (uint32_t*)(integrator->q + bins);
+
+  if (integrator->offsets[bins] != pixels || !integrator_check(integrator))
+    goto error;
+
+  return integrator;
+
+error:
+  saxs_image_integrator_free(integrator);
+  return NULL;
+}
+
+saxs_image_integrator*
+saxs_image_integrator_open(const char *filename,
+                           size_t width, size_t height,
+                           const saxs_image_geometry *geometry,
+                           size_t bins, saxs_image *mask) {
+  saxs_image_integrator *integrator;
+
+  integrator = saxs_image_integrator_load(filename, width, height,
+                                          geometry, bins, mask);
+  if (!integrator) {
+    integrator = saxs_image_integrator_create(width, height,
+                                              geometry, bins, mask);
+
+    /* Without a table file, the next process computes the tables again. */
+    if (integrator)
+      saxs_image_integrator_save(integrator, filename);
+  }
+
+  return integrator;
+}
+
+size_t
+saxs_image_integrator_bins(saxs_image_integrator *integrator) {
+  return integrator ? integrator->bins : 0;
+}
+
+/* The same pixels, counted from the top row as stored in memory. */
+static const uint32_t*
+integrator_index_topdown(saxs_image_integrator *integrator) {
+  const size_t n = integrator->offsets[integrator->bins];
+  const size_t width = integrator->width, height = integrator->height;
+  uint32_t *index;
+  size_t i;
+
+  pthread_mutex_lock(&integrator->lock);
+
+  index = integrator->index_topdown;
+  if (!index) {
+    index = malloc((n ? n : 1) * sizeof(uint32_t));
+
+    for (i = 0; index && i < n; ++i) {
+      const size_t y = integrator->index[i] / width;
+      const size_t x = integrator->index[i] % width;
+      index[i] = (height - y - 1) * width + x;
+    }
+
+    integrator->index_topdown = index;
+  }
+
+  pthread_mutex_unlock(&integrator->lock);
+
+  return index;
+}
+
+struct integrate_args {
+  saxs_image_integrator *integrator;
+  const void *pixels;
+  const uint32_t *index;
+  int type;
+  double *sum;
+  size_t *count;
+};
+
+/*
+ * Sums the valid pixels of a bin, i.e. those that are finite and
+ * not negative; detectors mark gaps and bad pixels by negative values.
+ */
+#define INTEGRATE_BINS(ctype)                                             \
+  for (b = b0; b < b1; ++b) {                                             \
+    const ctype *pixels = args->pixels;                                   \
+    double sum = 0.0;                                                     \
+    size_t n = 0;                                                         \
+                                                                          \
+    for (k = offsets[b]; k < offsets[b + 1]; ++k) {                       \
+      const double v = pixels[index[k]];                                  \
+      const int valid = v >= 0.0 && v < HUGE_VAL;                         \
+      sum += valid ? v : 0.0;                                             \
+      n   += valid;                                                       \
+    }                                                                     \
+                                                                          \
+    args->sum[b]   = sum;                                                 \
+    args->count[b] = n;                                                   \
+  }
+
+static void
+integrate_chunk(void *arg, size_t chunk) {
+  struct integrate_args *args = arg;
+  const saxs_image_integrator *integrator = args->integrator;
+  const size_t *offsets = integrator->offsets;
+  const uint32_t *index = args->index;
+  const size_t b0 = integrator->chunks[chunk];
+  const size_t b1 = integrator->chunks[chunk + 1];
+  size_t b, k;
+
+  SAXS_IMAGE_SWITCH_TYPE(args->type, INTEGRATE_BINS)
+}
+
+#undef INTEGRATE_BINS
+
+int
+saxs_image_integrate(saxs_image_integrator *integrator, saxs_image *image,
+                     struct saxs_curve *curve) {
+  struct integrate_args args;
+  double *buffer, *x, *y, *y_err;
+  size_t b, n;
+  int res;
+
+  assert(integrator != NULL);
+  assert(image != NULL);
+  assert(curve != NULL);
+
+  if (saxs_image_width(image) != integrator->width
+      || saxs_image_height(image) != integrator->height)
+    return EINVAL;
+
+  args.integrator = integrator;
+  args.type       = saxs_image_type(image);
+  if (saxs_image_row_stride(image) > 0) {
+    args.pixels = saxs_image_row(image, 0);
+    args.index  = integrator->index;
+  } else {
+    args.pixels = saxs_image_row(image, integrator->height - 1);
+    args.index  = integrator_index_topdown(integrator);
+    if (!args.index)
+      return ENOMEM;
+  }
+
+  /* sum, count, then the columns of the curve */
+  buffer = malloc(integrator->bins * (4 * sizeof(double) + sizeof(size_t)));
+  if (!buffer)
+    return ENOMEM;
+
+  args.sum   = buffer;
+  x          = args.sum + integrator->bins;
+  y          = x + integrator->bins;
+  y_err      = y + integrator->bins;
+  args.count = (size_t*)(y_err + integrator->bins);
+
+  if (integrator->width * integrator->height >= INTEGRATE_PARALLEL_MIN)
+    saxs_thread_pool_for(saxs_thread_pool_default(), integrator->nchunks,
+                         integrate_chunk, &args);
+  else
+    saxs_thread_pool_for(NULL, integrator->nchunks, integrate_chunk, &args);
+
+  /* Mean intensity per pixel, with Poisson errors of the counts. */
+  for (b = 0, n = 0; b < integrator->bins; ++b)
+    if (args.count[b] > 0) {
+      x[n]     = integrator->q[b];
+      y[n]     = args.sum[b] / args.count[b];
+      y_err[n] = sqrt(args.sum[b]) / args.count[b];
+      n += 1;
+    }
+
+  res = saxs_curve_add_data_array(curve, x, NULL, y, y_err, (int)n);
+
+  free(buffer);
+  return res;
+}
@@ -22,6 +22,7 @@
  */
 
 #include "saxsimage.h"
+#include "saxsimage_format.h"
 
 #include <tiffio.h>
 
@@ -29,6 +30,7 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <errno.h>
+#include <pthread.h>
 
 /*
  * Define a set of custom fields.
@@ -100,23 +102,23 @@ static void tiff_default_directory(TIFF *tiff) {
     (*tiff_parent_extender)(tiff);
 }
 
-static void tiff_initialize(void) {
-  static int first_time = 1;
-
-  if (first_time) {
-    /* Grab the inherited method and install */
-    tiff_parent_extender = TIFFSetTagExtender(tiff_default_directory);
+static void tiff_initialize_once(void) {
+  /* Grab the inherited method and install */
+  tiff_parent_extender = TIFFSetTagExtender(tiff_default_directory);
 
-    /*
-     * Even with the definition of the PILATUS specific custom
-     * fields, a bunch of warnings is printed to stdout whenever
-     * a PILATUS TIFF is opened. As the warnings are the same 
-     * for every image, they are meaningless - ignore them.
-     */
-    TIFFSetWarningHandler(NULL);
+  /*
+   * Even with the definition of the PILATUS specific custom
+   * fields, a bunch of warnings is printed to stdout whenever
+   * a PILATUS TIFF is opened. As the warnings are the same 
+   * for every image, they are meaningless - ignore them.
+   */
+  TIFFSetWarningHandler(NULL);
+}
 
-    first_time = 0;
-  }
+static void tiff_initialize(void) {
+  /* Images may be read from several threads at once. */
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, tiff_initialize_once);
 }
 
 /**************************************************************************/
@@ -158,13 +160,49 @@ static void saxs_image_tiff_read_header(saxs_image *image, TIFF *tiff,
   }
 }
 
+/*
+ * Uncompressed single-sample images in native byte order whose strips
+ * follow each other in the file can be mapped instead of read.
+ */
+static int saxs_image_tiff_map(saxs_image *image, const char *filename,
+                               TIFF *tiff, uint32 width, uint32 height,
+                               int type) {
+  const size_t rowsize = width * saxs_image_type_size(type);
+  uint16 compression;
+  uint32 rows;
+  toff_t *offsets;
+  tstrip_t strip;
+
+  if (TIFFIsTiled(tiff) || TIFFIsByteSwapped(tiff))
+    return ENOTSUP;
+
+  if (TIFFGetFieldDefaulted(tiff, TIFFTAG_COMPRESSION, &compression) == 0
+      || compression != COMPRESSION_NONE)
+    return ENOTSUP;
+
+  if (TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &rows) == 0
+      || TIFFGetField(tiff, TIFFTAG_STRIPOFFSETS, &offsets) == 0)
+    return ENOTSUP;
+
+  if (rows > height)
+    rows = height;
+
+  for (strip = 1; strip < TIFFNumberOfStrips(tiff); ++strip)
+    if (offsets[strip] != offsets[0] + (toff_t)strip * rows * rowsize)
+      return ENOTSUP;
+
+  return saxs_image_map(image, filename, offsets[0], width, height,
+                        1, 1, type, 1);
+}
+
 int saxs_image_tiff_read(saxs_image *image, const char *filename, size_t frame) {
   TIFF *tiff;
   tstrip_t strip;
-  tdata_t *data;
+  tdata_t *data = NULL;
 
   uint16 bpp, spp, format;
   uint32 width, height, x, y;
+  int type, res;
 
   /* TIFF images have only one frame */
   if (frame != 1)
@@ -203,6 +241,38 @@ int saxs_image_tiff_read(saxs_image *image, const char *filename, size_t frame)
       format = SAMPLEFORMAT_VOID;
   }
 
+  if (spp == 1) {
+    if (format == SAMPLEFORMAT_UINT && bpp == 16)         /* MAR165 CCD */
+      type = SAXS_IMAGE_TYPE_UINT16;
+    else if (format == SAMPLEFORMAT_INT && bpp == 16)
+      type = SAXS_IMAGE_TYPE_INT16;
+    else if (format == SAMPLEFORMAT_UINT && bpp == 32)
+      type = SAXS_IMAGE_TYPE_UINT32;
+    else if (format == SAMPLEFORMAT_INT && bpp == 32)     /* PILATUS */
+      type = SAXS_IMAGE_TYPE_INT32;
+    else if (format == SAMPLEFORMAT_IEEEFP && bpp == 32)
+      type = SAXS_IMAGE_TYPE_FLOAT;
+    else if (format == SAMPLEFORMAT_IEEEFP && bpp == 64)
+      type = SAXS_IMAGE_TYPE_DOUBLE;
+    else
+      type = 0;
+
+  } else if (spp == 3)
+    type = SAXS_IMAGE_TYPE_FLOAT;
+  else
+    type = 0;
+
+  if (type == 0) {
+    res = ENOENT;
+    goto out;
+  }
+
+  if (spp == 1
+      && saxs_image_tiff_map(image, filename, tiff, width, height, type) == 0) {
+    res = 0;
+    goto out;
+  }
+
   /*
    * bpp/CHAR_BIT turns the product into a signed value;
    * memory requests for (very) large images may then be
@@ -217,59 +287,43 @@ int saxs_image_tiff_read(saxs_image *image, const char *filename, size_t frame)
                          ((char*)data) + strip * TIFFStripSize(tiff),
                          (tsize_t) - 1);
 
-  saxs_image_set_size(image, width, height, 1, 1);
+  res = saxs_image_resize(image, width, height, 1, 1, type);
+  if (res != 0)
+    goto out;
 
   if (spp == 1) {
-    /*
-     * Sometimes C++-style templates would come in handy.
-     * Instead we need to make do with the preprocessor;
-     * add cases as needed.
-     */
-#define SET_VALUE(type)                                               \
-  do {                                                                \
-    for (x = 0; x < width; ++x)                                       \
-      for (y = 0; y < height; ++y)                                    \
-        saxs_image_set_value(image, x, height - y - 1,                \
-                             (double)(*((type*)data + y * width + x))); \
-  } while(0)
+    /* The strips hold rows of the native pixel type, top-down. */
+    saxs_image_set_pixels(image, data, type, SAXS_IMAGE_LAYOUT_TOPDOWN);
 
-    if (format == SAMPLEFORMAT_UINT && bpp == 16)         /* MAR165 CCD */
-      SET_VALUE(uint16);
-    else if (format == SAMPLEFORMAT_INT && bpp == 16)
-      SET_VALUE(int16);
-    else if (format == SAMPLEFORMAT_UINT && bpp == 32)
-      SET_VALUE(uint32);
-    else if (format == SAMPLEFORMAT_INT && bpp == 32)     /* PILATUS */
-      SET_VALUE(int32);
-    else if (format == SAMPLEFORMAT_IEEEFP && bpp == 32)
-      SET_VALUE(float);
-    else if (format == SAMPLEFORMAT_IEEEFP && bpp == 64)
-      SET_VALUE(double);
-    else
-      return ENOENT;
+  } else if (spp == 3) {
+    float *row = malloc(width * sizeof(float));
+    if (!row) {
+      res = ENOMEM;
+      goto out;
+    }
 
-#undef SET_VALUE
+    for (y = 0; y < height; ++y) {
+      unsigned char *rgb = ((unsigned char *)data) + y * width * 3;
+      for (x = 0; x < width; ++x, rgb += 3)
+        row[x] = (rgb[0]*11 + rgb[1]*16 + rgb[2]*5)/32.0f;
 
-  } else if (spp == 3) {
-    for (x = 0; x < width; ++x) {
-      for (y = 0; y < height; ++y) {
-        unsigned char *rgb = ((unsigned char *)data) + (y * width + x)*3;
-        int r=rgb[0], g=rgb[1], b=rgb[2];
-        saxs_image_set_value(image, x, height - y - 1, (r*11 + g*16 + b*5)/32.0);
-      }
+      saxs_image_set_row(image, height - y - 1, row, SAXS_IMAGE_TYPE_FLOAT);
     }
+
+    free(row);
   }
 
+out:
   TIFFClose(tiff);
   _TIFFfree(data);
 
-  return 0;
+  return res;
 }
 
 int saxs_image_tiff_write(saxs_image *image, const char *filename) {
   TIFF *tiff;
   tstrip_t strip;
-  uint32 width, height, x, y;
+  uint32 width, height, y;
   int *data;
 
   tiff_initialize();
@@ -289,9 +343,9 @@ int saxs_image_tiff_write(saxs_image *image, const char *filename) {
   height = saxs_image_height(image);
 
   data = _TIFFmalloc(width * height * 4 * 1);
-  for (x = 0; x < width; ++x)
-    for (y = 0; y < height; ++y)
-      *(data + y * width + x) = saxs_image_value(image, x, height - y - 1);
+  for (y = 0; y < height; ++y)
+    saxs_image_get_row(image, height - y - 1, data + y * width,
+                       SAXS_IMAGE_TYPE_INT32);
 
   /*
    * Tags need to be sorted in ascending order.
@@ -326,7 +380,8 @@ int saxs_image_tiff_write(saxs_image *image, const char *filename) {
 saxs_image_format*
 saxs_image_format_tiff(const char *filename, const char *format) {
   static saxs_image_format image_tiff = { saxs_image_tiff_read,
-                                          saxs_image_tiff_write };
+                                          saxs_image_tiff_write,
+                                          NULL  /* refresh */ };
 
   if (!compare_format(format, "tiff")
       || !compare_format(suffix(filename), "tiff")
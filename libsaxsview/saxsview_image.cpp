@@ -862,15 +862,110 @@ void SaxsviewMask::setVisible(bool visible) {
 
 class SaxsviewFrameData::Private {
 public:
+  Private() : data(0L), pixels(0L), stride(0), type(0), width(0), height(0),
+              reduction(MaximumReduction), level(0) {}
+
+  void setData(saxs_image *image);
+  void buildPyramid(int levels);
+
   saxs_image *data;
   QwtInterval range, selectedRange;
+
+  /*
+   * value() is called for every pixel on each replot; keep the
+   * raw pixels at hand instead of going through saxs_image_value().
+   * Pixels mapped from a file may be stored top to bottom, hence
+   * row 0 and a signed stride rather than a contiguous block.
+   */
+  const char *pixels;
+  ptrdiff_t stride;
+  int type, width, height;
+
+  /*
+   * Zoomed out, value() is called for one point per screen pixel
+   * only. Instead of sampling every n-th pixel, which is slow for
+   * large frames and hides single hot pixels, read from a pyramid
+   * of reduced copies, each half the size of the one before. Level
+   * n covers 2^n x 2^n pixels per value; pyramid[n - 1] holds it.
+   * Levels are computed when first needed and dropped if the frame
+   * changes.
+   */
+  struct Level {
+    int width, height;
+    QVector<float> values;
+  };
+
+  Reduction reduction;
+  QVector<Level> pyramid;
+  int level;
 };
 
+void SaxsviewFrameData::Private::setData(saxs_image *image) {
+  pyramid.clear();
+  level  = 0;
+  data   = image;
+  height = image ? saxs_image_height(image) : 0;
+  pixels = height > 0 ? (const char*)saxs_image_row(image, 0) : 0L;
+  stride = height > 0 ? saxs_image_row_stride(image) : 0;
+  type   = image ? saxs_image_type(image) : 0;
+  width  = image ? saxs_image_width(image) : 0;
+}
+
+void SaxsviewFrameData::Private::buildPyramid(int levels) {
+  QVector<double> rows(2 * width);
+
+  while (pyramid.size() < levels) {
+    const int n = pyramid.size();
+    const int sourceWidth = n > 0 ? pyramid[n - 1].width : width;
+    const int sourceHeight = n > 0 ? pyramid[n - 1].height : height;
+
+    // Nothing left to reduce.
+    if (sourceWidth == 1 && sourceHeight == 1)
+      break;
+
+    Level next;
+    next.width  = (sourceWidth + 1) / 2;
+    next.height = (sourceHeight + 1) / 2;
+    next.values.resize(next.width * next.height);
+
+    for (int y = 0; y < next.height; ++y) {
+      const int y1 = qMin(2 * y + 1, sourceHeight - 1);
+      const double *row0 = rows.constData();
+      const double *row1 = rows.constData() + width;
+
+      if (n == 0) {
+        saxs_image_get_row(data, 2 * y, rows.data(), SAXS_IMAGE_TYPE_DOUBLE);
+        saxs_image_get_row(data, y1, rows.data() + width, SAXS_IMAGE_TYPE_DOUBLE);
+      } else {
+        const float *source = pyramid[n - 1].values.constData();
+        for (int x = 0; x < sourceWidth; ++x) {
+          rows[x]         = source[2 * y * sourceWidth + x];
+          rows[width + x] = source[y1 * sourceWidth + x];
+        }
+      }
+
+      float *target = next.values.data() + y * next.width;
+      for (int x = 0; x < next.width; ++x) {
+        const int x1 = qMin(2 * x + 1, sourceWidth - 1);
+        const double a = row0[2 * x], b = row0[x1], c = row1[2 * x], d = row1[x1];
+
+        if (reduction == MaximumReduction)
+          target[x] = qMax(qMax(a, b), qMax(c, d));
+        else
+          target[x] = 0.25 * (a + b + c + d);
+      }
+    }
+
+    pyramid.append(next);
+  }
+}
+
 SaxsviewFrameData::SaxsviewFrameData(const QString& fileName)
  : QwtRasterData(), p(new Private) {
 
-  p->data = saxs_image_create();
+  p->setData(saxs_image_create());
   if (saxs_image_read(p->data, qPrintable(fileName), 0L) == 0) {
+    p->setData(p->data);
 
     setInterval(Qt::XAxis, QwtInterval(0.0, saxs_image_width(p->data) - 1.0));
     setInterval(Qt::YAxis, QwtInterval(0.0, saxs_image_height(p->data) - 1.0));
@@ -879,20 +974,34 @@ SaxsviewFrameData::SaxsviewFrameData(const QString& fileName)
 
   } else {
     saxs_image_free(p->data);
-    p->data = 0L;
+    p->setData(0L);
+  }
+}
+
+SaxsviewFrameData::SaxsviewFrameData(saxs_image *image)
+ : QwtRasterData(), p(new Private) {
+
+  p->setData(image);
+  if (p->data) {
+    setInterval(Qt::XAxis, QwtInterval(0.0, saxs_image_width(p->data) - 1.0));
+    setInterval(Qt::YAxis, QwtInterval(0.0, saxs_image_height(p->data) - 1.0));
+    setInterval(Qt::ZAxis, QwtInterval(saxs_image_value_min(p->data),
+                                       saxs_image_value_max(p->data)));
   }
 }
 
 SaxsviewFrameData::SaxsviewFrameData(const SaxsviewFrameData& other)
   : QwtRasterData(), p(new Private) {
-  p->data = other.p->data;
+  p->setData(other.p->data);
 }
 
 SaxsviewFrameData::SaxsviewFrameData(const QSize& size)
   : QwtRasterData(), p(new Private) {
 
-  p->data = saxs_image_create();
-  saxs_image_set_size(p->data, size.width(), size.height(), 1, 1);
+  saxs_image *image = saxs_image_create();
+  saxs_image_resize(image, size.width(), size.height(), 1, 1,
+                    SAXS_IMAGE_TYPE_UINT8);
+  p->setData(image);
 
   setInterval(Qt::XAxis, QwtInterval(0.0, size.width() - 1.0));
   setInterval(Qt::YAxis, QwtInterval(0.0, size.height() - 1.0));
@@ -922,12 +1031,116 @@ void SaxsviewFrameData::setMaxValue(double x) {
                                      qMin(x, saxs_image_value_max(p->data))));
 }
 
+SaxsviewFrameData::Reduction SaxsviewFrameData::reduction() const {
+  return p->reduction;
+}
+
+void SaxsviewFrameData::setReduction(Reduction reduction) {
+  if (reduction != p->reduction) {
+    p->reduction = reduction;
+    p->pyramid.clear();
+  }
+}
+
+int SaxsviewFrameData::frameCount() const {
+  return saxs_image_frame_count(p->data);
+}
+
+int SaxsviewFrameData::currentFrame() const {
+  return saxs_image_current_frame(p->data);
+}
+
+bool SaxsviewFrameData::setCurrentFrame(int frame) {
+  if (!p->data || frame < 1
+      || saxs_image_read_frame(p->data, frame) != 0)
+    return false;
+
+  // Same size, but other pixels.
+  p->setData(p->data);
+  return true;
+}
+
+bool SaxsviewFrameData::refresh() {
+  const int count = frameCount();
+  return p->data && saxs_image_refresh(p->data) == 0 && frameCount() > count;
+}
+
+void SaxsviewFrameData::initRaster(const QRectF& area, const QSize& raster) {
+  QwtRasterData::initRaster(area, raster);
+
+  // Frame pixels per screen pixel, in the direction reduced least.
+  const double scale = qMin(area.width() / qMax(raster.width(), 1),
+                            area.height() / qMax(raster.height(), 1));
+
+  int level = 0;
+  while (level < 30 && scale >= (2 << level))
+    ++level;
+
+  if (level > 0 && p->data) {
+    p->buildPyramid(level);
+    p->level = qMin(level, p->pyramid.size());
+  } else
+    p->level = 0;
+}
+
+void SaxsviewFrameData::discardRaster() {
+  p->level = 0;
+  QwtRasterData::discardRaster();
+}
+
 double SaxsviewFrameData::value(double x, double y) const {
-  return saxs_image_value(p->data, (int)x, (int)y);
+  const int ix = (int)x, iy = (int)y;
+  if (!p->pixels || ix < 0 || ix >= p->width || iy < 0 || iy >= p->height)
+    return 0.0;
+
+  if (p->level > 0) {
+    const Private::Level& level = p->pyramid[p->level - 1];
+    return level.values[(iy >> p->level) * level.width + (ix >> p->level)];
+  }
+
+  const char *row = p->pixels + iy * p->stride;
+  switch (p->type) {
+    case SAXS_IMAGE_TYPE_UINT8:  return ((const uint8_t*)row)[ix];
+    case SAXS_IMAGE_TYPE_INT16:  return ((const int16_t*)row)[ix];
+    case SAXS_IMAGE_TYPE_UINT16: return ((const uint16_t*)row)[ix];
+    case SAXS_IMAGE_TYPE_INT32:  return ((const int32_t*)row)[ix];
+    case SAXS_IMAGE_TYPE_UINT32: return ((const uint32_t*)row)[ix];
+    case SAXS_IMAGE_TYPE_FLOAT:  return ((const float*)row)[ix];
+    case SAXS_IMAGE_TYPE_DOUBLE: return ((const double*)row)[ix];
+  }
+
+  return 0.0;
 }
 
 void SaxsviewFrameData::setValue(double x, double y, double value) {
   saxs_image_set_value(p->data, (int)x, (int)y, value);
+  p->pyramid.clear();
+  p->level = 0;
+}
+
+bool SaxsviewFrameData::row(int y, double *values) const {
+  return p->data
+      && saxs_image_get_row(p->data, y, values, SAXS_IMAGE_TYPE_DOUBLE) == 0;
+}
+
+bool SaxsviewFrameData::setRow(int y, const double *values) {
+  p->pyramid.clear();
+  p->level = 0;
+  return p->data
+      && saxs_image_set_row(p->data, y, values, SAXS_IMAGE_TYPE_DOUBLE) == 0;
+}
+
+bool SaxsviewFrameData::regionSum(const QRect& rect, double *sum, int *count) const {
+  size_t valid;
+
+  const QRect r = rect.intersected(QRect(0, 0, p->width, p->height));
+  if (!p->data || r.isEmpty()
+      || saxs_image_roi_sum(p->data, r.x(), r.y(), r.width(), r.height(),
+                            sum, &valid) != 0)
+    return false;
+
+  *count = valid;
+  return true;
 }
 
 bool SaxsviewFrameData::save(const QString& fileName) const {
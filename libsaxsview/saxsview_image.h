@@ -33,6 +33,8 @@ class SaxsviewFrame;
 class SaxsviewMask;
 class SaxsviewFrameData;
 
+struct saxs_image;
+
 
 class SaxsviewImage : public QwtPlot {
   Q_OBJECT
@@ -197,12 +199,25 @@ private:
 
 class SaxsviewFrameData : public QwtRasterData {
 public:
+  /**
+   * How frame pixels are combined when zoomed out so far that several
+   * of them fall onto one screen pixel. The maximum, the default, keeps
+   * single hot pixels visible.
+   */
+  enum Reduction {
+    MaximumReduction,
+    MeanReduction
+  };
+
   /** An empty frame of @a size. */
   explicit SaxsviewFrameData(const QSize& size);
 
   /** A frame fill with data from @a fileName. */
   explicit SaxsviewFrameData(const QString& fileName);
 
+  /** A frame of an @a image read before; takes ownership. */
+  explicit SaxsviewFrameData(struct saxs_image *image);
+
   SaxsviewFrameData(const SaxsviewFrameData& other);
   ~SaxsviewFrameData();
 
@@ -211,9 +226,41 @@ public:
   void setMinValue(double x);
   void setMaxValue(double x);
 
+  Reduction reduction() const;
+  void setReduction(Reduction reduction);
+
+  /** The number of frames in the file, and the one shown, from 1. */
+  int frameCount() const;
+  int currentFrame() const;
+
+  /**
+   * Show another frame of the file; the range of values, and with it
+   * the colors, stay as they are.
+   */
+  bool setCurrentFrame(int frame);
+
+  /**
+   * Check the file for frames added since it was read, e.g. by a
+   * detector still writing to it; true if there are new ones.
+   */
+  bool refresh();
+
+  void initRaster(const QRectF& area, const QSize& raster);
+  void discardRaster();
+
   double value(double x, double y) const;
   void setValue(double x, double y, double value);
 
+  /**
+   * Sum and number of the valid pixels within @a rect, in pixels;
+   * takes constant time once the first region of a frame was queried.
+   */
+  bool regionSum(const QRect& rect, double *sum, int *count) const;
+
+  /** Copy row @a y, width() values, to or from @a values. */
+  bool row(int y, double *values) const;
+  bool setRow(int y, const double *values);
+
   bool save(const QString& fileName) const;
 
 private:
@@ -54,6 +54,7 @@ public:
   QAction *actionMaskByThreshold;
   QAction *actionMaskAddPoint, *actionMaskAddPolygon;
   QAction *actionMaskRemovePoint, *actionMaskRemovePolygon;
+  QAction *actionRegionStatistics;
 
   // "Window"-menu
   QAction *actionPreviousPlot, *actionNextPlot, *actionCascadePlots;
@@ -243,6 +244,13 @@ void SVImageMainWindow::SVImageMainWindowPrivate::setupActions() {
   connect(actionMaskRemovePolygon, SIGNAL(toggled(bool)),
           mw, SLOT(setMaskRemovePolygonEnabled(bool)));
 
+  actionRegionStatistics = new QAction("Region statistics", mw);
+  actionRegionStatistics->setCheckable(true);
+  actionRegionStatistics->setChecked(false);
+  actionRegionStatistics->setEnabled(false);
+  connect(actionRegionStatistics, SIGNAL(toggled(bool)),
+          mw, SLOT(setRegionStatisticsEnabled(bool)));
+
   //
   // "Window"-menu
   //
@@ -289,6 +297,7 @@ void SVImageMainWindow::SVImageMainWindowPrivate::setupActions() {
   actionGroupPlotPicker->addAction(actionMaskAddPolygon);
   actionGroupPlotPicker->addAction(actionMaskRemovePoint);
   actionGroupPlotPicker->addAction(actionMaskRemovePolygon);
+  actionGroupPlotPicker->addAction(actionRegionStatistics);
 }
 
 void SVImageMainWindow::SVImageMainWindowPrivate::setupUi() {
@@ -360,6 +369,7 @@ void SVImageMainWindow::SVImageMainWindowPrivate::setupMenus() {
   menuMaskTools->addAction(actionMaskAddPolygon);
   menuMaskTools->addAction(actionMaskRemovePoint);
   menuMaskTools->addAction(actionMaskRemovePolygon);
+  menuTools->addAction(actionRegionStatistics);
   menuBar->addMenu(menuTools);
 
   menuView = new QMenu("&Views", mw);
@@ -391,6 +401,7 @@ void SVImageMainWindow::SVImageMainWindowPrivate::setupToolbars() {
   mainToolBar->addAction(actionZoomFit);
   mainToolBar->addAction(actionZoom);
   mainToolBar->addAction(actionMove);
+  mainToolBar->addAction(actionRegionStatistics);
 
   maskToolBar = mw->addToolBar("Mask Toolbar");
   maskToolBar->addAction(actionMaskNew);
@@ -483,6 +494,8 @@ void SVImageMainWindow::load(const QString& fileName) {
 
   connect(w, SIGNAL(destroyed(QObject*)),
           this, SLOT(subWindowDestroyed(QObject*)));
+  connect(w, SIGNAL(loaded()),
+          this, SLOT(subWindowLoaded()));
 
   p->mdiArea->addSubWindow(w);
 
@@ -610,6 +623,11 @@ void SVImageMainWindow::setMaskRemovePolygonEnabled(bool on) {
     currentSubWindow()->setMaskRemovePolygonEnabled(on);
 }
 
+void SVImageMainWindow::setRegionStatisticsEnabled(bool on) {
+  if (currentSubWindow())
+    currentSubWindow()->setRegionStatisticsEnabled(on);
+}
+
 
 
 void SVImageMainWindow::about() {
@@ -695,6 +713,7 @@ void SVImageMainWindow::subWindowActivated(QMdiSubWindow *w) {
     p->actionMaskAddPolygon->setChecked(subWindow->maskAddPolygonEnabled());
     p->actionMaskRemovePoint->setChecked(subWindow->maskRemovePointsEnabled());
     p->actionMaskRemovePolygon->setChecked(subWindow->maskRemovePolygonEnabled());
+    p->actionRegionStatistics->setChecked(subWindow->regionStatisticsEnabled());
   }
 
   //
@@ -722,11 +741,21 @@ void SVImageMainWindow::subWindowActivated(QMdiSubWindow *w) {
   p->actionMaskAddPolygon->setEnabled(on);
   p->actionMaskRemovePoint->setEnabled(on);
   p->actionMaskRemovePolygon->setEnabled(on);
+  p->actionRegionStatistics->setEnabled(on);
 }
 
 void SVImageMainWindow::subWindowDestroyed(QObject*) {
 }
 
+void SVImageMainWindow::subWindowLoaded() {
+  //
+  // Images are read in the background; once done, the property
+  // browser needs to pick up the values of the new frame.
+  //
+  if (sender() == currentSubWindow())
+    p->propertyDock->subWindowActivated(currentSubWindow());
+}
+
 bool SVImageMainWindow::eventFilter(QObject *o, QEvent *e) {
   //
   // The Mac Finder does not pass the filename as an argument on double-click
@@ -60,6 +60,7 @@ public slots:
   void setMaskAddPolygonEnabled(bool);
   void setMaskRemovePointsEnabled(bool);
   void setMaskRemovePolygonEnabled(bool);
+  void setRegionStatisticsEnabled(bool);
 
   void about();
 
@@ -69,6 +70,7 @@ private slots:
   void setActiveSubWindow(QWidget*);
   void subWindowActivated(QMdiSubWindow*);
   void subWindowDestroyed(QObject*);
+  void subWindowLoaded();
 
 protected:
   bool eventFilter(QObject*, QEvent*);
@@ -27,6 +27,9 @@
 #include "saxsview_config.h"
 #include "saxsview_image.h"
 
+// libsaxsimage
+#include "saxsimage.h"
+
 // external/qwt
 #include "qwt_picker_machine.h"
 #include "qwt_plot_canvas.h"
@@ -62,6 +65,47 @@ private:
 };
 
 
+//
+// Shows the sum and mean of the pixels in the rectangle being
+// dragged, updated as it changes; these come from the summed-area
+// tables of the frame and take the same time for any size.
+//
+class RegionPicker : public QwtPlotPicker {
+public:
+  RegionPicker(SaxsviewFrame *f, QWidget *canvas)
+   : QwtPlotPicker(canvas), frame(f) {
+  }
+
+  QwtText trackerTextF(const QPointF &pos) const {
+    const SaxsviewFrameData *data = dynamic_cast<const SaxsviewFrameData*>(frame->data());
+    if (!data || pickedPoints().isEmpty())
+      return QwtText();
+
+    // Both corner pixels are part of the region.
+    const QPointF start = invTransform(pickedPoints().first());
+    const QRect region(QPoint(qFloor(qMin(start.x(), pos.x())),
+                              qFloor(qMin(start.y(), pos.y()))),
+                       QPoint(qFloor(qMax(start.x(), pos.x())),
+                              qFloor(qMax(start.y(), pos.y()))));
+
+    double sum;
+    int count;
+    if (!data->regionSum(region, &sum, &count))
+      return QwtText();
+
+    static const QString format = "%1x%2 pixels, sum=%3, mean=%4";
+    QwtText text(format.arg(region.width()).arg(region.height())
+                       .arg(sum, 0, 'g', 8)
+                       .arg(count > 0 ? sum / count : 0.0, 0, 'g', 6));
+    text.setBackgroundBrush(QBrush(QColor(255, 255, 255, 192)));
+    return text;
+  }
+
+private:
+  SaxsviewFrame *frame;
+};
+
+
 class SVImageSubWindow::Private {
 public:
   Private();
@@ -72,6 +116,10 @@ public:
   void setupFilesystemModel(SVImageSubWindow *w);
 
   void setFilePath(const QString&);
+  void prefetch(SVImageSubWindow *w);
+  void clearPrefetch();
+  void release(saxs_image_request *request);
+  void releaseFinished();
 
   QString filePath;
 
@@ -82,20 +130,63 @@ public:
 
   QwtPlotPicker *addPointPicker, *addPolygonPicker;
   QwtPlotPicker *removePointPicker, *removePolygonPicker;
+  QwtPlotPicker *regionPicker;
 
   bool watchLatest;
+  QTimer *watchTimer;
   QFileSystemModel *model;
   QModelIndex rootIndex;
+
+  saxs_image_request *request;
+
+  //
+  // Requests not needed anymore. A read already running can not be
+  // stopped and still calls back into the window when done, they are
+  // kept until then.
+  //
+  QList<saxs_image_request*> released;
+
+  //
+  // Files next to the current one in the direction of navigation,
+  // read ahead in the background. A file modified since is read again.
+  //
+  struct Prefetch {
+    saxs_image_request *request;
+    QDateTime lastModified;
+  };
+  QMap<QString, Prefetch> prefetched;
+  int direction;
 };
 
 SVImageSubWindow::Private::Private()
  : image(0L), frame(0L), mask(0L), tracker(0L),
    addPointPicker(0L), addPolygonPicker(0L),
-   removePointPicker(0L), removePolygonPicker(0L),
-   watchLatest(false), model(0L) {
+   removePointPicker(0L), removePolygonPicker(0L), regionPicker(0L),
+   watchLatest(false), watchTimer(0L), model(0L), request(0L), direction(1) {
 }
 
 SVImageSubWindow::Private::~Private() {
+  //
+  // The completion callback may still be about to notify the
+  // window, wait for it before the window is gone.
+  //
+  if (request) {
+    saxs_image_request_cancel(request);
+    saxs_image_request_wait(request);
+    saxs_image_request_free(request);
+  }
+
+  foreach (const Prefetch& prefetch, prefetched) {
+    saxs_image_request_cancel(prefetch.request);
+    saxs_image_request_wait(prefetch.request);
+    saxs_image_request_free(prefetch.request);
+  }
+
+  foreach (saxs_image_request *request, released) {
+    saxs_image_request_wait(request);
+    saxs_image_request_free(request);
+  }
+
   delete model;
 }
 
@@ -149,6 +240,12 @@ void SVImageSubWindow::Private::setupPicker(SVImageSubWindow *w) {
   removePolygonPicker->setEnabled(false);
   connect(removePolygonPicker, SIGNAL(selected(const QVector<QPointF>&)),
           w, SLOT(removeSelectionFromMask(const QVector<QPointF>&)));
+
+  regionPicker = new RegionPicker(frame, image->canvas());
+  regionPicker->setStateMachine(new QwtPickerDragRectMachine);
+  regionPicker->setTrackerMode(QwtPicker::ActiveOnly);
+  regionPicker->setRubberBand(QwtPicker::RectRubberBand);
+  regionPicker->setEnabled(false);
 }
 
 void SVImageSubWindow::Private::setupFilesystemModel(SVImageSubWindow *w) {
@@ -178,6 +275,12 @@ SVImageSubWindow::SVImageSubWindow(QWidget *parent)
   p->setupUi(this);
   p->setupPicker(this);
   p->setupFilesystemModel(this);
+
+  // Files still being written may grow by frames, see watchFrames().
+  p->watchTimer = new QTimer(this);
+  p->watchTimer->setInterval(500);
+  connect(p->watchTimer, SIGNAL(timeout()),
+          this, SLOT(watchFrames()));
 }
 
 SVImageSubWindow::~SVImageSubWindow() {
@@ -228,27 +331,152 @@ bool SVImageSubWindow::maskRemovePolygonEnabled() const {
   return p->removePolygonPicker->isEnabled();
 }
 
+bool SVImageSubWindow::regionStatisticsEnabled() const {
+  return p->regionPicker->isEnabled();
+}
+
+//
+// Called from a worker thread of libsaxsimage, forward the
+// notification to the thread of the window.
+//
+static void loadCallback(saxs_image_request*, int, void *userdata) {
+  QMetaObject::invokeMethod(static_cast<QObject*>(userdata),
+                            "loadFinished", Qt::QueuedConnection);
+}
+
+void SVImageSubWindow::Private::prefetch(SVImageSubWindow *w) {
+  static const int count = 2;
+
+  // When watching, the next file is yet to be written.
+  if (!rootIndex.isValid() || watchLatest) {
+    clearPrefetch();
+    return;
+  }
+
+  QMap<QString, Prefetch> wanted;
+  const int row = model->index(filePath).row();
+  for (int i = 1; i <= count; ++i) {
+    QModelIndex index = model->index(row + i * direction, 0, rootIndex);
+    if (!index.isValid())
+      break;
+
+    QFileInfo fileInfo = model->fileInfo(index);
+    if (!fileInfo.isFile())
+      continue;
+
+    const QString path = fileInfo.filePath();
+    if (prefetched.contains(path)
+        && prefetched[path].lastModified == fileInfo.lastModified()) {
+      wanted.insert(path, prefetched.take(path));
+      continue;
+    }
+
+    Prefetch prefetch;
+    prefetch.request = saxs_image_read_async(qPrintable(path), 0L, 1,
+                                             loadCallback, w);
+    prefetch.lastModified = fileInfo.lastModified();
+    if (prefetch.request)
+      wanted.insert(path, prefetch);
+  }
+
+  // Whatever is left is not needed anymore.
+  clearPrefetch();
+  prefetched = wanted;
+}
+
+void SVImageSubWindow::Private::clearPrefetch() {
+  foreach (const Prefetch& prefetch, prefetched)
+    release(prefetch.request);
+  prefetched.clear();
+}
+
+//
+// Requests call back into the window until completed, those no longer
+// needed are kept until then.
+//
+void SVImageSubWindow::Private::release(saxs_image_request *request) {
+  saxs_image_request_cancel(request);
+  released.append(request);
+  releaseFinished();
+}
+
+void SVImageSubWindow::Private::releaseFinished() {
+  QList<saxs_image_request*>::iterator i = released.begin();
+  while (i != released.end()) {
+    if (saxs_image_request_poll(*i)) {
+      // Completed, the callback returns right away if not already.
+      saxs_image_request_wait(*i);
+      saxs_image_request_free(*i);
+      i = released.erase(i);
+
+    } else
+      ++i;
+  }
+}
+
 bool SVImageSubWindow::load(const QString& fileName) {
   QFileInfo fileInfo(fileName);
   if (!fileInfo.exists())
     return false;
 
-  setCursor(Qt::WaitCursor);
+  //
+  // Read in the background, the image currently shown stays until the
+  // new one is available. A load still pending, e.g. when stepping
+  // through a directory quickly, is superseded.
+  //
+  if (p->request)
+    p->release(p->request);
 
-  p->frame->setData(new SaxsviewFrameData(fileName));
-  p->image->setFrame(p->frame);
+  const QString filePath = fileInfo.filePath();
+  if (p->prefetched.contains(filePath)
+      && p->prefetched[filePath].lastModified == fileInfo.lastModified()) {
+    p->request = p->prefetched.take(filePath).request;
 
-  setWindowTitle(QString("%1 - %2").arg(fileName)
-                                   .arg(qApp->applicationName()));
+    // Done already, there will be no further callback.
+    if (saxs_image_request_poll(p->request))
+      QMetaObject::invokeMethod(this, "loadFinished", Qt::QueuedConnection);
 
+  } else
+    p->request = saxs_image_read_async(qPrintable(fileName), 0L, 1,
+                                       loadCallback, this);
+  if (!p->request)
+    return false;
+
+  setCursor(Qt::BusyCursor);
+
+  // Navigation continues from the requested file.
   p->setFilePath(fileInfo.filePath());
 
+  return true;
+}
+
+void SVImageSubWindow::loadFinished() {
+  p->releaseFinished();
+
+  if (!p->request || !saxs_image_request_poll(p->request))
+    return;
+
+  saxs_image *data = saxs_image_request_take(p->request);
+  saxs_image_request_free(p->request);
+  p->request = 0L;
+
   unsetCursor();
 
+  if (!data)
+    return;
+
+  p->frame->setData(new SaxsviewFrameData(data));
+  p->image->setFrame(p->frame);
+
+  setWindowTitle(QString("%1 - %2").arg(p->filePath)
+                                   .arg(qApp->applicationName()));
+
   // Add a new, empty, mask of the right size.
   newMask();
 
-  return true;
+  p->prefetch(this);
+
+  emit loaded();
 }
 
 void SVImageSubWindow::reload() {
@@ -285,6 +513,7 @@ void SVImageSubWindow::setUpperThreshold(double threshold) {
 }
 
 void SVImageSubWindow::goFirst() {
+  p->direction = 1;
   if (p->rootIndex.isValid()) {
     int firstRow = 0;
     QModelIndex newIndex = p->model->index(firstRow, 0, p->rootIndex);
@@ -294,6 +523,7 @@ void SVImageSubWindow::goFirst() {
 }
 
 void SVImageSubWindow::goPrevious() {
+  p->direction = -1;
   if (p->rootIndex.isValid()) {
     QModelIndex currentIndex = p->model->index(p->filePath);
     int previousRow = currentIndex.row() - 1;
@@ -306,6 +536,7 @@ void SVImageSubWindow::goPrevious() {
 }
 
 void SVImageSubWindow::goNext() {
+  p->direction = 1;
   if (p->rootIndex.isValid()) {
     QModelIndex currentIndex = p->model->index(p->filePath);
     int nextRow = currentIndex.row() + 1;
@@ -318,6 +549,7 @@ void SVImageSubWindow::goNext() {
 }
 
 void SVImageSubWindow::goLast() {
+  p->direction = -1;
   if (p->rootIndex.isValid()) {
     int lastRow = p->model->rowCount(p->rootIndex) - 1;
     QModelIndex newIndex = p->model->index(lastRow, 0, p->rootIndex);
@@ -329,8 +561,11 @@ void SVImageSubWindow::goLast() {
 void SVImageSubWindow::setWatchLatest(bool on) {
   if (p->watchLatest != on) {
     p->watchLatest = on;
-    if (on)
+    if (on) {
       goLast();
+      p->watchTimer->start();
+    } else
+      p->watchTimer->stop();
   }
 }
 
@@ -441,13 +676,17 @@ void SVImageSubWindow::setMaskByThreshold() {
     SaxsviewFrameData *frameData = (SaxsviewFrameData*)p->frame->data();
     SaxsviewFrameData *maskData = (SaxsviewFrameData*)p->mask->data();
 
+    const int width = p->frame->size().width();
+    const int height = p->frame->size().height();
+    QVector<double> values(width);
+
     setCursor(Qt::WaitCursor);
-    for (int x = 0; x < p->frame->size().width(); ++x)
-      for (int y = 0; y < p->frame->size().height(); ++y)
-        if (frameData->value(x, y) < min || frameData->value(x, y) > max)
-          maskData->setValue(x, y, 1.0);
-        else
-          maskData->setValue(x, y, 0.0);
+    for (int y = 0; y < height; ++y) {
+      frameData->row(y, values.data());
+      for (int x = 0; x < width; ++x)
+        values[x] = (values[x] < min || values[x] > max) ? 1.0 : 0.0;
+      maskData->setRow(y, values.data());
+    }
     unsetCursor();
 
     p->mask->setModified(true);
@@ -471,6 +710,10 @@ void SVImageSubWindow::setMaskRemovePolygonEnabled(bool on) {
   p->removePolygonPicker->setEnabled(on);
 }
 
+void SVImageSubWindow::setRegionStatisticsEnabled(bool on) {
+  p->regionPicker->setEnabled(on);
+}
+
 void SVImageSubWindow::closeEvent(QCloseEvent *e) {
   if (maybeSaveMask())
     e->accept();
@@ -483,6 +726,23 @@ void SVImageSubWindow::rowsInserted(const QModelIndex&, int, int) {
     goLast();
 }
 
+//
+// Detectors writing HDF5 files add frames to a file kept open, rather
+// than writing a new file per frame; follow the newest frame as well.
+//
+void SVImageSubWindow::watchFrames() {
+  SaxsviewFrameData *data = dynamic_cast<SaxsviewFrameData*>(p->frame->data());
+
+  // Wait for a file being loaded.
+  if (p->request || !data)
+    return;
+
+  data->refresh();
+  if (data->currentFrame() < data->frameCount()
+      && data->setCurrentFrame(data->frameCount()))
+    p->image->replot();
+}
+
 void SVImageSubWindow::addSelectionToMask(const QPointF& point) {
   p->mask->add(point);
 }
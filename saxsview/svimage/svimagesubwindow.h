@@ -50,6 +50,8 @@ public:
   bool maskRemovePointsEnabled() const;
   bool maskRemovePolygonEnabled() const;
 
+  bool regionStatisticsEnabled() const;
+
 public slots:
   bool load(const QString& fileName);
   void reload();
@@ -77,12 +79,19 @@ public slots:
   void setMaskAddPolygonEnabled(bool);
   void setMaskRemovePointsEnabled(bool);
   void setMaskRemovePolygonEnabled(bool);
+  void setRegionStatisticsEnabled(bool);
+
+signals:
+  /** Emitted once an image was read in the background and is shown. */
+  void loaded();
 
 protected:
   void closeEvent(QCloseEvent*);
 
 private slots:
+  void loadFinished();
   void rowsInserted(const QModelIndex&, int, int);
+  void watchFrames();
 
   void addSelectionToMask(const QPointF&);
   void addSelectionToMask(const QVector<QPointF>&);
@@ -337,6 +337,8 @@ void SVPlotMainWindow::newSubWindow() {
   SVPlotSubWindow *w = new SVPlotSubWindow(this);
   connect(w, SIGNAL(destroyed(QObject*)),
           this, SLOT(subWindowDestroyed(QObject*)));
+  connect(w, SIGNAL(loaded(const QString&)),
+          this, SLOT(subWindowLoaded(const QString&)));
   connect(w->project(), SIGNAL(itemChanged(QStandardItem*)),
           p->propertyDock, SLOT(itemChanged(QStandardItem*)));
   connect(w->project(), SIGNAL(currentIndexChanged(const QModelIndex&)),
@@ -362,7 +364,8 @@ void SVPlotMainWindow::load() {
 void SVPlotMainWindow::load(const QString& fileName) {
   //
   // See if we have a subwindow, if not create one.
-  // Then try to load the file.
+  // Then try to load the file; it is read in the background,
+  // see subWindowLoaded().
   //
   SVPlotSubWindow *w = currentSubWindow();
   if (!w) {
@@ -370,9 +373,10 @@ void SVPlotMainWindow::load(const QString& fileName) {
     w = currentSubWindow();
   }
 
-  if (!w->load(fileName))
-    return;
+  w->load(fileName);
+}
 
+void SVPlotMainWindow::subWindowLoaded(const QString& fileName) {
   QFileInfo info(fileName);
   // Store the full path to the file, otherwise it may be possible
   // to get relative paths to some working directory - which may
@@ -54,6 +54,7 @@ private slots:
   void setActiveSubWindow(QWidget*);
   void subWindowActivated(QMdiSubWindow*);
   void subWindowDestroyed(QObject*);
+  void subWindowLoaded(const QString& fileName);
 
 protected:
   void closeEvent(QCloseEvent*);
@@ -48,12 +48,34 @@ public:
     project = new SVPlotProject();
   }
 
+  ~Private();
+
   void setupUi(SVPlotSubWindow *w);
+  void addCurves(const QFileInfo& fileInfo, saxs_document *doc);
 
   SVPlotProject *project;
   SaxsviewPlot *plot;
+
+  // Files being read in the background, in the order requested.
+  struct PendingLoad {
+    QString fileName;
+    saxs_document_request *request;
+  };
+  QList<PendingLoad> pending;
 };
 
+SVPlotSubWindow::Private::~Private() {
+  //
+  // The completion callbacks may still be about to notify the
+  // window, wait for them before the window is gone.
+  //
+  foreach (const PendingLoad& load, pending) {
+    saxs_document_request_cancel(load.request);
+    saxs_document_request_wait(load.request);
+    saxs_document_request_free(load.request);
+  }
+}
+
 void SVPlotSubWindow::Private::setupUi(SVPlotSubWindow *w) {
   plot = new SaxsviewPlot(w);
   plot->setTransformation(0);
@@ -96,24 +118,8 @@ bool SVPlotSubWindow::moveEnabled() const {
 }
 
 
-bool SVPlotSubWindow::load(const QString& fileName) {
-  QFileInfo fileInfo(fileName);
-  if (!fileInfo.exists())
-    return false;
-
-  setCursor(Qt::WaitCursor);
-
-  saxs_document *doc = saxs_document_create();
-  int res = saxs_document_read(doc, qPrintable(fileName), 0L);
-  if (res != 0) {
-    saxs_document_free(doc);
-    QMessageBox::warning(this, "Load failed",
-                         QString("Failed to load: %1\n"
-                                 "Possible reason: %2.").arg(fileName)
-                                                        .arg(strerror(res)));
-    return false;
-  }
-
+void SVPlotSubWindow::Private::addCurves(const QFileInfo& fileInfo,
+                                        saxs_document *doc) {
   saxs_curve *curve = saxs_document_curve(doc);
   while (curve) {
     if (!(saxs_curve_type(curve) & SAXS_CURVE_SCATTERING_DATA)) {
@@ -148,21 +154,76 @@ bool SVPlotSubWindow::load(const QString& fileName) {
       plotCurve->setTitle(curveTitle);
       plotCurve->setFileName(fileInfo.absoluteFilePath());
 
-      p->plot->addCurve(plotCurve);
-      p->project->addPlotCurve(plotCurve);
+      plot->addCurve(plotCurve);
+      project->addPlotCurve(plotCurve);
 
     } else
       qDebug() << "boundingrect invalid";
 
     curve = saxs_curve_next(curve);
   }
+}
+
+//
+// Called from a worker thread of libsaxsdocument, forward the
+// notification to the thread of the window.
+//
+static void loadCallback(saxs_document_request*, int, void *userdata) {
+  QMetaObject::invokeMethod(static_cast<QObject*>(userdata),
+                            "loadFinished", Qt::QueuedConnection);
+}
 
-  saxs_document_free(doc);
+bool SVPlotSubWindow::load(const QString& fileName) {
+  QFileInfo fileInfo(fileName);
+  if (!fileInfo.exists())
+    return false;
 
-  unsetCursor();
+  Private::PendingLoad load;
+  load.fileName = fileName;
+  load.request  = saxs_document_read_async(qPrintable(fileName), 0L,
+                                           loadCallback, this);
+  if (!load.request)
+    return false;
+
+  if (p->pending.isEmpty())
+    setCursor(Qt::BusyCursor);
+
+  p->pending.append(load);
   return true;
 }
 
+void SVPlotSubWindow::loadFinished() {
+  //
+  // Files may finish in any order, add their curves in the
+  // order they were requested.
+  //
+  while (!p->pending.isEmpty()
+         && saxs_document_request_poll(p->pending.first().request)) {
+
+    Private::PendingLoad load = p->pending.takeFirst();
+
+    int res = saxs_document_request_wait(load.request);
+    saxs_document *doc = saxs_document_request_take(load.request);
+    saxs_document_request_free(load.request);
+
+    if (res != 0) {
+      QMessageBox::warning(this, "Load failed",
+                           QString("Failed to load: %1\n"
+                                   "Possible reason: %2.").arg(load.fileName)
+                                                          .arg(strerror(res)));
+      continue;
+    }
+
+    p->addCurves(QFileInfo(load.fileName), doc);
+    saxs_document_free(doc);
+
+    emit loaded(load.fileName);
+  }
+
+  if (p->pending.isEmpty())
+    unsetCursor();
+}
+
 void SVPlotSubWindow::exportAs(const QString& fileName,
                                 const QString& format) {
   p->plot->exportAs(fileName, format);
@@ -48,6 +48,12 @@ public slots:
   void setZoomEnabled(bool);
   void setMoveEnabled(bool);
 
+signals:
+  void loaded(const QString& fileName);
+
+private slots:
+  void loadFinished();
+
 private:
   class Private;
   Private *p;
@@ -0,0 +1,199 @@
+/*
+ * Test saxs_document_read_async against sequential reads.
+ *
+ * Usage: test_read_async <file> [<file> ...]
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "saxsdocument.h"
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int callbacks = 0;
+
+static void callback(saxs_document_request *request, int status,
+                     void *userdata) {
+  int *result = userdata;
+  (void)request;
+
+  pthread_mutex_lock(&lock);
+  callbacks += 1;
+  pthread_mutex_unlock(&lock);
+
+  *result = status;
+}
+
+static void test_read_async(const char **filenames, size_t count) {
+  saxs_document_request **requests;
+  int *results;
+  size_t i;
+
+  requests = malloc(count * sizeof(saxs_document_request*));
+  results  = malloc(count * sizeof(int));
+
+  callbacks = 0;
+  for (i = 0; i < count; ++i) {
+    results[i] = -1;
+    requests[i] = saxs_document_read_async(filenames[i], NULL,
+                                           callback, &results[i]);
+    assert(requests[i]);
+  }
+
+  for (i = 0; i < count; ++i) {
+    saxs_document *expected = saxs_document_create();
+    int expected_res = saxs_document_read(expected, filenames[i], NULL);
+    int res = saxs_document_request_wait(requests[i]);
+    saxs_document *doc;
+
+    assert(saxs_document_request_poll(requests[i]));
+    assert(res == expected_res);
+    assert(results[i] == expected_res);
+
+    doc = saxs_document_request_take(requests[i]);
+    if (res == 0) {
+      saxs_curve *ca, *cb;
+
+      assert(doc);
+      assert(saxs_document_curve_count(doc) == saxs_document_curve_count(expected));
+
+      ca = saxs_document_curve(doc);
+      cb = saxs_document_curve(expected);
+      for (; ca && cb; ca = saxs_curve_next(ca), cb = saxs_curve_next(cb))
+        assert(saxs_curve_compare(ca, cb) == 0);
+
+      /* The document is handed out only once. */
+      assert(!saxs_document_request_take(requests[i]));
+      saxs_document_free(doc);
+
+    } else
+      assert(!doc);
+
+    assert(saxs_document_request_cancel(requests[i]) == EALREADY);
+    saxs_document_request_free(requests[i]);
+    saxs_document_free(expected);
+  }
+
+  assert(callbacks == (int)count);
+
+  free(results);
+  free(requests);
+}
+
+static void test_cancel(const char **filenames, size_t count) {
+  saxs_document_request **requests;
+  int *results;
+  size_t i;
+
+  requests = malloc(count * sizeof(saxs_document_request*));
+  results  = malloc(count * sizeof(int));
+
+  /*
+   * Whether a request is cancelled before or while running depends
+   * on timing, either way it must complete with ECANCELED.
+   */
+  callbacks = 0;
+  for (i = 0; i < count; ++i) {
+    requests[i] = saxs_document_read_async(filenames[i], NULL,
+                                           callback, &results[i]);
+    assert(requests[i]);
+  }
+
+  for (i = 0; i < count; ++i) {
+    if (saxs_document_request_cancel(requests[i]) == 0) {
+      assert(saxs_document_request_wait(requests[i]) == ECANCELED);
+      assert(results[i] == ECANCELED);
+      assert(!saxs_document_request_take(requests[i]));
+
+    } else
+      assert(saxs_document_request_poll(requests[i]));
+  }
+
+  for (i = 0; i < count; ++i) {
+    saxs_document_request_wait(requests[i]);
+    saxs_document_request_free(requests[i]);
+  }
+
+  assert(callbacks == (int)count);
+
+  /* Requests may be free'd while pending. */
+  for (i = 0; i < count; ++i)
+    saxs_document_request_free(saxs_document_read_async(filenames[i], NULL,
+                                                        NULL, NULL));
+
+  free(results);
+  free(requests);
+}
+
+/*
+ * GUIs hand over from the callback to their main thread, which may
+ * poll before the callback returned. Done here within the callback.
+ */
+static void polling_callback(saxs_document_request *request, int status,
+                             void *userdata) {
+  saxs_document **doc = userdata;
+
+  assert(saxs_document_request_poll(request));
+  assert(saxs_document_request_cancel(request) == EALREADY);
+
+  *doc = saxs_document_request_take(request);
+  assert((*doc != NULL) == (status == 0));
+
+  pthread_mutex_lock(&lock);
+  callbacks += 1;
+  pthread_mutex_unlock(&lock);
+}
+
+static void test_poll_from_callback(const char **filenames, size_t count) {
+  saxs_document_request **requests;
+  saxs_document **docs;
+  size_t i;
+
+  requests = malloc(count * sizeof(saxs_document_request*));
+  docs     = malloc(count * sizeof(saxs_document*));
+
+  callbacks = 0;
+  for (i = 0; i < count; ++i) {
+    requests[i] = saxs_document_read_async(filenames[i], NULL,
+                                           polling_callback, &docs[i]);
+    assert(requests[i]);
+  }
+
+  for (i = 0; i < count; ++i) {
+    int res = saxs_document_request_wait(requests[i]);
+
+    /* The callback returned once waited for. */
+    assert((docs[i] != NULL) == (res == 0));
+    assert(!saxs_document_request_take(requests[i]));
+
+    if (docs[i])
+      saxs_document_free(docs[i]);
+    saxs_document_request_free(requests[i]);
+  }
+
+  assert(callbacks == (int)count);
+
+  free(docs);
+  free(requests);
+}
+
+int main(int argc, char **argv) {
+  const char **filenames = (const char **)(argv + 1);
+  size_t count = argc - 1;
+
+  printf("Testing saxs_document_read_async...\n");
+  test_read_async(filenames, count);
+
+  printf("Testing saxs_document_request_cancel...\n");
+  test_cancel(filenames, count);
+
+  printf("Testing saxs_document_request_poll from callbacks...\n");
+  test_poll_from_callback(filenames, count);
+
+  printf("All tests completed successfully!\n");
+  return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Test saxs_document_read_many against sequential reads.
+ *
+ * Usage: test_read_many <file> [<file> ...]
+ *
+ * Each file is read with saxs_document_read first, then all files
+ * together with saxs_document_read_many using different numbers of
+ * threads. Status codes and documents must match in input order.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "saxsdocument.h"
+
+static void compare_documents(const saxs_document *a, const saxs_document *b) {
+  saxs_curve *ca, *cb;
+
+  assert(saxs_document_curve_count(a) == saxs_document_curve_count(b));
+  assert(saxs_document_property_count(a) == saxs_document_property_count(b));
+  assert(0 == strcmp(saxs_document_format_id(a), saxs_document_format_id(b)));
+
+  ca = saxs_document_curve(a);
+  cb = saxs_document_curve(b);
+  while (ca && cb) {
+    assert(saxs_curve_type(ca) == saxs_curve_type(cb));
+    assert(saxs_curve_compare(ca, cb) == 0);
+
+    ca = saxs_curve_next(ca);
+    cb = saxs_curve_next(cb);
+  }
+  assert(!ca && !cb);
+}
+
+static void test_read_many(const char **filenames, size_t count,
+                           saxs_document **expected, const int *expected_res,
+                           int nthreads) {
+  saxs_document **docs = malloc(count * sizeof(saxs_document*));
+  int *results = malloc(count * sizeof(int));
+  int res, first_error = 0;
+  size_t i;
+
+  res = saxs_document_read_many(docs, results, filenames, NULL,
+                                count, nthreads);
+
+  for (i = 0; i < count; ++i) {
+    assert(results[i] == expected_res[i]);
+
+    if (expected[i]) {
+      assert(docs[i]);
+      compare_documents(docs[i], expected[i]);
+      saxs_document_free(docs[i]);
+
+    } else {
+      assert(!docs[i]);
+      if (!first_error)
+        first_error = results[i];
+    }
+  }
+  assert(res == first_error);
+
+  /* Results are optional. */
+  res = saxs_document_read_many(docs, NULL, filenames, NULL,
+                                count, nthreads);
+  assert(res == first_error);
+  for (i = 0; i < count; ++i)
+    if (docs[i])
+      saxs_document_free(docs[i]);
+
+  free(results);
+  free(docs);
+}
+
+int main(int argc, char **argv) {
+  const char **filenames = (const char **)(argv + 1);
+  size_t i, count = argc - 1;
+  saxs_document **expected = malloc(count * sizeof(saxs_document*));
+  int *expected_res = malloc(count * sizeof(int));
+  int nthreads[] = { 0, 1, 2, 3, 8 };
+
+  for (i = 0; i < count; ++i) {
+    expected[i] = saxs_document_create();
+    expected_res[i] = saxs_document_read(expected[i], filenames[i], NULL);
+    if (expected_res[i] != 0) {
+      saxs_document_free(expected[i]);
+      expected[i] = NULL;
+    }
+  }
+
+  for (i = 0; i < sizeof(nthreads) / sizeof(nthreads[0]); ++i) {
+    printf("Testing saxs_document_read_many with %d threads...\n", nthreads[i]);
+    test_read_many(filenames, count, expected, expected_res, nthreads[i]);
+  }
+
+  printf("Testing saxs_document_read_many with no files...\n");
+  assert(saxs_document_read_many(NULL, NULL, NULL, NULL, 0, 0) == 0);
+
+  for (i = 0; i < count; ++i)
+    if (expected[i])
+      saxs_document_free(expected[i]);
+  free(expected_res);
+  free(expected);
+
+  printf("All tests completed successfully!\n");
+  return 0;
+}
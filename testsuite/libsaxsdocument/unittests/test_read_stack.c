@@ -0,0 +1,90 @@
+/*
+ * Test saxs_document_read_stack.
+ *
+ * Usage: test_read_stack <same-grid-file> <other-grid-file> <missing-file>
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "saxsdocument.h"
+
+static void test_same_grid(const char *filename) {
+  const char *infiles[] = { filename, filename, filename };
+  saxs_document *doc = saxs_document_create();
+  double *x, *y, *y_err;
+  size_t i, k, columns;
+  int results[3];
+  saxs_data *data;
+
+  assert(saxs_document_read(doc, filename, NULL) == 0);
+
+  assert(saxs_document_read_stack(infiles, NULL, 3, NULL, 0, 0, 2,
+                                  &x, &y, &y_err, &columns, results) == 0);
+  assert(columns == (size_t)saxs_curve_data_count(saxs_document_curve(doc)));
+
+  for (i = 0; i < 3; ++i) {
+    assert(results[i] == 0);
+
+    data = saxs_curve_data(saxs_document_curve(doc));
+    for (k = 0; k < columns; ++k, data = saxs_data_next(data)) {
+      assert(x[k] == saxs_data_x(data));
+      assert(y[i * columns + k] == saxs_data_y(data));
+      assert(y_err[i * columns + k] == saxs_data_y_err(data));
+    }
+  }
+
+  free(x);
+  free(y);
+  free(y_err);
+  saxs_document_free(doc);
+}
+
+static void test_interpolate(const char *filename, const char *other,
+                             const char *missing) {
+  const char *infiles[] = { filename, other, missing };
+  double *x, *y, *y_err;
+  double grid[] = { 0.1, 0.15, 0.18 };
+  size_t i, columns;
+  int results[3];
+
+  /* Different grids are an error without interpolation. */
+  assert(saxs_document_read_stack(infiles, NULL, 2, NULL, 0, 0, 1,
+                                  &x, &y, &y_err, &columns, results) == EINVAL);
+  assert(results[0] == 0 && results[1] == EINVAL);
+  for (i = 0; i < columns; ++i)
+    assert(isnan(y[columns + i]));
+  free(x);
+  free(y);
+  free(y_err);
+
+  assert(saxs_document_read_stack(infiles, NULL, 3, grid, 3,
+                                  SAXS_STACK_INTERPOLATE, 0,
+                                  &x, &y, &y_err, &columns, results) == ENOENT);
+  assert(columns == 3);
+  assert(results[0] == 0 && results[1] == 0 && results[2] == ENOENT);
+  for (i = 0; i < columns; ++i) {
+    assert(x[i] == grid[i]);
+    assert(!isnan(y[i]));
+    assert(isnan(y[2 * columns + i]));
+  }
+  free(x);
+  free(y);
+  free(y_err);
+}
+
+int main(int argc, char **argv) {
+  assert(argc == 4);
+
+  printf("Testing saxs_document_read_stack with a common grid...\n");
+  test_same_grid(argv[1]);
+
+  printf("Testing saxs_document_read_stack with interpolation...\n");
+  test_interpolate(argv[1], argv[2], argv[3]);
+
+  printf("All tests completed successfully!\n");
+  return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Compare the conversion kernels used by the image readers with the
+ * per-pixel loops they replace.
+ *
+ * Usage: imgconvbench [<repetitions>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "saxsimage.h"
+#include "saxsimage_format.h"
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* As the readers did: column by column, flipped, one pixel at a time. */
+static void pixel_loop(saxs_image *image, const void *data, int type,
+                       size_t width, size_t height) {
+  size_t x, y;
+
+#define PIXEL_LOOP(ctype)                                                   \
+  for (x = 0; x < width; ++x)                                               \
+    for (y = 0; y < height; ++y)                                            \
+      saxs_image_set_value(image, x, height - y - 1,                        \
+                           ((const ctype*)data)[y * width + x])
+
+  switch (type) {
+    case SAXS_IMAGE_TYPE_UINT16: PIXEL_LOOP(unsigned short); break;
+    case SAXS_IMAGE_TYPE_INT32:  PIXEL_LOOP(int);            break;
+    case SAXS_IMAGE_TYPE_FLOAT:  PIXEL_LOOP(float);          break;
+  }
+
+#undef PIXEL_LOOP
+}
+
+static void row_loop(saxs_image *image, const void *data, int type,
+                     size_t width, size_t height) {
+  const size_t rowsize = width * saxs_image_type_size(type);
+  size_t y;
+
+  for (y = 0; y < height; ++y)
+    saxs_image_set_row(image, height - y - 1,
+                       (const char*)data + y * rowsize, type);
+}
+
+static void kernel(saxs_image *image, const void *data, int type,
+                   size_t width, size_t height) {
+  /* The size is that of the image, as for the other loops. */
+  (void)width;
+  (void)height;
+
+  saxs_image_set_pixels(image, data, type, SAXS_IMAGE_LAYOUT_TOPDOWN);
+}
+
+static void bench(const char *name, int from_type, int to_type,
+                  size_t width, size_t height, int repetitions) {
+  static const struct {
+    const char *name;
+    void (*fn)(saxs_image*, const void*, int, size_t, size_t);
+  } loops[] = {
+    { "pixel loop", pixel_loop },
+    { "row loop",   row_loop },
+    { "kernel",     kernel },
+    { NULL, NULL }
+  };
+
+  saxs_image *image = saxs_image_create();
+  char *data = malloc(width * height * saxs_image_type_size(from_type));
+  size_t i;
+  int l, r;
+
+  for (i = 0; i < width * height * saxs_image_type_size(from_type); ++i)
+    data[i] = rand() & 0x3f;
+
+  saxs_image_resize(image, width, height, 1, 1, to_type);
+
+  for (l = 0; loops[l].name; ++l) {
+    double t = now();
+    for (r = 0; r < repetitions; ++r)
+      loops[l].fn(image, data, from_type, width, height);
+    t = (now() - t) / repetitions;
+
+    printf("%-24s %-12s %8.2f ms  %8.1f Mpixel/s\n", name, loops[l].name,
+           t * 1e3, width * height / t * 1e-6);
+  }
+
+  free(data);
+  saxs_image_free(image);
+}
+
+int main(int argc, char **argv) {
+  int repetitions = argc > 1 ? atoi(argv[1]) : 10;
+
+  bench("PILATUS int32 -> double", SAXS_IMAGE_TYPE_INT32, SAXS_IMAGE_TYPE_DOUBLE,
+        1475, 1679, repetitions);
+  bench("PILATUS int32 -> int32",  SAXS_IMAGE_TYPE_INT32, SAXS_IMAGE_TYPE_INT32,
+        1475, 1679, repetitions);
+  bench("MAR uint16 -> double",    SAXS_IMAGE_TYPE_UINT16, SAXS_IMAGE_TYPE_DOUBLE,
+        2048, 2048, repetitions);
+  bench("EDF float -> double",     SAXS_IMAGE_TYPE_FLOAT, SAXS_IMAGE_TYPE_DOUBLE,
+        1024, 1024, repetitions);
+
+  return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Test frame arithmetic against a straightforward computation.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "saxsimage.h"
+
+#define FRAMES 5
+
+static saxs_image* random_image(size_t width, size_t height, int type) {
+  saxs_image *image = saxs_image_create();
+  size_t x, y;
+
+  assert(saxs_image_resize(image, width, height, 1, 1, type) == 0);
+  for (y = 0; y < height; ++y)
+    for (x = 0; x < width; ++x)
+      saxs_image_set_value(image, x, y, rand() % 1000);
+
+  return image;
+}
+
+static saxs_image* random_mask(size_t width, size_t height) {
+  saxs_image *mask = saxs_image_create();
+  size_t x, y;
+
+  assert(saxs_image_resize(mask, width, height, 1, 1, SAXS_IMAGE_TYPE_UINT8) == 0);
+  for (y = 0; y < height; ++y)
+    for (x = 0; x < width; ++x)
+      saxs_image_set_value(mask, x, y, rand() % 7 == 0);
+
+  return mask;
+}
+
+static int compare_double(const void *a, const void *b) {
+  const double da = *(const double*)a, db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+static void test_inplace(size_t width, size_t height) {
+  saxs_image *image = random_image(width, height, SAXS_IMAGE_TYPE_INT32);
+  saxs_image *other = random_image(width, height, SAXS_IMAGE_TYPE_UINT16);
+  saxs_image *mask = random_mask(width, height);
+  saxs_image *expected = saxs_image_copy(image);
+  saxs_image *small = random_image(width, height + 1, SAXS_IMAGE_TYPE_FLOAT);
+  size_t x, y;
+
+  assert(saxs_image_add(image, other, 0.5, mask) == 0);
+  assert(saxs_image_type(image) == SAXS_IMAGE_TYPE_DOUBLE);
+  assert(saxs_image_scale(image, 3.0, NULL) == 0);
+  assert(saxs_image_subtract(image, other, NULL) == 0);
+
+  for (y = 0; y < height; ++y)
+    for (x = 0; x < width; ++x) {
+      double v = saxs_image_value(expected, x, y);
+      if (saxs_image_value(mask, x, y) == 0.0)
+        v += 0.5 * saxs_image_value(other, x, y);
+      v = 3.0 * v - saxs_image_value(other, x, y);
+
+      assert(saxs_image_value(image, x, y) == v);
+    }
+
+  assert(saxs_image_add(image, small, 1.0, NULL) == EINVAL);
+  assert(saxs_image_scale(image, 1.0, small) == EINVAL);
+
+  saxs_image_free(small);
+  saxs_image_free(expected);
+  saxs_image_free(mask);
+  saxs_image_free(other);
+  saxs_image_free(image);
+}
+
+static void test_series(size_t width, size_t height, size_t count) {
+  saxs_image *images[FRAMES], *mask, *mean, *median, *sum;
+  saxs_image_accumulator *acc;
+  double values[FRAMES];
+  size_t i, x, y;
+
+  assert(count <= FRAMES);
+  for (i = 0; i < count; ++i)
+    images[i] = random_image(width, height, i % 2 ? SAXS_IMAGE_TYPE_FLOAT
+                                                  : SAXS_IMAGE_TYPE_INT32);
+  mask   = random_mask(width, height);
+  mean   = saxs_image_create();
+  median = saxs_image_create();
+  sum    = saxs_image_create();
+
+  assert(saxs_image_mean(mean, images, count, mask) == 0);
+  assert(saxs_image_median(median, images, count, mask) == 0);
+
+  acc = saxs_image_accumulator_create(width, height, NULL);
+  assert(acc);
+  for (i = 0; i < count; ++i)
+    assert(saxs_image_accumulator_add(acc, images[i], 2.0) == 0);
+  assert(saxs_image_accumulator_count(acc) == count);
+  assert(saxs_image_accumulator_sum(acc, sum) == 0);
+
+  for (y = 0; y < height; ++y)
+    for (x = 0; x < width; ++x) {
+      double total = 0.0, expected;
+
+      for (i = 0; i < count; ++i) {
+        values[i] = saxs_image_value(images[i], x, y);
+        total += values[i];
+      }
+
+      assert(fabs(saxs_image_value(sum, x, y) - 2.0 * total) < 1e-9);
+
+      if (saxs_image_value(mask, x, y) != 0.0) {
+        assert(saxs_image_value(mean, x, y) == 0.0);
+        assert(saxs_image_value(median, x, y) == 0.0);
+        continue;
+      }
+
+      assert(fabs(saxs_image_value(mean, x, y) - total / count) < 1e-9);
+
+      qsort(values, count, sizeof(double), compare_double);
+      expected = count % 2 ? values[count / 2]
+                           : 0.5 * (values[count / 2 - 1] + values[count / 2]);
+      assert(saxs_image_value(median, x, y) == expected);
+    }
+
+  saxs_image_accumulator_free(acc);
+  assert(!saxs_image_accumulator_create(width + 1, height, mask));
+
+  saxs_image_free(sum);
+  saxs_image_free(median);
+  saxs_image_free(mean);
+  saxs_image_free(mask);
+  for (i = 0; i < count; ++i)
+    saxs_image_free(images[i]);
+}
+
+int main() {
+  printf("Testing saxs_image_add, saxs_image_scale...\n");
+  test_inplace(13, 7);
+  test_inplace(640, 480);    /* large enough to run in parallel */
+
+  printf("Testing saxs_image_mean, saxs_image_median...\n");
+  test_series(17, 9, 1);
+  test_series(17, 9, 4);
+  test_series(640, 480, 5);
+
+  printf("All tests completed successfully!\n");
+  return 0;
+}
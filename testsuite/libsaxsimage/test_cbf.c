@@ -0,0 +1,228 @@
+/*
+ * Test reading CBF files written by cbflib, through the byte offset
+ * decoder and through cbflib, and writing files cbflib reads.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "saxsimage.h"
+#include "cbf.h"
+
+#define WIDTH  487
+#define HEIGHT 195
+
+static int values[WIDTH * HEIGHT];
+
+static void write_cbf(const char *filename, unsigned int compression) {
+  cbf_handle cbf;
+  FILE *fd;
+
+  assert(cbf_make_handle(&cbf) == 0);
+  assert(cbf_new_datablock(cbf, "image_1") == 0);
+  assert(cbf_new_category(cbf, "array_data") == 0);
+  assert(cbf_new_column(cbf, "data") == 0);
+  assert(cbf_set_integerarray_wdims_fs(cbf, compression, 1, values,
+                                       sizeof(int), 1, WIDTH * HEIGHT,
+                                       "little_endian", WIDTH, HEIGHT, 0,
+                                       4095) == 0);
+
+  fd = fopen(filename, "wb");
+  assert(fd);
+  assert(cbf_write_file(cbf, fd, 1, CBF, MSG_DIGEST | MIME_HEADERS,
+                        ENC_NONE) == 0);
+  cbf_free_handle(cbf);         /* closes fd */
+}
+
+static void assert_values(saxs_image *image) {
+  size_t x, y;
+
+  assert(saxs_image_width(image) == WIDTH);
+  assert(saxs_image_height(image) == HEIGHT);
+  assert(saxs_image_type(image) == SAXS_IMAGE_TYPE_INT32);
+
+  /* The first row in the file is the top one. */
+  for (y = 0; y < HEIGHT; ++y)
+    for (x = 0; x < WIDTH; ++x)
+      assert(saxs_image_value(image, x, HEIGHT - y - 1) == values[y * WIDTH + x]);
+}
+
+/* Reads the pixels of a file written here with cbflib. */
+static void assert_cbflib_values(const char *filename) {
+  static int read[WIDTH * HEIGHT];
+  unsigned int compression;
+  int binary_id, element_signed, element_unsigned, real;
+  size_t element_size, elements, fastest, second, nread;
+  cbf_handle cbf;
+  FILE *fd;
+
+  fd = fopen(filename, "rb");
+  assert(fd);
+  assert(cbf_make_handle(&cbf) == 0);
+  assert(cbf_read_file(cbf, fd, MSG_DIGEST) == 0);
+  assert(cbf_find_category(cbf, "array_data") == 0);
+  assert(cbf_find_column(cbf, "data") == 0);
+  assert(cbf_get_arrayparameters_wdims(cbf, &compression, &binary_id,
+                                       &element_size, &element_signed,
+                                       &element_unsigned, &elements,
+                                       NULL, NULL, &real, NULL,
+                                       &fastest, &second, NULL, NULL) == 0);
+  assert(compression == CBF_BYTE_OFFSET);
+  assert(fastest == WIDTH && second == HEIGHT && elements == WIDTH * HEIGHT);
+  assert(cbf_get_integerarray(cbf, &binary_id, read, sizeof(int), 1,
+                              elements, &nread) == 0);
+  assert(nread == elements);
+  cbf_free_handle(cbf);         /* closes fd */
+
+  assert(memcmp(read, values, sizeof(values)) == 0);
+}
+
+/*
+ * Floating point pixels are off by less than a half, and rounded back
+ * when written; pixels 11 to 14 hold what is written as their values.
+ */
+static void set_values(saxs_image *image, int type) {
+  const int fractional = type == SAXS_IMAGE_TYPE_FLOAT
+                         || type == SAXS_IMAGE_TYPE_DOUBLE;
+  size_t x, y;
+
+  assert(saxs_image_resize(image, WIDTH, HEIGHT, 1, 1, type) == 0);
+  for (y = 0; y < HEIGHT; ++y)
+    for (x = 0; x < WIDTH; ++x) {
+      const size_t i = y * WIDTH + x;
+      double value = values[i];
+
+      if (fractional) {
+        value += ((double)(i % 7) - 3.0) * 0.15;
+        switch (i) {
+          case 11: value = NAN;    break;
+          case 12: value = -1e12;  break;
+          case 13: value = 1e12;   break;
+          case 14: value = -3.5;   break;
+        }
+      }
+      saxs_image_set_value(image, x, HEIGHT - y - 1, value);
+    }
+}
+
+static void test_write(const char *filename) {
+  const char *filenames[3] = { "test_cbf_1.cbf", "test_cbf_2.cbf",
+                               "test_cbf_3.cbf" };
+  saxs_image *images[3], *image = saxs_image_create();
+  size_t i;
+  FILE *fd;
+
+  set_values(image, SAXS_IMAGE_TYPE_INT32);
+  assert(saxs_image_write(image, filename, NULL) == 0);
+  assert_cbflib_values(filename);
+
+  /* Much smaller than 4 bytes a pixel. */
+  fd = fopen(filename, "rb");
+  assert(fd && fseek(fd, 0, SEEK_END) == 0);
+  assert(ftell(fd) < WIDTH * HEIGHT * 2);
+  fclose(fd);
+
+  saxs_image_set_verify_checksums(image, 1);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert_values(image);
+
+  /* Processed frames are written as integers too. */
+  for (i = 0; i < 3; ++i) {
+    images[i] = saxs_image_create();
+    set_values(images[i], i == 0 ? SAXS_IMAGE_TYPE_INT32
+                                 : SAXS_IMAGE_TYPE_DOUBLE);
+  }
+  assert(saxs_image_write_many(images, filenames, 3, "cbf") == 0);
+  for (i = 0; i < 3; ++i) {
+    assert_cbflib_values(filenames[i]);
+    assert(saxs_image_read(image, filenames[i], NULL) == 0);
+    assert_values(image);
+    remove(filenames[i]);
+    saxs_image_free(images[i]);
+  }
+
+  remove(filename);
+  saxs_image_free(image);
+}
+
+/* Replaces the first character of the Content-MD5 value. */
+static void damage_digest(const char *filename) {
+  static char buffer[4096];
+  char *digest;
+  size_t n;
+  FILE *fd;
+
+  fd = fopen(filename, "r+b");
+  assert(fd);
+  n = fread(buffer, 1, sizeof(buffer) - 1, fd);
+  buffer[n] = '\0';
+
+  digest = strstr(buffer, "Content-MD5: ");
+  assert(digest);
+  digest += strlen("Content-MD5: ");
+
+  fseek(fd, digest - buffer, SEEK_SET);
+  fputc(*digest == 'A' ? 'B' : 'A', fd);
+  fclose(fd);
+}
+
+int main() {
+  const char *filename = "test_cbf.cbf";
+  saxs_image *image = saxs_image_create();
+  size_t i;
+
+  /*
+   * Mostly small counts, with gaps and hot pixels for the longer
+   * differences, down to the full range of 32-bit integers.
+   */
+  srand(42);
+  for (i = 0; i < WIDTH * HEIGHT; ++i) {
+    values[i] = rand() % 20;
+    if (rand() % 100 == 0)
+      values[i] = -1;
+    if (rand() % 500 == 0)
+      values[i] = rand() % 1000000;
+  }
+  values[7]  = -2147483647 - 1;
+  values[8]  = 2147483647;
+  values[9]  = -40000;
+  values[10] = 300;
+  values[11] = -1;
+  values[12] = -2147483647 - 1;
+  values[13] = 2147483647;
+  values[14] = -4;
+
+  printf("Testing byte offset compression...\n");
+  write_cbf(filename, CBF_BYTE_OFFSET);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert_values(image);
+
+  saxs_image_set_verify_checksums(image, 1);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert_values(image);
+
+  /* A wrong digest only matters if checked. */
+  damage_digest(filename);
+  assert(saxs_image_read(image, filename, NULL) != 0);
+  saxs_image_set_verify_checksums(image, 0);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert_values(image);
+
+  printf("Testing other compressions...\n");
+  write_cbf(filename, CBF_PACKED);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert_values(image);
+
+  remove(filename);
+  saxs_image_free(image);
+
+  printf("Testing writing...\n");
+  test_write(filename);
+
+  printf("All tests completed successfully!\n");
+  return 0;
+}
@@ -0,0 +1,604 @@
+/*
+ * Test stepping through the frames of EIGER-like and NeXus HDF5 files.
+ *
+ * Usage: test_hdf5 [<file>]
+ *
+ * Given a file, only writes the frames to it.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <hdf5.h>
+
+#include "saxsimage.h"
+#include "saxsimage_format.h"
+#include "saxsthreadpool.h"
+
+#define FRAMES 7
+#define HEIGHT 30
+#define WIDTH  40
+
+static int value(size_t frame, size_t x, size_t y) {
+  return frame * 10000 + y * 100 + x;
+}
+
+/*
+ * Frames first + 1 to first + frames as dataset path, chunks of three
+ * frames, the last one possibly incomplete.
+ */
+static void write_frames(hid_t file, const char *path,
+                         size_t first, size_t frames) {
+  static int data[FRAMES][HEIGHT][WIDTH];
+  hsize_t dim[3] = { frames, HEIGHT, WIDTH }, chunk[3] = { 3, HEIGHT, WIDTH };
+  hid_t space, plist, dataset;
+  size_t f, x, y;
+
+  for (f = 0; f < frames; ++f)
+    for (y = 0; y < HEIGHT; ++y)
+      for (x = 0; x < WIDTH; ++x)
+        data[f][y][x] = value(first + f + 1, x, y);
+
+  if (frames < chunk[0])
+    chunk[0] = frames;
+
+  space = H5Screate_simple(3, dim, NULL);
+  plist = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_chunk(plist, 3, chunk);
+  H5Pset_deflate(plist, 1);
+  dataset = H5Dcreate2(file, path, H5T_STD_I32LE, space,
+                       H5P_DEFAULT, plist, H5P_DEFAULT);
+  assert(dataset >= 0);
+  assert(H5Dwrite(dataset, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                  data) >= 0);
+
+  H5Dclose(dataset);
+  H5Pclose(plist);
+  H5Sclose(space);
+}
+
+static void write_attribute(hid_t object, const char *name, const char *value) {
+  hid_t type, space, attribute;
+
+  type = H5Tcopy(H5T_C_S1);
+  H5Tset_size(type, strlen(value) + 1);
+  space = H5Screate(H5S_SCALAR);
+  attribute = H5Acreate2(object, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+  assert(attribute >= 0);
+  assert(H5Awrite(attribute, type, value) >= 0);
+
+  H5Aclose(attribute);
+  H5Sclose(space);
+  H5Tclose(type);
+}
+
+static hid_t create_group(hid_t file, const char *path, const char *nx_class) {
+  hid_t group = H5Gcreate2(file, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  assert(group >= 0);
+  if (nx_class)
+    write_attribute(group, "NX_class", nx_class);
+  return group;
+}
+
+/* All frames at /entry/data/data, as written by older EIGER firmware. */
+static void write_hdf5(const char *filename) {
+  hid_t file;
+
+  file = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  assert(file >= 0);
+  H5Gclose(create_group(file, "/entry", NULL));
+  H5Gclose(create_group(file, "/entry/data", NULL));
+  write_frames(file, "/entry/data/data", 0, FRAMES);
+  H5Fclose(file);
+}
+
+static void assert_frame(saxs_image *image, size_t frame) {
+  size_t x, y;
+
+  assert(saxs_image_current_frame(image) == (int)frame);
+  assert(saxs_image_width(image) == WIDTH);
+  assert(saxs_image_height(image) == HEIGHT);
+
+  /* The first row in the file is the top one. */
+  for (y = 0; y < HEIGHT; ++y)
+    for (x = 0; x < WIDTH; ++x)
+      assert(saxs_image_value(image, x, HEIGHT - y - 1) == value(frame, x, y));
+}
+
+/*
+ * Frames appended by a writer in SWMR mode show up on refresh, as
+ * during data collection.
+ */
+static void test_swmr(const char *filename) {
+  static int data[HEIGHT][WIDTH];
+  hsize_t dim[3] = { 0, HEIGHT, WIDTH }, chunk[3] = { 1, HEIGHT, WIDTH };
+  hsize_t maxdim[3] = { H5S_UNLIMITED, HEIGHT, WIDTH };
+  hid_t file, fapl, group, space, plist, dataset;
+  saxs_image *image = saxs_image_create();
+  size_t f, x, y;
+
+  fapl = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_libver_bounds(fapl, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+  file = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, fapl);
+  assert(file >= 0);
+  group = H5Gcreate2(file, "/entry", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Gclose(group);
+  group = H5Gcreate2(file, "/entry/data", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Gclose(group);
+
+  space = H5Screate_simple(3, dim, maxdim);
+  plist = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_chunk(plist, 3, chunk);
+  dataset = H5Dcreate2(file, "/entry/data/data", H5T_STD_I32LE, space,
+                       H5P_DEFAULT, plist, H5P_DEFAULT);
+  assert(dataset >= 0);
+  H5Pclose(plist);
+  H5Sclose(space);
+  assert(H5Fstart_swmr_write(file) >= 0);
+
+  for (f = 1; f <= FRAMES; ++f) {
+    hsize_t offset[3] = { f - 1, 0, 0 }, size[3] = { 1, HEIGHT, WIDTH };
+    hid_t filespace, memspace;
+
+    for (y = 0; y < HEIGHT; ++y)
+      for (x = 0; x < WIDTH; ++x)
+        data[y][x] = value(f, x, y);
+
+    dim[0] = f;
+    assert(H5Dset_extent(dataset, dim) >= 0);
+    filespace = H5Dget_space(dataset);
+    memspace  = H5Screate_simple(3, size, NULL);
+    H5Sselect_hyperslab(filespace, H5S_SELECT_SET, offset, NULL, size, NULL);
+    assert(H5Dwrite(dataset, H5T_NATIVE_INT, memspace, filespace,
+                    H5P_DEFAULT, data) >= 0);
+    H5Sclose(memspace);
+    H5Sclose(filespace);
+    assert(H5Dflush(dataset) >= 0);
+
+    if (f == 1) {
+      assert(saxs_image_read(image, filename, NULL) == 0);
+      assert(saxs_image_frame_count(image) == 1);
+      assert(saxs_image_refresh(image) == 0);
+      assert(saxs_image_frame_count(image) == 1);
+
+    } else {
+      assert(saxs_image_read_frame(image, f) == EINVAL);
+      assert(saxs_image_refresh(image) == 0);
+      assert(saxs_image_frame_count(image) == (int)f);
+      assert(saxs_image_read_frame(image, f) == 0);
+    }
+    assert_frame(image, f);
+  }
+
+  saxs_image_free(image);
+  H5Dclose(dataset);
+  H5Fclose(file);
+  H5Pclose(fapl);
+  remove(filename);
+}
+
+/*
+ * EIGER master files link to data files of a fixed number of frames
+ * each, but the last; they are read as one stack.
+ */
+static void test_master(const char *filename) {
+  const char *data[] = { "test_hdf5_data_000001.h5",
+                         "test_hdf5_data_000002.h5",
+                         "test_hdf5_data_000003.h5" };
+  const size_t frames[] = { 3, 3, 1 };
+  saxs_image *image = saxs_image_create();
+  hid_t file, group;
+  size_t i, first = 0;
+  char name[32];
+
+  file = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  assert(file >= 0);
+  H5Gclose(create_group(file, "/entry", "NXentry"));
+  group = create_group(file, "/entry/data", "NXdata");
+
+  for (i = 0; i < 3; ++i) {
+    hid_t datafile = H5Fcreate(data[i], H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    assert(datafile >= 0);
+    H5Gclose(create_group(datafile, "/entry", NULL));
+    H5Gclose(create_group(datafile, "/entry/data", NULL));
+    write_frames(datafile, "/entry/data/data", first, frames[i]);
+    H5Fclose(datafile);
+    first += frames[i];
+
+    sprintf(name, "data_%06zu", i + 1);
+    assert(H5Lcreate_external(data[i], "/entry/data/data", group, name,
+                              H5P_DEFAULT, H5P_DEFAULT) >= 0);
+  }
+  H5Gclose(group);
+  H5Fclose(file);
+
+  saxs_image_set_frame_cache_size(image, 0);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert(saxs_image_frame_count(image) == FRAMES);
+  assert_frame(image, 1);
+
+  for (i = 2; i <= FRAMES; ++i) {
+    assert(saxs_image_read_frame(image, i) == 0);
+    assert_frame(image, i);
+  }
+  assert(saxs_image_read_frame(image, 2) == 0);
+  assert_frame(image, 2);
+
+  /* Data files are opened once read from. */
+  saxs_image_free(image);
+  image = saxs_image_create();
+  saxs_image_set_frame_cache_size(image, 0);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  remove(data[1]);
+  assert(saxs_image_read_frame(image, 4) != 0);
+  assert(saxs_image_read_frame(image, 7) == 0);
+  assert_frame(image, 7);
+  assert(saxs_image_read_frame(image, 3) == 0);
+  assert_frame(image, 3);
+
+  saxs_image_free(image);
+  remove(data[0]);
+  remove(data[2]);
+  remove(filename);
+}
+
+/* NeXus files tell where to find the frames. */
+static void test_nexus(const char *filename) {
+  saxs_image *image = saxs_image_create();
+  hid_t file, group;
+
+  file = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  assert(file >= 0);
+  write_attribute(file, "default", "scan");
+
+  /* An entry found first unless following "default". */
+  group = create_group(file, "/calibration", "NXentry");
+  H5Gclose(create_group(file, "/calibration/data", "NXdata"));
+  write_frames(file, "/calibration/data/data", 100, 1);
+  H5Gclose(group);
+
+  group = create_group(file, "/scan", "NXentry");
+  write_attribute(group, "default", "detector");
+  H5Gclose(create_group(file, "/scan/monitor", "NXdata"));
+  H5Gclose(group);
+
+  group = create_group(file, "/scan/detector", "NXdata");
+  write_attribute(group, "signal", "frames");
+  write_frames(file, "/scan/detector/frames", 0, FRAMES);
+  H5Gclose(group);
+  H5Fclose(file);
+
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert(saxs_image_frame_count(image) == FRAMES);
+  assert_frame(image, 1);
+  assert(saxs_image_read_frame(image, FRAMES) == 0);
+  assert_frame(image, FRAMES);
+
+  saxs_image_free(image);
+  remove(filename);
+}
+
+/*
+ * Once the file is gone and the image let go of it, frames can only
+ * come from the cache; reading any other fails.
+ */
+static int read_frame_removed(saxs_image *image, size_t frame) {
+  int res;
+
+  H5E_BEGIN_TRY {
+    res = saxs_image_read_frame(image, frame);
+  } H5E_END_TRY;
+
+  return res;
+}
+
+static void test_frame_cache(const char *filename) {
+  saxs_image *image = saxs_image_create();
+  const size_t bytes = WIDTH * HEIGHT * sizeof(int);
+
+  write_hdf5(filename);
+
+  /* Room for two frames besides the current one. */
+  saxs_image_set_frame_cache_size(image, 2 * bytes);
+  assert(saxs_image_frame_cache_size(image) == 2 * bytes);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+
+  /* Frames 1, 2 and 3 read, the revisited 1 from the cache. */
+  assert(saxs_image_read_frame(image, 2) == 0);
+  assert(saxs_image_read_frame(image, 3) == 0);
+  assert(saxs_image_read_frame(image, 1) == 0);
+  assert_frame(image, 1);
+
+  /* Reading 4 drops 2, the least recently used: cached are 1 and 3. */
+  assert(saxs_image_read_frame(image, 4) == 0);
+
+  remove(filename);
+  saxs_image_set_format_state(image, NULL, NULL);
+
+  /* A failed read keeps the frame there was. */
+  assert(read_frame_removed(image, 2) != 0);
+  assert_frame(image, 4);
+
+  /* Cached are 4 and 1 after this, then 3 and 4. */
+  assert(read_frame_removed(image, 3) == 0);
+  assert_frame(image, 3);
+  assert(read_frame_removed(image, 1) == 0);
+  assert_frame(image, 1);
+  assert(read_frame_removed(image, 4) == 0);
+  assert_frame(image, 4);
+
+  /*
+   * Modified frames are not cached, but kept, modified, if reading
+   * another one fails.
+   */
+  saxs_image_set_value(image, 0, 0, -1.0);
+  assert(read_frame_removed(image, 5) != 0);
+  assert(saxs_image_current_frame(image) == 4);
+  assert(saxs_image_value(image, 0, 0) == -1.0);
+
+  assert(read_frame_removed(image, 3) == 0);
+  assert_frame(image, 3);
+  assert(read_frame_removed(image, 4) != 0);
+  assert_frame(image, 3);
+
+  /* Without cache, nothing is kept. */
+  saxs_image_set_frame_cache_size(image, 0);
+  assert(read_frame_removed(image, 1) != 0);
+  assert_frame(image, 3);
+
+  saxs_image_free(image);
+}
+
+/*
+ * Jobs occupying all workers of the default pool until opened. As the
+ * pool runs jobs in order, all jobs submitted before have finished
+ * once every worker runs one of these.
+ */
+static pthread_mutex_t gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static int gate_running = 0, gate_opened = 0;
+static saxs_thread_job **gate_jobs = NULL;
+
+static int gate_run(void *arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&gate_lock);
+  gate_running += 1;
+  pthread_cond_broadcast(&gate_cond);
+  while (!gate_opened)
+    pthread_cond_wait(&gate_cond, &gate_lock);
+  gate_running -= 1;
+  pthread_mutex_unlock(&gate_lock);
+
+  return 0;
+}
+
+static void gate_close() {
+  saxs_thread_pool *pool = saxs_thread_pool_default();
+  int i, n = saxs_thread_pool_size(pool);
+
+  gate_opened = 0;
+  gate_jobs = malloc(n * sizeof(saxs_thread_job*));
+  for (i = 0; i < n; ++i) {
+    gate_jobs[i] = saxs_thread_job_submit(pool, gate_run, NULL, NULL, NULL);
+    assert(gate_jobs[i]);
+  }
+
+  pthread_mutex_lock(&gate_lock);
+  while (gate_running < n)
+    pthread_cond_wait(&gate_cond, &gate_lock);
+  pthread_mutex_unlock(&gate_lock);
+}
+
+static void gate_open() {
+  int i, n = saxs_thread_pool_size(saxs_thread_pool_default());
+
+  pthread_mutex_lock(&gate_lock);
+  gate_opened = 1;
+  pthread_cond_broadcast(&gate_cond);
+  pthread_mutex_unlock(&gate_lock);
+
+  for (i = 0; i < n; ++i) {
+    saxs_thread_job_wait(gate_jobs[i]);
+    saxs_thread_job_release(gate_jobs[i]);
+  }
+  free(gate_jobs);
+}
+
+/* Returns once all frames being prefetched are decoded. */
+static void wait_for_prefetch() {
+  gate_close();
+  gate_open();
+}
+
+/*
+ * Frames decoded in the background are picked up by the next read,
+ * others are dropped with the format state.
+ */
+static void test_prefetch_window(const char *filename) {
+  saxs_image *image = saxs_image_create();
+
+  /* Forward from the first frame: 2 and 3 decoded, then 4. */
+  write_hdf5(filename);
+  saxs_image_set_prefetch(image, 2);
+  assert(saxs_image_prefetch(image) == 2);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  wait_for_prefetch();
+  assert(saxs_image_read_frame(image, 2) == 0);
+  wait_for_prefetch();
+
+  remove(filename);
+  saxs_image_set_format_state(image, NULL, NULL);
+
+  assert(read_frame_removed(image, 3) == 0);
+  assert_frame(image, 3);
+  assert(read_frame_removed(image, 1) == 0);
+  assert(read_frame_removed(image, 4) != 0);
+  assert(read_frame_removed(image, 5) != 0);
+  assert_frame(image, 1);
+
+  /* Backward from the last frame: 5 and 4 decoded, then 3. */
+  write_hdf5(filename);
+  assert(saxs_image_read_at(image, filename, NULL, FRAMES) == 0);
+  assert(saxs_image_read_frame(image, FRAMES - 1) == 0);
+  wait_for_prefetch();
+  assert(saxs_image_read_frame(image, FRAMES - 2) == 0);
+  wait_for_prefetch();
+
+  remove(filename);
+  saxs_image_set_format_state(image, NULL, NULL);
+
+  assert(read_frame_removed(image, FRAMES - 3) == 0);
+  assert_frame(image, FRAMES - 3);
+  assert(read_frame_removed(image, FRAMES) == 0);
+  assert(read_frame_removed(image, FRAMES - 4) != 0);
+  assert(read_frame_removed(image, 1) != 0);
+  assert_frame(image, FRAMES);
+
+  saxs_image_free(image);
+}
+
+/* Requests that fell out of the window are not picked up later. */
+static void test_prefetch_cancel(const char *filename) {
+  saxs_image *image = saxs_image_create();
+
+  write_hdf5(filename);
+  saxs_image_set_prefetch(image, 2);
+
+  /* Frames 2 and 3 stay queued until after jumping to 6. */
+  gate_close();
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert(saxs_image_read_frame(image, 6) == 0);
+  gate_open();
+
+  wait_for_prefetch();
+  assert(saxs_image_read_frame(image, 7) == 0);
+
+  remove(filename);
+  saxs_image_set_format_state(image, NULL, NULL);
+
+  assert(read_frame_removed(image, 2) != 0);
+  assert(read_frame_removed(image, 3) != 0);
+  assert(read_frame_removed(image, 6) == 0);
+  assert_frame(image, 6);
+  assert(read_frame_removed(image, 1) == 0);
+  assert_frame(image, 1);
+
+  saxs_image_free(image);
+}
+
+struct read_frame_args {
+  saxs_image *image;
+  size_t frame;
+  int res, done;
+};
+
+static void* read_frame_thread(void *arg) {
+  struct read_frame_args *args = arg;
+  int res = saxs_image_read_frame(args->image, args->frame);
+
+  pthread_mutex_lock(&gate_lock);
+  args->res  = res;
+  args->done = 1;
+  pthread_mutex_unlock(&gate_lock);
+
+  return NULL;
+}
+
+/* Reading a frame that is pending waits for it rather than reading. */
+static void test_prefetch_wait(const char *filename) {
+  struct read_frame_args args;
+  pthread_t thread;
+  int done;
+
+  args.image = saxs_image_create();
+  args.frame = 2;
+  args.res   = -1;
+  args.done  = 0;
+
+  write_hdf5(filename);
+  saxs_image_set_prefetch(args.image, 1);
+
+  gate_close();
+  assert(saxs_image_read(args.image, filename, NULL) == 0);
+  assert(pthread_create(&thread, NULL, read_frame_thread, &args) == 0);
+
+  usleep(100000);
+  pthread_mutex_lock(&gate_lock);
+  done = args.done;
+  pthread_mutex_unlock(&gate_lock);
+  assert(!done);
+
+  gate_open();
+  pthread_join(thread, NULL);
+  assert(args.res == 0);
+  assert_frame(args.image, 2);
+
+  saxs_image_free(args.image);
+  remove(filename);
+}
+
+int main(int argc, char **argv) {
+  const char *filename = "test_hdf5.h5";
+  const size_t order[] = { 2, 3, 4, 5, 6, 7, 3, 1 };
+  saxs_image *image = saxs_image_create();
+  size_t i;
+
+  /* The stack the Python tests read. */
+  if (argc > 1) {
+    write_hdf5(argv[1]);
+    saxs_image_free(image);
+    return 0;
+  }
+
+  printf("Testing saxs_image_read_frame...\n");
+  write_hdf5(filename);
+
+  saxs_image_set_frame_cache_size(image, 0);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert(saxs_image_frame_count(image) == FRAMES);
+  assert_frame(image, 1);
+
+  /* Nothing changes for files done with. */
+  assert(saxs_image_refresh(image) == 0);
+  assert(saxs_image_frame_count(image) == FRAMES);
+
+  /*
+   * The file stays open with the image; where files can be removed
+   * while open, further frames are read from the removed file.
+   */
+  remove(filename);
+
+  for (i = 0; i < sizeof(order) / sizeof(order[0]); ++i) {
+    assert(saxs_image_read_frame(image, order[i]) == 0);
+    assert_frame(image, order[i]);
+  }
+  assert(saxs_image_read_frame(image, FRAMES + 1) == EINVAL);
+
+  saxs_image_free(image);
+
+  printf("Testing the frame cache...\n");
+  test_frame_cache(filename);
+
+  printf("Testing saxs_image_set_prefetch...\n");
+  test_prefetch_window(filename);
+  test_prefetch_cancel(filename);
+  test_prefetch_wait(filename);
+
+  printf("Testing saxs_image_refresh...\n");
+  test_swmr(filename);
+
+  printf("Testing master files...\n");
+  test_master(filename);
+
+  printf("Testing NeXus files...\n");
+  test_nexus(filename);
+
+  printf("All tests completed successfully!\n");
+  return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * Test azimuthal integration on synthetic frames.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "saxsimage.h"
+#include "saxsdocument.h"
+
+static const saxs_image_geometry geometry = {
+  80.3, 60.7,          /* beam centre, pixels */
+  1000.0,              /* distance, mm */
+  0.172, 0.172,        /* PILATUS pixels, mm */
+  0.1                  /* wavelength, nm */
+};
+
+static double pixel_q(size_t x, size_t y) {
+  const double dx = (x - geometry.center_x) * geometry.pixel_size_x;
+  const double dy = (y - geometry.center_y) * geometry.pixel_size_y;
+  return 4.0 * M_PI / geometry.wavelength
+           * sin(0.5 * atan(sqrt(dx * dx + dy * dy) / geometry.distance));
+}
+
+static saxs_curve* integrate(saxs_image_integrator *integrator,
+                             saxs_image *image, saxs_document *doc) {
+  saxs_curve *curve = saxs_document_add_curve(doc, "integrated",
+                                              SAXS_CURVE_EXPERIMENTAL_SCATTERING_DATA);
+  assert(saxs_image_integrate(integrator, image, curve) == 0);
+  return curve;
+}
+
+/*
+ * Pixels with the value of their own q must give bins with the mean
+ * q of their pixels as intensity.
+ */
+static void test_profile(size_t width, size_t height, size_t bins) {
+  saxs_image *image = saxs_image_create();
+  saxs_document *doc = saxs_document_create();
+  saxs_image_integrator *integrator;
+  saxs_curve *curve;
+  saxs_data *data;
+  double last = -1.0;
+  size_t x, y;
+
+  assert(saxs_image_resize(image, width, height, 1, 1, SAXS_IMAGE_TYPE_DOUBLE) == 0);
+  for (y = 0; y < height; ++y)
+    for (x = 0; x < width; ++x)
+      saxs_image_set_value(image, x, y, pixel_q(x, y));
+
+  integrator = saxs_image_integrator_create(width, height, &geometry, bins, NULL);
+  assert(integrator);
+  assert(saxs_image_integrator_bins(integrator) == bins);
+
+  curve = integrate(integrator, image, doc);
+  assert(saxs_curve_data_count(curve) > 0);
+  assert(saxs_curve_data_count(curve) <= (int)bins);
+
+  for (data = saxs_curve_data(curve); data; data = saxs_data_next(data)) {
+    assert(saxs_data_x(data) > last);
+    assert(fabs(saxs_data_y(data) - saxs_data_x(data)) <= 1e-9 * saxs_data_x(data) + 1e-12);
+    last = saxs_data_x(data);
+  }
+
+  saxs_image_integrator_free(integrator);
+  saxs_document_free(doc);
+  saxs_image_free(image);
+}
+
+/*
+ * Constant counts: every bin has the same mean, with Poisson errors;
+ * gaps, masked pixels and frames stored top to bottom must not matter.
+ */
+static void test_counts() {
+  const size_t width = 200, height = 150;
+  saxs_image *image = saxs_image_create();
+  saxs_image *mask = saxs_image_create();
+  saxs_image *copy = saxs_image_create();
+  saxs_document *doc = saxs_document_create();
+  saxs_image_integrator *integrator;
+  saxs_curve *curve, *other;
+  saxs_data *data;
+  size_t x, y;
+
+  assert(saxs_image_resize(image, width, height, 1, 1, SAXS_IMAGE_TYPE_INT32) == 0);
+  assert(saxs_image_resize(mask, width, height, 1, 1, SAXS_IMAGE_TYPE_UINT8) == 0);
+  for (y = 0; y < height; ++y)
+    for (x = 0; x < width; ++x) {
+      double v = 100.0;
+      if (y == 97)                      /* module gap */
+        v = -1.0;
+      if (x < 10 && y < 20) {           /* beam stop */
+        v = 1e6;
+        saxs_image_set_value(mask, x, y, 1.0);
+      }
+      saxs_image_set_value(image, x, y, v);
+    }
+
+  integrator = saxs_image_integrator_create(width, height, &geometry, 40, mask);
+  assert(integrator);
+
+  curve = integrate(integrator, image, doc);
+  assert(saxs_curve_data_count(curve) > 0);
+  for (data = saxs_curve_data(curve); data; data = saxs_data_next(data)) {
+    const double n = 100.0 / (saxs_data_y_err(data) * saxs_data_y_err(data));
+
+    assert(saxs_data_y(data) == 100.0);
+    assert(fabs(n - floor(n + 0.5)) < 1e-6 && n >= 1.0);
+  }
+
+  /* TIFF images are read top to bottom. */
+  assert(saxs_image_write(image, "test_integrate.tif", "tiff") == 0);
+  assert(saxs_image_read(copy, "test_integrate.tif", "tiff") == 0);
+  remove("test_integrate.tif");
+
+  other = integrate(integrator, copy, doc);
+  assert(saxs_curve_compare(curve, other) == 0);
+
+  assert(saxs_image_resize(copy, width, height + 1, 1, 1, SAXS_IMAGE_TYPE_INT32) == 0);
+  assert(saxs_image_integrate(integrator, copy, curve) == EINVAL);
+
+  saxs_image_integrator_free(integrator);
+  assert(!saxs_image_integrator_create(width + 1, height, &geometry, 40, mask));
+  assert(!saxs_image_integrator_create(width, height, &geometry, 0, NULL));
+
+  saxs_document_free(doc);
+  saxs_image_free(copy);
+  saxs_image_free(mask);
+  saxs_image_free(image);
+}
+
+/*
+ * Tables saved to a file must integrate like the ones computed, and
+ * must not be used for a different geometry or mask.
+ */
+static void test_tables() {
+  const size_t width = 120, height = 90, bins = 50;
+  const char *filename = "test_integrate.qmap";
+  saxs_image_geometry moved = geometry;
+  saxs_image *image = saxs_image_create();
+  saxs_image *mask = saxs_image_create();
+  saxs_document *doc = saxs_document_create();
+  saxs_image_integrator *created, *loaded;
+  saxs_curve *curve, *other;
+  char head[100];
+  size_t x, y;
+  FILE *fd;
+
+  assert(saxs_image_resize(image, width, height, 1, 1, SAXS_IMAGE_TYPE_INT32) == 0);
+  assert(saxs_image_resize(mask, width, height, 1, 1, SAXS_IMAGE_TYPE_UINT8) == 0);
+  for (y = 0; y < height; ++y)
+    for (x = 0; x < width; ++x) {
+      saxs_image_set_value(image, x, y, (x * 31 + y * 17) % 1000);
+      saxs_image_set_value(mask, x, y, x == y);
+    }
+
+  remove(filename);
+  assert(!saxs_image_integrator_load(filename, width, height, &geometry, bins, mask));
+
+  /* Computes the tables and saves them ... */
+  created = saxs_image_integrator_open(filename, width, height, &geometry, bins, mask);
+  assert(created);
+
+  /* ... for the next one to load. */
+  loaded = saxs_image_integrator_open(filename, width, height, &geometry, bins, mask);
+  assert(loaded);
+
+  curve = integrate(created, image, doc);
+  other = integrate(loaded, image, doc);
+  assert(saxs_curve_compare(curve, other) == 0);
+  saxs_image_integrator_free(loaded);
+
+  moved.center_x += 0.5;
+  assert(!saxs_image_integrator_load(filename, width, height, &moved, bins, mask));
+  assert(!saxs_image_integrator_load(filename, width, height, &geometry, bins + 1, mask));
+  assert(!saxs_image_integrator_load(filename, width, height, &geometry, bins, NULL));
+  saxs_image_set_value(mask, 0, 1, 1.0);
+  assert(!saxs_image_integrator_load(filename, width, height, &geometry, bins, mask));
+  saxs_image_set_value(mask, 0, 1, 0.0);
+
+  /* Truncated files are not used either. */
+  fd = fopen(filename, "rb");
+  assert(fd && fread(head, 1, sizeof(head), fd) == sizeof(head));
+  fclose(fd);
+  fd = fopen(filename, "wb");
+  assert(fd && fwrite(head, 1, sizeof(head), fd) == sizeof(head));
+  fclose(fd);
+  assert(!saxs_image_integrator_load(filename, width, height, &geometry, bins, mask));
+
+  assert(saxs_image_integrator_save(created, filename) == 0);
+  loaded = saxs_image_integrator_load(filename, width, height, &geometry, bins, mask);
+  assert(loaded);
+  saxs_image_integrator_free(loaded);
+  remove(filename);
+
+  saxs_image_integrator_free(created);
+  saxs_document_free(doc);
+  saxs_image_free(mask);
+  saxs_image_free(image);
+}
+
+int main() {
+  printf("Testing saxs_image_integrate...\n");
+  test_profile(37, 23, 10);
+  test_profile(600, 500, 300);      /* large enough to run in parallel */
+  test_counts();
+  test_tables();
+
+  printf("All tests completed successfully!\n");
+  return 0;
+}
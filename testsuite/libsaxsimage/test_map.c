@@ -0,0 +1,204 @@
+/*
+ * Test mapping uncompressed EDF and TIFF files into memory, and reading
+ * those that can not be mapped.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tiffio.h>
+
+#include "saxsimage.h"
+
+#define WIDTH  37
+#define HEIGHT 23
+
+/* Row y counts from the bottom of the image. */
+static int32_t value(size_t x, size_t y) {
+  return (int32_t)(y * 1000 + x) - 5000;
+}
+
+static void assert_values(saxs_image *image) {
+  size_t x, y;
+
+  assert(saxs_image_width(image) == WIDTH);
+  assert(saxs_image_height(image) == HEIGHT);
+
+  for (y = 0; y < HEIGHT; ++y)
+    for (x = 0; x < WIDTH; ++x)
+      assert(saxs_image_value(image, x, y) == value(x, y));
+}
+
+static void assert_rows(saxs_image *image) {
+  size_t x, y;
+
+  for (y = 0; y < HEIGHT; ++y) {
+    const int32_t *row = saxs_image_row(image, y);
+    for (x = 0; x < WIDTH; ++x)
+      assert(row[x] == value(x, y));
+  }
+}
+
+#ifdef HAVE_EDF
+static int native_low_byte_first() {
+  const unsigned int one = 1;
+  return *(const char*)&one;
+}
+
+/*
+ * An EDF file of signed integers, rows from the bottom to the top,
+ * with an additional header line if given.
+ */
+static void write_edf(const char *filename, int low_byte_first,
+                      const char *extra) {
+  char header[512];
+  size_t n, x, y;
+  FILE *fd;
+
+  n = snprintf(header, sizeof(header),
+               "{\nHeaderID = EH:000001:000000:000000 ;\nImage = 1 ;\n"
+               "ByteOrder = %s ;\nDataType = SignedInteger ;\n"
+               "Dim_1 = %d ;\nDim_2 = %d ;\nSize = %d ;\n%s",
+               low_byte_first ? "LowByteFirst" : "HighByteFirst",
+               WIDTH, HEIGHT, (int)(WIDTH * HEIGHT * sizeof(int32_t)),
+               extra ? extra : "");
+  memset(header + n, ' ', sizeof(header) - n);
+  header[sizeof(header) - 2] = '}';
+  header[sizeof(header) - 1] = '\n';
+
+  fd = fopen(filename, "wb");
+  assert(fd);
+  assert(fwrite(header, 1, sizeof(header), fd) == sizeof(header));
+
+  for (y = 0; y < HEIGHT; ++y)
+    for (x = 0; x < WIDTH; ++x) {
+      const uint32_t v = (uint32_t)value(x, y);
+      unsigned char bytes[4];
+      int i;
+
+      for (i = 0; i < 4; ++i)
+        bytes[low_byte_first ? i : 3 - i] = (v >> (8 * i)) & 0xff;
+      assert(fwrite(bytes, 1, 4, fd) == 4);
+    }
+
+  fclose(fd);
+}
+
+static void test_edf(const char *filename) {
+  const int native = native_low_byte_first();
+  saxs_image *image = saxs_image_create();
+
+  /* Mapped in the native type, rows bottom to top as in the file. */
+  write_edf(filename, native, NULL);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert(saxs_image_type(image) == SAXS_IMAGE_TYPE_INT32);
+  assert(saxs_image_row_stride(image) == WIDTH * sizeof(int32_t));
+  assert_rows(image);
+  assert_values(image);
+
+  /* No copy needed. */
+  assert(saxs_image_pixels(image) == saxs_image_row(image, 0));
+
+  /* Changes are private to the image. */
+  saxs_image_set_value(image, 0, 0, 42.0);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert_values(image);
+
+  /* Read by edfpack otherwise, as floating point values. */
+  write_edf(filename, !native, NULL);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert(saxs_image_type(image) == SAXS_IMAGE_TYPE_FLOAT);
+  assert_values(image);
+
+  write_edf(filename, native, "EDF_DataBlocks = 1.Image ;\n");
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert(saxs_image_type(image) == SAXS_IMAGE_TYPE_FLOAT);
+  assert_values(image);
+
+  saxs_image_free(image);
+  remove(filename);
+}
+#endif
+
+/* An uncompressed TIFF file of one strip, rows from the top down. */
+static void write_tiff(const char *filename) {
+  static int32_t row[WIDTH];
+  TIFF *tiff;
+  size_t x, y;
+
+  tiff = TIFFOpen(filename, "w");
+  assert(tiff);
+
+  TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, WIDTH);
+  TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, HEIGHT);
+  TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, 32);
+  TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, 1);
+  TIFFSetField(tiff, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_INT);
+  TIFFSetField(tiff, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+  TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+  TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, HEIGHT);
+
+  for (y = 0; y < HEIGHT; ++y) {
+    for (x = 0; x < WIDTH; ++x)
+      row[x] = value(x, HEIGHT - y - 1);
+    assert(TIFFWriteScanline(tiff, row, y, 0) == 1);
+  }
+
+  TIFFClose(tiff);
+}
+
+static void test_tiff(const char *filename) {
+  saxs_image *image = saxs_image_create();
+  const void *pixels;
+  size_t x, y;
+
+  /* Mapped with rows top to bottom, i.e. a negative stride. */
+  write_tiff(filename);
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert(saxs_image_type(image) == SAXS_IMAGE_TYPE_INT32);
+  assert(saxs_image_row_stride(image) == -(ptrdiff_t)(WIDTH * sizeof(int32_t)));
+  assert((const char*)saxs_image_row(image, 0)
+           == (const char*)saxs_image_row(image, HEIGHT - 1)
+                + (HEIGHT - 1) * WIDTH * sizeof(int32_t));
+  assert_rows(image);
+  assert_values(image);
+
+  /* A bottom-up copy replaces the mapping. */
+  pixels = saxs_image_pixels(image);
+  assert(pixels);
+  assert(pixels == saxs_image_row(image, 0));
+  assert(saxs_image_row_stride(image) == WIDTH * sizeof(int32_t));
+  for (y = 0; y < HEIGHT; ++y)
+    for (x = 0; x < WIDTH; ++x)
+      assert(((const int32_t*)pixels)[y * WIDTH + x] == value(x, y));
+  assert_values(image);
+
+  /* A copy of a mapped image is bottom-up. */
+  assert(saxs_image_read(image, filename, NULL) == 0);
+  assert(saxs_image_row_stride(image) < 0);
+  saxs_image *copy = saxs_image_copy(image);
+  assert(copy);
+  assert(saxs_image_row_stride(copy) == WIDTH * sizeof(int32_t));
+  assert_rows(copy);
+  saxs_image_free(copy);
+
+  saxs_image_free(image);
+  remove(filename);
+}
+
+int main() {
+#ifdef HAVE_EDF
+  printf("Testing mapped EDF files...\n");
+  test_edf("test_map.edf");
+#endif
+
+  printf("Testing mapped TIFF files...\n");
+  test_tiff("test_map.tiff");
+
+  printf("All tests completed successfully!\n");
+  return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * Test saxs_image_statistics against a straightforward computation.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "saxsimage.h"
+
+static void expected_statistics(saxs_image *image, saxs_image *mask,
+                                saxs_image_stats *stats) {
+  size_t x, y;
+
+  memset(stats, 0, sizeof(saxs_image_stats));
+  stats->min = DBL_MAX;
+  stats->max = -DBL_MAX;
+
+  for (y = 0; y < saxs_image_height(image); ++y)
+    for (x = 0; x < saxs_image_width(image); ++x) {
+      double v = saxs_image_value(image, x, y);
+      int bin;
+
+      if (isnan(v))
+        continue;
+
+      if (v < stats->min)
+        stats->min = v;
+      if (v > stats->max)
+        stats->max = v;
+
+      if (v < 0.0 || isinf(v) || (mask && saxs_image_value(mask, x, y) != 0.0))
+        continue;
+
+      stats->sum += v;
+      stats->valid += 1;
+
+      bin = v < 1.0 ? 0 : ilogb(v) + 1;
+      if (bin >= SAXS_IMAGE_HISTOGRAM_BINS)
+        bin = SAXS_IMAGE_HISTOGRAM_BINS - 1;
+      stats->histogram[bin] += 1;
+    }
+}
+
+static void assert_equal(const saxs_image_stats *a, const saxs_image_stats *b) {
+  int i;
+
+  assert(a->min == b->min);
+  assert(a->max == b->max);
+  assert(fabs(a->sum - b->sum) <= 1e-9 * fabs(b->sum));
+  assert(a->valid == b->valid);
+  for (i = 0; i < SAXS_IMAGE_HISTOGRAM_BINS; ++i)
+    assert(a->histogram[i] == b->histogram[i]);
+}
+
+/* Random rectangles against sums over their pixels. */
+static void assert_roi(saxs_image *image) {
+  const size_t width = saxs_image_width(image), height = saxs_image_height(image);
+  double sum, total;
+  size_t valid;
+  int i;
+
+  assert(saxs_image_roi_sum(image, 0, 0, width, height, &total, NULL) == 0);
+
+  for (i = 0; i < 10; ++i) {
+    const size_t x0 = rand() % width, y0 = rand() % height;
+    const size_t w = 1 + rand() % (width - x0), h = 1 + rand() % (height - y0);
+    double expected_sum = 0.0;
+    size_t expected_valid = 0, x, y;
+
+    for (y = y0; y < y0 + h; ++y)
+      for (x = x0; x < x0 + w; ++x) {
+        const double v = saxs_image_value(image, x, y);
+        if (v >= 0.0 && !isinf(v)) {
+          expected_sum += v;
+          expected_valid += 1;
+        }
+      }
+
+    assert(saxs_image_roi_sum(image, x0, y0, w, h, &sum, &valid) == 0);
+    assert(valid == expected_valid);
+    assert(fabs(sum - expected_sum) <= 1e-12 * total);
+    assert(expected_valid == 0
+           || saxs_image_roi_mean(image, x0, y0, w, h) == sum / valid);
+  }
+
+  assert(saxs_image_roi_sum(image, width, height, 0, 0, &sum, &valid) == 0);
+  assert(sum == 0.0 && valid == 0);
+  assert(saxs_image_roi_sum(image, 1, 0, width, 1, NULL, NULL) == EINVAL);
+  assert(saxs_image_roi_sum(image, 0, height, 0, 1, NULL, NULL) == EINVAL);
+}
+
+static void test_type(int type, size_t width, size_t height) {
+  saxs_image *image = saxs_image_create();
+  saxs_image *mask = saxs_image_create();
+  saxs_image_stats stats, expected;
+  size_t x, y;
+
+  assert(saxs_image_resize(image, width, height, 1, 1, type) == 0);
+  assert(saxs_image_resize(mask, width, height, 1, 1, SAXS_IMAGE_TYPE_UINT8) == 0);
+
+  srand(width * height + type);
+  for (y = 0; y < height; ++y)
+    for (x = 0; x < width; ++x) {
+      /* Mostly counts, some detector gaps (-1) and bad pixels (-2). */
+      double v = rand() % 70000;
+      if (rand() % 50 == 0)
+        v = -1.0 - rand() % 2;
+      if (type == SAXS_IMAGE_TYPE_UINT8)
+        v = rand() % 256;
+      if (type == SAXS_IMAGE_TYPE_FLOAT || type == SAXS_IMAGE_TYPE_DOUBLE)
+        v /= 7.0;
+
+      saxs_image_set_value(image, x, y, v);
+      saxs_image_set_value(mask, x, y, rand() % 10 == 0);
+    }
+
+  assert(saxs_image_statistics(image, NULL, &stats) == 0);
+  expected_statistics(image, NULL, &expected);
+  assert_equal(&stats, &expected);
+  assert(saxs_image_value_min(image) == expected.min);
+  assert(saxs_image_value_max(image) == expected.max);
+
+  assert(saxs_image_statistics(image, mask, &stats) == 0);
+  expected_statistics(image, mask, &expected);
+  assert_equal(&stats, &expected);
+
+  assert_roi(image);
+
+  /* Cached results are dropped on modification. */
+  saxs_image_set_value(image, 0, 0, 250.0);
+  saxs_image_set_value(image, width - 1, height - 1, -3.0);
+  assert(saxs_image_statistics(image, NULL, &stats) == 0);
+  expected_statistics(image, NULL, &expected);
+  assert_equal(&stats, &expected);
+  assert_roi(image);
+
+  saxs_image_free(mask);
+  saxs_image_free(image);
+}
+
+static void test_special_values() {
+  saxs_image *image = saxs_image_create();
+  saxs_image *mask = saxs_image_create();
+  saxs_image_stats stats;
+  const double row[4] = { NAN, INFINITY, -5.0, 3.0 };
+
+  /* Empty images. */
+  assert(saxs_image_statistics(image, NULL, &stats) == 0);
+  assert(stats.min == 0.0 && stats.max == 0.0 && stats.valid == 0);
+
+  assert(saxs_image_resize(image, 4, 1, 1, 1, SAXS_IMAGE_TYPE_DOUBLE) == 0);
+  assert(saxs_image_set_row(image, 0, row, SAXS_IMAGE_TYPE_DOUBLE) == 0);
+  assert(saxs_image_statistics(image, NULL, &stats) == 0);
+  assert(stats.min == -5.0);
+  assert(isinf(stats.max));
+  assert(stats.valid == 1 && stats.sum == 3.0 && stats.histogram[2] == 1);
+  assert(saxs_image_roi_mean(image, 0, 0, 4, 1) == 3.0);
+  assert(isnan(saxs_image_roi_mean(image, 0, 0, 3, 1)));
+
+  assert(saxs_image_resize(mask, 3, 1, 1, 1, SAXS_IMAGE_TYPE_UINT8) == 0);
+  assert(saxs_image_statistics(image, mask, &stats) == EINVAL);
+
+  saxs_image_free(mask);
+  saxs_image_free(image);
+}
+
+int main() {
+  printf("Testing saxs_image_statistics...\n");
+  test_type(SAXS_IMAGE_TYPE_UINT8, 17, 5);
+  test_type(SAXS_IMAGE_TYPE_INT16, 33, 130);
+  test_type(SAXS_IMAGE_TYPE_UINT16, 1, 200);
+  test_type(SAXS_IMAGE_TYPE_INT32, 1475, 1679);     /* PILATUS 2M */
+  test_type(SAXS_IMAGE_TYPE_UINT32, 64, 64);
+  test_type(SAXS_IMAGE_TYPE_FLOAT, 1024, 1025);
+  test_type(SAXS_IMAGE_TYPE_DOUBLE, 100, 3);
+
+  printf("Testing special values...\n");
+  test_special_values();
+
+  printf("All tests completed successfully!\n");
+  return 0;
+}
@@ -1,8 +1,15 @@
 import sys
 import os
+import math
+import shutil
+import tempfile
+import threading
+import time
 import unittest
+from array import array
 
 import saxsdocument
+import saxsdocument.api as api
 
 
 class TestSAXSDocument(unittest.TestCase):
@@ -25,5 +32,350 @@ class TestSAXSDocument(unittest.TestCase):
         self.assertEqual(properties["Sample code"], "BSA")
 
 
+class TestDocument(unittest.TestCase):
+
+    def setUp(self):
+        self.doc = api.read("bsa.dat")
+
+    def test_sequence(self):
+        self.assertEqual(len(self.doc), 1)
+        self.assertEqual(len(list(self.doc)), 1)
+        self.assertRaises(IndexError, self.doc.__getitem__, 1)
+        self.assertRaises(IndexError, self.doc.curve, -2)
+
+        doc = api.create()
+        self.assertEqual(len(doc), 0)
+        self.assertEqual(list(doc), [])
+        self.assertEqual(doc.curves(), [])
+
+        doc.add_curve([1.0, 2.0], [3.0, 4.0], [0.1, 0.2])
+        doc.add_curve([1.0], [5.0], [0.3])
+        self.assertEqual(len(doc), 2)
+        self.assertEqual([c.data()[1] for c in doc], [[3.0, 4.0], [5.0]])
+        self.assertIs(doc[-1], doc[1])
+
+    def test_identity(self):
+        curve = self.doc.curve(0)
+        self.assertIs(self.doc[0], curve)
+        self.assertIs(self.doc.curve(-1), curve)
+        self.assertIs(self.doc.curves()[0], curve)
+
+        # Wrappers survive appending curves.
+        self.doc.add_curve([1.0], [2.0], [3.0])
+        self.assertIs(self.doc[0], curve)
+        self.assertIs(self.doc[1], self.doc.curve(1))
+
+        # ... and keep the document alive.
+        del self.doc
+        self.assertEqual(len(curve.data()[0]), 2096)
+
+    def test_wrapper_released(self):
+        curve = self.doc[0]
+        data = curve.data()
+        del curve
+
+        # A new wrapper for the same curve.
+        self.assertEqual(self.doc[0].data(), data)
+        self.assertIs(self.doc[0], self.doc[0])
+
+    def test_properties(self):
+        properties = self.doc.properties()
+        self.assertEqual(properties["Sample code"], "BSA")
+
+        # Copies of the cache, changes do not leak back.
+        properties["Sample code"] = "lysozyme"
+        del properties["Sample code"]
+        self.assertEqual(self.doc.properties()["Sample code"], "BSA")
+        self.assertIsNot(self.doc.properties(), self.doc.properties())
+
+        # Adding properties invalidates the cache.
+        self.doc.add_property("concentration", 4.5)
+        self.assertEqual(self.doc.properties()["concentration"], "4.5")
+        self.doc.add_properties({"buffer": "HEPES", "cell": 1})
+        properties = self.doc.properties()
+        self.assertEqual((properties["buffer"], properties["cell"]), ("HEPES", "1"))
+        self.assertEqual(properties["Sample code"], "BSA")
+
+
+class TestColumns(unittest.TestCase):
+
+    def setUp(self):
+        self.doc = api.read("bsa.dat")
+        self.curve = self.doc.curve(0)
+
+    def test_views(self):
+        x, y, err = self.curve.columns()
+        s, I, sigma = self.curve.data()
+        for view, values in ((x, s), (y, I), (err, sigma)):
+            self.assertIsInstance(view, memoryview)
+            self.assertTrue(view.readonly)
+            self.assertEqual(view.format, "d")
+            self.assertEqual(view.shape, (2096,))
+            self.assertEqual(view.tolist(), values)
+        self.assertEqual(x[0], 0.741270E-01)
+
+        # Views of the interleaved data points, not copies.
+        self.assertEqual(x.strides, y.strides)
+        self.assertGreater(x.strides[0], x.itemsize)
+        self.assertFalse(x.c_contiguous)
+
+    def test_views_outlive_document(self):
+        x, y, err = self.curve.columns()
+        del self.curve
+        del self.doc
+        self.assertEqual(y[-1], y.tolist()[-1])
+        self.assertEqual(len(err), 2096)
+
+    def test_add_data_while_exported(self):
+        x, y, err = self.curve.columns()
+        self.assertRaises(BufferError, self.curve.add_data, [1.0], [2.0], [3.0])
+
+        # Views of other curves of the document pin the data as well.
+        curve = self.doc.curve(0)
+        x.release()
+        self.assertRaises(BufferError, curve.add_data, [1.0], [2.0], [3.0])
+        y.release()
+        err.release()
+
+        self.curve.add_data([1.0], [2.0], [3.0])
+        x, y, err = self.curve.columns()
+        self.assertEqual(len(x), 2097)
+        self.assertEqual((x[-1], y[-1], err[-1]), (1.0, 2.0, 3.0))
+
+    def test_empty_curve(self):
+        doc = api.create()
+        doc.add_curve([], [], [])
+        x, y, err = doc.curve(0).columns()
+        self.assertEqual(len(x), 0)
+        self.assertEqual(x.tolist(), [])
+
+
+class TestAddCurve(unittest.TestCase):
+
+    s = [0.01 * k for k in range(1, 11)]
+    I = [100.0 / k for k in range(1, 11)]
+    err = [0.5] * 10
+
+    def assertCurve(self, curve, s, I, err):
+        x, y, yerr = curve.data()
+        self.assertEqual(x, s)
+        self.assertEqual(y, I)
+        self.assertEqual(yerr, err)
+
+    def test_float64(self):
+        doc = api.create()
+        doc.add_curve(array("d", self.s), memoryview(array("d", self.I)), self.err)
+        self.assertCurve(doc.curve(0), self.s, self.I, self.err)
+
+    def test_float32(self):
+        doc = api.create()
+        doc.add_curve(array("f", self.s), array("f", self.I), array("f", self.err))
+        rounded = lambda values: array("f", values).tolist()
+        self.assertCurve(doc.curve(0), rounded(self.s), rounded(self.I),
+                         rounded(self.err))
+
+    def test_non_contiguous(self):
+        interleaved = array("d")
+        for values in zip(self.s, self.I, self.err):
+            interleaved.extend(values)
+        view = memoryview(interleaved)
+
+        doc = api.create()
+        doc.add_curve(view[0::3], view[1::3], view[2::3])
+        self.assertCurve(doc.curve(0), self.s, self.I, self.err)
+
+        # Backwards, and float32 with strides.
+        doc.curve(0).add_data(view[-3::-3], memoryview(array("f", self.I))[::-1],
+                              view[-1::-3])
+        self.assertEqual(len(doc.curve(0).data()[0]), 20)
+        self.assertEqual(doc.curve(0).data()[0][10:], self.s[::-1])
+
+    def test_add_data(self):
+        doc = api.create()
+        doc.add_curve(self.s[:5], self.I[:5], self.err[:5])
+        doc.curve(0).add_data(array("d", self.s[5:]), array("f", self.I[5:]),
+                              self.err[5:])
+        x, y, yerr = doc.curve(0).data()
+        self.assertEqual(x, self.s)
+        self.assertEqual(y[5:], array("f", self.I[5:]).tolist())
+
+    def test_rejected(self):
+        doc = api.create()
+        matrix = memoryview(array("d", self.err * 2)).cast("B").cast("d", (2, 10))
+        invalid = [
+            (TypeError, (array("i", range(10)), self.I, self.err)),
+            (TypeError, (self.s, memoryview(bytes(80)), self.err)),
+            (TypeError, (self.s, self.I, matrix)),
+            (TypeError, (self.s, self.I, [0.5] * 9 + [1])),
+            (TypeError, (self.s, self.I, tuple(self.err))),
+            (RuntimeError, (self.s, self.I[:9], self.err)),
+        ]
+
+        for error, args in invalid:
+            self.assertRaises(error, doc.add_curve, *args)
+        self.assertEqual(len(doc), 0)
+
+        doc.add_curve(self.s, self.I, self.err)
+        for error, args in invalid:
+            self.assertRaises(error, doc.curve(0).add_data, *args)
+        self.assertEqual(len(doc), 1)
+        self.assertCurve(doc.curve(0), self.s, self.I, self.err)
+
+
+class TestReadMany(unittest.TestCase):
+
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.filenames = []
+
+        # Named such that input order is not the order of the names.
+        for k in range(8):
+            doc = api.create()
+            doc.add_curve([0.01 * i for i in range(1, 21)], [float(k)] * 20, [0.5] * 20)
+            filename = os.path.join(self.dir, "%d.dat" % ((5 * k) % 8))
+            doc.write(filename, "atsas-dat-3-column")
+            self.filenames.append(filename)
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def test_order(self):
+        for threads in (0, 1, 3):
+            docs = api.read_many(self.filenames, threads=threads)
+            self.assertEqual(len(docs), len(self.filenames))
+            for k, doc in enumerate(docs):
+                self.assertEqual(doc.curve(0).data()[1], [float(k)] * 20)
+
+        self.assertEqual(api.read_many([]), [])
+
+    def test_bad_file(self):
+        missing = os.path.join(self.dir, "missing.dat")
+        filenames = self.filenames[:3] + [missing, "bsa.dat", missing + "2"]
+        with self.assertRaises(IOError) as cm:
+            api.read_many(filenames)
+        self.assertEqual(cm.exception.filename, missing)
+
+        self.assertRaises(TypeError, api.read_many, [self.filenames[0], 1])
+        self.assertRaises(TypeError, api.read_many, 1)
+
+    @unittest.skipUnless(hasattr(os, "mkfifo"), "requires named pipes")
+    def test_writers(self):
+        doc = api.read(self.filenames[1])
+        curve = doc.curve(0)
+
+        #
+        # Writing blocks on opening the pipe until it is read from; the
+        # GIL is released meanwhile, but the document must not change.
+        #
+        pipe = os.path.join(self.dir, "pipe.dat")
+        os.mkfifo(pipe)
+        writer = threading.Thread(target=doc.write, args=(pipe, "atsas-dat-3-column"))
+        writer.start()
+
+        deadline = time.time() + 10
+        while True:
+            try:
+                doc.add_properties({})
+            except RuntimeError:
+                break
+            self.assertLess(time.time(), deadline)
+            time.sleep(0.01)
+
+        self.assertRaises(RuntimeError, doc.add_curve, [1.0], [2.0], [3.0])
+        self.assertRaises(RuntimeError, curve.add_data, [1.0], [2.0], [3.0])
+        self.assertRaises(RuntimeError, doc.add_property, "key", "value")
+        self.assertEqual(len(doc), 1)
+
+        # Reading is fine.
+        self.assertEqual(curve.data()[1], [1.0] * 20)
+        self.assertEqual(api.read_many([self.filenames[1]])[0].curve(0).data(),
+                         curve.data())
+
+        with open(pipe) as f:
+            written = f.read()
+        writer.join()
+        rows = [line for line in written.splitlines() if len(line.split()) == 3]
+        self.assertEqual(len(rows), 20)
+
+        curve.add_data([1.0], [2.0], [3.0])
+        self.assertEqual(len(curve.data()[0]), 21)
+
+
+class TestReadStack(unittest.TestCase):
+
+    grid = [0.01 * i for i in range(1, 21)]
+
+    def write(self, name, s, I):
+        filename = os.path.join(self.dir, name)
+        doc = api.create()
+        doc.add_curve(s, I, [0.1 * y for y in I])
+        doc.write(filename, "atsas-dat-3-column")
+        return filename
+
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.filenames = [self.write("%d.dat" % k, self.grid,
+                                     [k * s for s in self.grid])
+                          for k in range(1, 4)]
+
+        # On every other point of the grid, linear in s.
+        self.coarse = self.write("coarse.dat", self.grid[1::2],
+                                 [5 * s for s in self.grid[1::2]])
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def test_shape(self):
+        s, I, err = api.read_stack(self.filenames)
+        self.assertEqual(s.shape, (20,))
+        self.assertEqual(I.shape, (3, 20))
+        self.assertEqual(err.shape, (3, 20))
+        self.assertEqual(I.strides, (20 * I.itemsize, I.itemsize))
+        self.assertTrue(I.readonly)
+
+        self.assertEqual(s.tolist(), api.read(self.filenames[0]).curve(0).data()[0])
+        for k, row in enumerate(I.tolist()):
+            self.assertEqual(row, api.read(self.filenames[k]).curve(0).data()[1])
+        self.assertEqual(err[2, 19], api.read(self.filenames[2]).curve(0).data()[2][19])
+
+        s, I, err = api.read_stack([])
+        self.assertEqual((s.shape, I.shape), ((0,), (0, 0)))
+
+    def test_grid_mismatch(self):
+        with self.assertRaises(IOError) as cm:
+            api.read_stack(self.filenames + [self.coarse])
+        self.assertEqual(cm.exception.filename, self.coarse)
+
+        missing = os.path.join(self.dir, "missing.dat")
+        with self.assertRaises(IOError) as cm:
+            api.read_stack([missing] + self.filenames)
+        self.assertEqual(cm.exception.filename, missing)
+
+    def test_interpolate(self):
+        s, I, err = api.read_stack(self.filenames + [self.coarse], threads=2,
+                                   interpolate=True)
+        self.assertEqual(I.shape, (4, 20))
+
+        # Points outside of the range of the coarse curve are NaN.
+        row = I.tolist()[3]
+        self.assertTrue(math.isnan(row[0]))
+        for k in range(1, 20):
+            self.assertAlmostEqual(row[k], 5 * s[k], places=5)
+        self.assertEqual(I.tolist()[:3], api.read_stack(self.filenames)[1].tolist())
+
+    def test_grid(self):
+        grid = array("d", self.grid[5:15])
+        s, I, err = api.read_stack(self.filenames, grid=grid, interpolate=True)
+        self.assertEqual(s.tolist(), grid.tolist())
+        self.assertEqual(I.shape, (3, 10))
+        for k, row in enumerate(I.tolist()):
+            for x, y in zip(grid, row):
+                self.assertAlmostEqual(y, (k + 1) * x, places=5)
+
+        # Without interpolation, the curves must be on the grid given.
+        self.assertRaises(IOError, api.read_stack, self.filenames, grid=grid)
+        self.assertRaises(TypeError, api.read_stack, self.filenames, grid="grid")
+
+
 if __name__ == "__main__":
     unittest.main()
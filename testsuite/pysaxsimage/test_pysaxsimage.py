@@ -0,0 +1,223 @@
+import os
+import shutil
+import struct
+import sys
+import tempfile
+import threading
+import unittest
+import zlib
+from array import array
+
+import saxsimage.api as api
+
+
+WIDTH, HEIGHT = 5, 3
+
+def value(frame, x, y):
+    return frame * 10000 + y * 100 + x
+
+def native(values):
+    data = array("i", values)
+    if sys.byteorder != "little":
+        data.byteswap()
+    return data.tobytes()
+
+def write_edf(filename, rows):
+    """Rows from the bottom to the top, as stored in EDF files."""
+    header = ("{\nHeaderID = EH:000001:000000:000000 ;\nImage = 1 ;\n"
+              "ByteOrder = %s ;\nDataType = SignedInteger ;\n"
+              "Dim_1 = %d ;\nDim_2 = %d ;\nSize = %d ;\n"
+              % ("LowByteFirst" if sys.byteorder == "little" else "HighByteFirst",
+                 len(rows[0]), len(rows), 4 * len(rows[0]) * len(rows)))
+    header += " " * (512 - len(header) - 2) + "}\n"
+
+    data = array("i", [v for row in rows for v in row])
+    with open(filename, "wb") as f:
+        f.write(header.encode("ascii") + data.tobytes())
+
+def write_tiff(filename, rows, title=None):
+    """Rows from the top to the bottom, uncompressed little endian int32,
+    with the bytes of the title in the DECTRIS title tag if given."""
+    data = native([v for row in rows for v in row])
+    text = title + b"\0" if title is not None else b""
+    entries = [(256, 4, len(rows[0])), (257, 4, len(rows)), (258, 3, 32),
+               (259, 3, 1), (262, 3, 1), (273, 4, 0), (277, 3, 1),
+               (278, 4, len(rows)), (279, 4, len(data)), (339, 3, 2)]
+    if text:
+        entries.append((0x9000, 2, len(text)))
+
+    # The title after the directory, then the pixels, aligned for mapping.
+    start = 8 + 2 + 12 * len(entries) + 4
+    offset = start + len(text)
+    offset += -offset % 4
+
+    ifd = struct.pack("<H", len(entries))
+    for tag, kind, v in entries:
+        v = offset if tag == 273 else v
+        if kind == 2:
+            ifd += struct.pack("<HHII", tag, kind, v, start)
+            continue
+        ifd += struct.pack("<HHI", tag, kind, 1)
+        ifd += struct.pack("<HH", v, 0) if kind == 3 else struct.pack("<I", v)
+    ifd += struct.pack("<I", 0)
+
+    with open(filename, "wb") as f:
+        f.write(b"II*\0" + struct.pack("<I", 8) + ifd + text)
+        f.write(b"\0" * (offset - 8 - len(ifd) - len(text)) + data)
+
+
+class TestImage(unittest.TestCase):
+
+    # Image rows from the bottom to the top.
+    rows = [[value(1, x, y) for x in range(WIDTH)] for y in range(HEIGHT)]
+
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.edf = os.path.join(self.dir, "image.edf")
+        self.tiff = os.path.join(self.dir, "image.tiff")
+        write_edf(self.edf, self.rows)
+        write_tiff(self.tiff, self.rows[::-1])
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def test_buffer(self):
+        image = api.read(self.edf)
+        self.assertEqual((image.width(), image.height()), (WIDTH, HEIGHT))
+        self.assertEqual((image.frame_count(), image.current_frame()), (1, 1))
+
+        data = image.data()
+        self.assertTrue(data.readonly)
+        self.assertEqual(data.format, "i")
+        self.assertEqual(data.shape, (HEIGHT, WIDTH))
+        self.assertEqual(data.strides, (4 * WIDTH, 4))
+        self.assertEqual(data.tolist(), self.rows)
+        self.assertEqual(data[2, 4], value(1, 4, 2))
+
+    def test_topdown(self):
+        # Mapped rows in the order of the file, i.e. negative strides.
+        image = api.read(self.tiff)
+        data = image.data()
+        self.assertEqual(data.shape, (HEIGHT, WIDTH))
+        self.assertEqual(data.strides, (-4 * WIDTH, 4))
+        self.assertEqual(data.tolist(), self.rows)
+
+        # Consumers without strides get the pixels copied, but not
+        # from under another view.
+        self.assertRaises(BufferError, zlib.crc32, image)
+        data.release()
+
+        contiguous = array("i", [v for row in self.rows for v in row])
+        self.assertEqual(zlib.crc32(image), zlib.crc32(contiguous))
+        self.assertEqual(image.data().strides, (4 * WIDTH, 4))
+
+    def test_read_frame(self):
+        image = api.read(self.edf)
+        self.assertRaises(IndexError, image.read_frame, 0)
+        self.assertRaises(IndexError, image.read_frame, 2)
+
+        data = image.data()
+        self.assertRaises(BufferError, image.read_frame, 1)
+        self.assertEqual(data.tolist(), self.rows)
+
+        data.release()
+        image.read_frame(1)
+        self.assertEqual(image.data().tolist(), self.rows)
+
+    def test_properties(self):
+        # Bytes that are not UTF-8 are escaped, not an error.
+        write_tiff(self.tiff, self.rows[::-1], b"caf\xe9")
+        properties = api.read(self.tiff).properties()
+        self.assertEqual(properties["DectrisTitleTag"], "caf\udce9")
+        self.assertEqual(properties["DectrisTitleTag"].encode("utf-8", "surrogateescape"),
+                         b"caf\xe9")
+
+    def test_frames(self):
+        image = api.read(self.tiff)
+        frames = list(image.frames())
+        self.assertEqual(len(frames), 1)
+        self.assertIsNot(frames[0], image)
+        self.assertEqual(frames[0].data().tolist(), self.rows)
+
+        self.assertRaises(IOError, api.read, os.path.join(self.dir, "missing.edf"))
+
+
+@unittest.skipUnless(os.environ.get("SAXSIMAGE_TEST_HDF5"), "no HDF5 stack")
+class TestFrames(unittest.TestCase):
+
+    frames = 7
+    width, height = 40, 30
+
+    def expected(self, frame):
+        # The first row in the file is the top one.
+        return [[value(frame, x, self.height - y - 1) for x in range(self.width)]
+                for y in range(self.height)]
+
+    def setUp(self):
+        self.image = api.read(os.environ["SAXSIMAGE_TEST_HDF5"])
+
+    def test_read_frame(self):
+        self.assertEqual(self.image.frame_count(), self.frames)
+
+        data = self.image.data()
+        self.assertRaises(BufferError, self.image.read_frame, 2)
+        self.assertEqual(self.image.current_frame(), 1)
+        data.release()
+
+        for frame in (3, 7, 2):
+            self.image.read_frame(frame)
+            self.assertEqual(self.image.current_frame(), frame)
+            self.assertEqual(self.image.data().tolist(), self.expected(frame))
+        self.assertRaises(IndexError, self.image.read_frame, self.frames + 1)
+
+    def test_threads(self):
+        # Reads of one thread are rejected while another replaces the
+        # pixels, views always show a single frame.
+        errors = []
+
+        def run(frames):
+            try:
+                for k in range(200):
+                    try:
+                        self.image.read_frame(frames[k % len(frames)])
+                    except (ValueError, BufferError):
+                        pass
+                    try:
+                        data = self.image.data()
+                    except BufferError:
+                        continue
+                    rows = data.tolist()
+                    data.release()
+                    self.assertEqual(rows, self.expected(rows[-1][0] // 10000))
+            except Exception as e:
+                errors.append(e)
+
+        threads = [threading.Thread(target=run, args=(frames,))
+                   for frames in ((1, 3, 5, 7), (2, 4, 6))]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        self.assertEqual(errors, [])
+        frame = self.image.current_frame()
+        self.assertEqual(self.image.data().tolist(), self.expected(frame))
+
+    def test_frames(self):
+        views = []
+        for k, frame in enumerate(self.image.frames()):
+            self.assertEqual(frame.current_frame(), k + 1)
+            self.assertEqual(frame.frame_count(), self.frames)
+            views.append(frame.data())
+
+        # Views of earlier frames stay valid.
+        self.assertEqual(len(views), self.frames)
+        for k, view in enumerate(views):
+            self.assertEqual(view.tolist(), self.expected(k + 1))
+
+        # The image itself is not stepped.
+        self.assertEqual(self.image.current_frame(), 1)
+
+
+if __name__ == "__main__":
+    unittest.main()